@@ -320,6 +320,9 @@ void stdEEPROMSet() {
 	//Set filter type to box blur
 	EEPROM.write(eeprom_filterType, filterType_gaussian);
 
+	//Set AGC mode to linear
+	EEPROM.write(eeprom_agcMode, agcMode_linear);
+
 	//For DIY-Thermocam V2, set HQ res to true
 	if(teensyVersion == teensyVersion_new)
 		EEPROM.write(eeprom_hqRes, true);
@@ -15,6 +15,14 @@
 
 /* Methods */
 
+/* Create the overlay key of a string */
+uint32_t overlayStringKey(const char* str) {
+	uint32_t key = 0;
+	while (*str)
+		key = display_overlayKey(key, *str++);
+	return key;
+}
+
 /* Display battery status in percentage */
 void displayBatteryStatus() {
 	//Check battery status every 60 seconds
@@ -25,6 +33,13 @@ void displayBatteryStatus() {
 		batTimer = millis();
 	}
 
+	//Charging only matters for the percentage, USB is sampled with the battery
+	bool charging = (batPercentage > 0) && (batPercentage != 100) && batCharging;
+
+	//Status did not change, use the cached overlay
+	if (display_overlayCached(overlay_battery, display_overlayKey(batPercentage, charging)))
+		return;
+
 	//USB Power only
 	if (batPercentage == -1)
 		display_print((char*) "USB Power", 240, 0);
@@ -36,7 +51,7 @@ void displayBatteryStatus() {
 	//Display battery status in percentage
 	else {
 		//Charging, show plus symbol
-		if ((analogRead(pin_usb_measure) > 50) && (batPercentage != 100))
+		if (charging)
 		{
 			display_printNumI(batPercentage, 270, 0, 3, ' ');
 			display_print((char*) "%", 300, 0);
@@ -50,50 +65,67 @@ void displayBatteryStatus() {
 			display_print((char*) "%", 310, 0);
 		}
 	}
+
+	display_overlayEnd();
 }
 
 /* Display the current time on the screen*/
 void displayTime() {
+	//Only redraw once a second
+	time_t current = now();
+	if (display_overlayCached(overlay_time, current))
+		return;
+
 	//Tiny font
 	if ((teensyVersion == teensyVersion_old) || (!hqRes)) {
-		display_printNumI(hour(), 5, 228, 2, '0');
+		display_printNumI(hour(current), 5, 228, 2, '0');
 		display_print((char*) ":", 23, 228);
-		display_printNumI(minute(), 27, 228, 2, '0');
+		display_printNumI(minute(current), 27, 228, 2, '0');
 		display_print((char*) ":", 45, 228);
-		display_printNumI(second(), 49, 228, 2, '0');
+		display_printNumI(second(current), 49, 228, 2, '0');
 	}
 
 	//Small font
 	else
 	{
-		display_printNumI(hour(), 5, 228, 2, '0');
+		display_printNumI(hour(current), 5, 228, 2, '0');
 		display_print((char*) ":", 20, 228);
-		display_printNumI(minute(), 27, 228, 2, '0');
+		display_printNumI(minute(current), 27, 228, 2, '0');
 		display_print((char*) ":", 42, 228);
-		display_printNumI(second(), 49, 228, 2, '0');
+		display_printNumI(second(current), 49, 228, 2, '0');
 	}
+
+	display_overlayEnd();
 }
 
 /* Display the date on screen */
 void displayDate() {
+	//Only redraw when the day changes
+	time_t current = now();
+	uint32_t key = display_overlayKey(display_overlayKey(day(current), month(current)), year(current));
+	if (display_overlayCached(overlay_date, key))
+		return;
+
 	//Tiny font
 	if ((teensyVersion == teensyVersion_old) || (!hqRes)) {
-		display_printNumI(day(), 5, 0, 2, '0');
+		display_printNumI(day(current), 5, 0, 2, '0');
 		display_print((char*) ".", 23, 0);
-		display_printNumI(month(), 27, 0, 2, '0');
+		display_printNumI(month(current), 27, 0, 2, '0');
 		display_print((char*) ".", 45, 0);
-		display_printNumI(year(), 49, 0, 4);
+		display_printNumI(year(current), 49, 0, 4);
 	}
 
 	//Small font
 	else
 	{
-		display_printNumI(day(), 5, 0, 2, '0');
+		display_printNumI(day(current), 5, 0, 2, '0');
 		display_print((char*) ".", 20, 0);
-		display_printNumI(month(), 27, 0, 2, '0');
+		display_printNumI(month(current), 27, 0, 2, '0');
 		display_print((char*) ".", 42, 0);
-		display_printNumI(year(), 49, 0, 4);
+		display_printNumI(year(current), 49, 0, 4);
 	}
+
+	display_overlayEnd();
 }
 
 /* Display the warmup message on screen*/
@@ -141,9 +173,9 @@ void displayMinMaxPoint(bool min)
 
 		//Show min or max value as absolute temperature
 		if(min)
-			display_printNumF(calFunction(minTempVal), 2, xpos, ypos);
+			display_printNumF(calSnapCenti(minTempVal) / 100.0, 2, xpos, ypos);
 		else
-			display_printNumF(calFunction(maxTempVal), 2, xpos, ypos);
+			display_printNumF(calSnapCenti(maxTempVal) / 100.0, 2, xpos, ypos);
 	}
 	
 	//Warmup, show C / H
@@ -166,29 +198,45 @@ void displayMinMaxPoint(bool min)
 
 /* Display free space on screen*/
 void displayFreeSpace() {
+	//Only redraw when the storage info changes
+	if (display_overlayCached(overlay_freeSpace, overlayStringKey(sdInfo.c_str())))
+		return;
+
 	//Tinyfont
 	if ((teensyVersion == teensyVersion_old) || (!hqRes))
 		display_print(sdInfo, 197, 228);
 	//Smallfont
 	else
 		display_print(sdInfo, 220, 228);
+
+	display_overlayEnd();
 }
 
 /* Show the current spot temperature on screen*/
 void showSpot() {
-	//Draw the spot circle
-	display_drawCircle(160, 120, 12);
-
-	//Draw the lines
-	display_drawLine(136, 120, 148, 120);
-	display_drawLine(172, 120, 184, 120);
-	display_drawLine(160, 96, 160, 108);
-	display_drawLine(160, 132, 160, 144);
+	//The spot itself never changes
+	if (!display_overlayCached(overlay_spot, 0)) {
+		//Draw the spot circle
+		display_drawCircle(160, 120, 12);
+
+		//Draw the lines
+		display_drawLine(136, 120, 148, 120);
+		display_drawLine(172, 120, 184, 120);
+		display_drawLine(160, 96, 160, 108);
+		display_drawLine(160, 132, 160, 144);
+
+		display_overlayEnd();
+	}
 
 	//Convert to float with a special method
 	char buffer[10];
 	floatToChar(buffer, mlx90614_temp);
+
+	//Only redraw the temperature if the text changes
+	if (display_overlayCached(overlay_spotTemp, overlayStringKey(buffer)))
+		return;
 	display_print(buffer, 145, 150);
+	display_overlayEnd();
 }
 
 /* Display addition information on the screen */
@@ -247,6 +295,10 @@ void displayInfos() {
 	//Show the temperature points
 	showTemperatures();
 
+	//Show the frame rate and latency if enabled over serial
+	if (profiler_overlay)
+		profiler_showOverlay();
+
 	//Set write back to display
 	display_writeToImage = false;
 }
\ No newline at end of file
@@ -74,32 +74,31 @@ void deleteVideo(char* dirname) {
 				//Go into the video folder
 				sd.chdir("/");
 				sd.chdir(dirname);
+				//Remove the video container and the index of an interrupted recording if there
+				if (sd.exists(video_fileName))
+					sd.remove(video_fileName);
+				if (sd.exists(video_indexName))
+					sd.remove(video_indexName);
 				//Delete all files
 				uint16_t videoCounter = 0;
-				bool exists;
+				const char* endings[3] = { ".DAT", ".BMP", ".JPG" };
 				char filename[] = "00000.DAT";
 				//Go through the frames
 				while (1) {
+					bool removed = false;
 					//Get the frame name
 					frameFilename(filename, videoCounter);
-					//Check frame existance
-					exists = sd.exists(filename);
+					//Remove raw, bitmap and jpeg frame if there
+					for (byte i = 0; i < 3; i++) {
+						strcpy(&filename[5], endings[i]);
+						if (sd.exists(filename)) {
+							sd.remove(filename);
+							removed = true;
+						}
+					}
 					//If the frame does not exists, end remove
-					if (!exists)
+					if (!removed)
 						break;
-					//Otherwise remove file
-					else
-						sd.remove(filename);
-					//Remove Bitmap if there
-					strcpy(&filename[5], ".BMP");
-					if (sd.exists(filename))
-						sd.remove(filename);
-					//Remove Jpeg if there
-					strcpy(&filename[5], ".JPG");
-					if (sd.exists(filename))
-						sd.remove(filename);
-					//Reset ending
-					strcpy(&filename[5], ".DAT");
 					//Raise counter
 					videoCounter++;
 				}
@@ -351,6 +350,14 @@ uint16_t getVideoFrameNumber(char* dirname) {
 	uint16_t videoCounter = 0;
 	bool exists;
 	char filename[] = "00000.DAT";
+
+	//Single file container, the count is in the trailer
+	if (loadVideoOpen(dirname)) {
+		videoCounter = videoContainerFrames;
+		loadVideoClose();
+		return videoCounter;
+	}
+
 	//Switch Clock to Alternative
 	startAltClockline();
 	//Go into the folder
@@ -378,11 +385,15 @@ void displayVideoFrame(int i, char* dirname)
 {
 	char filename[] = "00000.DAT";
 
-	//Get the frame name
-	frameFilename(filename, i);
+	//Load the frame from the video container
+	if (videoContainer)
+		loadVideoFrame(i);
 
-	//Load Raw data
-	loadRawData(filename, dirname);
+	//Load the frame from a single file
+	else {
+		frameFilename(filename, i);
+		loadRawData(filename, dirname);
+	}
 
 	//Display Raw Data
 	displayRawData();
@@ -394,8 +405,12 @@ void playVideo(char* dirname, int imgCount) {
 	//Save the current frame number
 	int frameNumber = 0;
 
-	//Get the total number of frames in the dir
-	uint16_t numberOfFrames = getVideoFrameNumber(dirname);
+	//Get the total number of frames, keep the container open for seeking
+	uint16_t numberOfFrames;
+	if (loadVideoOpen(dirname))
+		numberOfFrames = videoContainerFrames;
+	else
+		numberOfFrames = getVideoFrameNumber(dirname);
 
 	//Jump here when pausing a video
 showFrame:
@@ -425,8 +440,10 @@ showFrame:
 	while (touch_touched());
 
 	//Check if we play the video
-	if (loadTouch != loadTouch_middle)
+	if (loadTouch != loadTouch_middle) {
+		loadVideoClose();
 		return;
+	}
 	loadTouch = loadTouch_none;
 
 	//Play forever
@@ -446,8 +463,10 @@ showFrame:
 				goto showFrame;
 			}
 			//Any other action
-			if (loadTouch != loadTouch_none)
+			if (loadTouch != loadTouch_none) {
+				loadVideoClose();
 				return;
+			}
 
 			//Display frame
 			displayVideoFrame(frameNumber, dirname);
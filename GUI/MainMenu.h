@@ -423,6 +423,7 @@ void hotColdChooser() {
 	//Find min and max values
 	if ((autoMode) && (!limitsLocked)) {
 		lepton_getRawValues();
+		calcFrameStats();
 		limitValues();
 	}
 
@@ -663,6 +664,7 @@ bool tempLimitsManualHandler() {
 				//Refresh min and max
 				delay(10);
 				lepton_getRawValues();
+				calcFrameStats();
 				limitValues();
 			}
 			//SELECT
@@ -972,6 +974,12 @@ void liveDispMenuString(int pos) {
 			text = (char*) "Box-Filter";
 		else if (filterType == filterType_gaussian)
 			text = (char*) "Gaus-Filter";
+		else if (filterType == filterType_gaussian5)
+			text = (char*) "Gaus-5x5";
+		else if (filterType == filterType_median)
+			text = (char*) "Median";
+		else if (filterType == filterType_bilateral)
+			text = (char*) "Bilateral";
 		else
 			text = (char*) "No Filter";
 		break;
@@ -999,6 +1007,17 @@ void liveDispMenuString(int pos) {
 		else
 			text = (char*) "Both C/H";
 		break;
+		//Automatic gain control
+	case 9:
+		if (agcMode == agcMode_percentile)
+			text = (char*) "Percentile";
+		else if (agcMode == agcMode_equalize)
+			text = (char*) "Equalize";
+		else if (agcMode == agcMode_local)
+			text = (char*) "Local Eq.";
+		else
+			text = (char*) "Linear";
+		break;
 
 	}
 	mainMenuSelection(text);
@@ -1035,13 +1054,13 @@ bool liveDispMenu() {
 				if (displayOptionsPos > 0)
 					displayOptionsPos--;
 				else if (displayOptionsPos == 0)
-					displayOptionsPos = 8;
+					displayOptionsPos = 9;
 			}
 			//FORWARD
 			else if (pressedButton == 1) {
-				if (displayOptionsPos < 8)
+				if (displayOptionsPos < 9)
 					displayOptionsPos++;
-				else if (displayOptionsPos == 8)
+				else if (displayOptionsPos == 9)
 					displayOptionsPos = 0;
 			}
 			//Change the menu name
@@ -1466,6 +1485,9 @@ void mainMenu() {
 	//Set show menu to opened
 	showMenu = showMenu_opened;
 
+	//Do not use a frame captured in the background before
+	lepton_frameReady = false;
+
 	//Position in the main menu
 	static byte mainMenuPos = 0;
 	
@@ -169,7 +169,7 @@ void videoCaptureInterval(int16_t* remainingTime, int* framesCaptured, char* dir
 			camera_capture();
 
 		//Save video raw frame
-		saveRawData(false, dirname, *framesCaptured);
+		videoSaveFrame();
 	}
 
 	//Convert lepton data to RGB565 colors
@@ -245,7 +245,7 @@ void videoCaptureNormal(char* dirname, int* framesCaptured) {
 	char buffer[30];
 
 	//Save video raw frame
-	saveRawData(false, dirname, *framesCaptured);
+	videoSaveFrame();
 
 	//Convert the colors
 	convertColors();
@@ -295,6 +295,9 @@ void videoCapture() {
 	//Create folder 
 	createVideoFolder(dirname);
 
+	//Create the video container inside
+	videoBegin();
+
 	//Switch to recording mode
 	videoSave = videoSave_recording;
 
@@ -320,6 +323,9 @@ void videoCapture() {
 		}
 	}
 
+	//Write the seek index and close the video container
+	videoEnd();
+
 	//Turn the display on if it was off before
 	if (!checkScreenLight())
 		enableScreenLight();
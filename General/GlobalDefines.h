@@ -51,14 +51,51 @@
 #define leptonVersion_3_shutter   1 //FLIR Lepton3 Shuttered
 #define leptonVersion_2_noShutter 2 //FLIR Lepton2 Non-Shuttered
 
+//Resolution of the raw values in the small buffer, Lepton2 stays at 80x60
+#define rawWidth  ((leptonVersion == leptonVersion_3_shutter) ? 160 : 80)
+#define rawHeight ((leptonVersion == leptonVersion_3_shutter) ? 120 : 60)
+
+//Lepton frame capture state
+#define leptonCapture_idle   0
+#define leptonCapture_busy   1
+#define leptonCapture_resync 2
+#define leptonCapture_done   3
+
+//Cached overlay elements of the live mode
+#define overlay_battery   0
+#define overlay_time      1
+#define overlay_date      2
+#define overlay_freeSpace 3
+#define overlay_spot      4
+#define overlay_spotTemp  5
+#define overlay_colorBar  6
+#define overlay_elements  7
+#define overlay_none      255
+
+//Maximum pixel runs of the overlay cache
+#if defined(__MK66FX1M0__)
+#define overlay_maxRuns 2048
+#else
+#define overlay_maxRuns 768
+#endif
+
 //Temperature format
 #define tempFormat_celcius    0
 #define tempFormat_fahrenheit 1
 
 //Filter type
-#define filterType_none     0
-#define filterType_gaussian 1
-#define filterType_box      2
+#define filterType_none      0
+#define filterType_gaussian  1
+#define filterType_box       2
+#define filterType_gaussian5 3
+#define filterType_median    4
+#define filterType_bilateral 5
+
+//Automatic gain control mode
+#define agcMode_linear     0
+#define agcMode_percentile 1
+#define agcMode_equalize   2
+#define agcMode_local      3
 
 //Display Min/Max Points
 #define minMaxPoints_disabled 0
@@ -164,6 +201,7 @@
 #define eeprom_hqRes            168
 #define eeprom_noShutter        169
 #define eeprom_batComp			170
+#define eeprom_agcMode          171
 #define eeprom_fwVersion        250
 #define eeprom_setValue         200
 
@@ -215,6 +253,16 @@
 #define cal_standard 1
 #define cal_manual   2
 #define cal_stdSlope 0.0300f //Standard slope value
+#define cal_maxSamples 100 //Samples of the calibration process
+#define cal_minSamples 30  //Samples before the process can stop early
+#define cal_converged 0.95f //Correlation to stop early
+#define cal_robustMin 10   //Samples before outliers are weighted down
+#define cal_huberK 1.345f  //Huber limit in residual standard deviations
+#define cal_minSigma 0.2f  //Lower bound of the residual standard deviation
+#define cal_trackForget 0.995f //Forgetting factor of the live tracking
+#define cal_trackMin 50    //Samples before the live tracking is applied
+#define cal_trackSpread 400.0f //Raw value variance needed to refine the slope
+#define cal_trackSlope 0.5f //Maximum relative change of the slope against the standard slope
 
 //Image save marker
 #define imgSave_disabled 0
@@ -228,6 +276,25 @@
 #define videoSave_recording  2
 #define videoSave_processing 3
 
+//Single file video container
+#define video_fileName    "VIDEO.TCV"
+#define video_indexName   "VIDEO.IDX"
+#define video_version     1
+#define video_headerSize  512
+#define video_recordHead  6
+#define video_trailerSize 12
+#define video_syncTime    2000
+
+//Raw data format
+#define rawFormat_plain 0
+#define rawFormat_rice  1
+
+//Rice coder limits
+#define rice_escape 24
+#define rice_reset  64
+//Longest code of one value, a unary quotient below the escape with the largest parameter
+#define rice_maxBits 41
+
 //Show menu state
 #define showMenu_disabled 0
 #define showMenu_desired  1
@@ -21,10 +21,11 @@ boolean checkDiagnostic(byte device);
 void startAltClockline(boolean sdStart = false);
 void showDiagnostic();
 void endAltClockline();
+void display_waitScreen();
 void bootScreen();
 void createSDName(char* filename, boolean folder = false);
 void saveBuffer(char* filename);
-void saveRawData(bool image, char* name, uint16_t framesCaptured = 0);
+void saveRawData(char* name);
 void settingsMenu();
 void displayMenu();
 void storageMenu();
@@ -36,7 +37,9 @@ void calibrationProcess(bool serial = false, bool firstStart = false);
 void readCalibration();
 void createVisCombImg();
 void lepton_getRawValues();
+void mlx90614_release();
 void serialConnect();
+bool proto_run();
 void showColorBar();
 void calculatePointPos(int16_t* xpos, int16_t* ypos, uint16_t pixelIndex);
 uint16_t tempToRaw(float temp);
@@ -55,6 +58,8 @@ void playVideo(char* dirname, int imgCount);
 bool massStoragePrompt();
 void clearTempPoints();
 float calFunction(uint16_t rawValue);
+void calSnapshot();
+int32_t calSnapCenti(uint16_t rawValue);
 void createThermalImg(bool small = false);
 void limitValues();
 void changeDisplayOptions(byte* pos);
@@ -73,13 +78,20 @@ uint16_t getVideoFrameNumber(char* dirname);
 void processVideoFrames(int framesCaptured, char* dirname);
 void displayRawData();
 void loadBMPImage(char* filename);
-void boxFilter();
-void gaussianFilter();
+void filterImage(bool live = false);
 void smallToBigBuffer(bool trans = false);
 void convertColors(bool small = false);
+void updateColorLUT();
 void createVideoFolder(char* dirname);
+void videoBegin();
+void videoSaveFrame();
+void videoEnd();
+uint32_t riceEncode(void (*sink)(uint8_t), uint16_t* reference, uint32_t limit);
+bool loadVideoOpen(char* dirname);
+void loadVideoFrame(uint16_t frame);
+void loadVideoClose();
 void compensateCalib();
-void refreshTempPoints();
+void calcFrameStats();
 void floatToBytes(uint8_t* farray, float val);
 float bytesToFloat(uint8_t* farray);
 void disableScreenLight();
@@ -19,6 +19,8 @@
 unsigned short* bigBuffer;
 //160x120 buffer
 unsigned short* smallBuffer;
+//DMA channel of the SPI transmit FIFO, shared by display and Lepton
+DMAChannel spiTxDMA(false);
 
 //Fonts
 extern uint8_t tinyFont[];
@@ -39,6 +41,14 @@ SdFat sd;
 SdFile sdFile;
 String sdInfo;
 
+//Single file video container, open during recording and playback
+SdFile videoFile;
+bool videoContainer = false;
+//Number of frames, raw values per frame and seek index position of the container
+uint16_t videoContainerFrames;
+uint16_t videoContainerValues;
+uint32_t videoIndexPos;
+
 //Save filename 
 char saveFilename[20];
 
@@ -47,6 +57,8 @@ ADC *batMeasure;
 //Battery
 int8_t batPercentage;
 long batTimer;
+//USB voltage present at the last battery check
+bool batCharging;
 int8_t batComp;
 
 //Convert RAW to BMP
@@ -68,6 +80,7 @@ bool spotEnabled;
 bool colorbarEnabled;
 bool storageEnabled;
 byte filterType;
+byte agcMode;
 byte minMaxPoints;
 
 //Temperature format
@@ -116,6 +129,8 @@ byte calStatus;
 float calComp;
 //Calibration warmup timer
 long calTimer;
+//Refine the manual calibration during live mode
+bool calTracking = false;
 
 //Min & max lepton raw values
 uint16_t maxValue;
@@ -127,6 +142,21 @@ uint16_t minTempVal;
 uint16_t maxTempPos;
 uint16_t maxTempVal;
 
+//Statistics of the current frame, collected in one pass
+struct FrameStats {
+	uint16_t minValue;
+	uint16_t minPos;
+	uint16_t maxValue;
+	uint16_t maxPos;
+	uint32_t sum;
+	uint64_t sumSquares;
+	uint16_t histogram[64];
+	uint16_t centerAverage;
+	//Number of raw values in the sums and the histogram
+	uint16_t count;
+};
+FrameStats frameStats;
+
 //Hot / Cold mode
 byte hotColdMode;
 int16_t hotColdLevel;
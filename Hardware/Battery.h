@@ -49,6 +49,7 @@ void checkBattery(bool start = false, bool calibrate = false) {
 
 	//Check if the device is charging
 	int vUSB = analogRead(pin_usb_measure);
+	batCharging = (vUSB > 50);
 	//Battery is not working if no voltage measured and not connected to USB
 	if ((vBat == -1) && (vUSB <= 50))
 		setDiagnostic(diag_bat);
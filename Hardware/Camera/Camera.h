@@ -38,16 +38,35 @@ IODEV camera_iodev;
 
 //Buffer to store the JPEG data
 uint8_t* camera_jpegData;
+//Persistent JPEG buffer for streaming and its size
+uint8_t* camera_streamData = NULL;
+uint32_t camera_streamSize = 0;
+//A capture has been triggered and not transferred yet
+bool camera_pending = false;
 
 //The current camera resolution
 byte camera_resolution;
 
+//Visible part of the decoded image after the alignment
+JRECT camera_view;
+//Framebuffer index of a decoded pixel is base + (y * row) + (x * step)
+int32_t camera_dstBase;
+int32_t camera_dstRow;
+int16_t camera_dstStep;
+
+//Weight of the visual image in combined mode, 0 to 256
+uint16_t camera_alpha = 128;
+//Value of adjCombAlpha the weight was calculated for
+float camera_alphaValue = 0.5;
+
 
 /* Methods */
 
 /* Capture an image on the camera */
 void camera_capture(void)
 {
+	camera_pending = true;
+
 	//Arducam-Mini
 	if (teensyVersion == teensyVersion_new)
 		ov2640_capture();
@@ -56,6 +75,29 @@ void camera_capture(void)
 		vc0706_capture();
 }
 
+/* Get the JPEG buffer for streaming, it only grows if a frame does not fit */
+uint8_t* camera_getStreamData(uint32_t length)
+{
+	if (length > camera_streamSize) {
+		free(camera_streamData);
+		//Headroom for more detailed frames of the same resolution
+		camera_streamSize = length + (length / 4);
+		camera_streamData = (uint8_t*)malloc(camera_streamSize);
+		if (camera_streamData == NULL)
+			camera_streamSize = 0;
+	}
+	return camera_streamData;
+}
+
+/* Free the JPEG buffer for streaming when no visual image is shown */
+void camera_releaseStream()
+{
+	free(camera_streamData);
+	camera_streamData = NULL;
+	camera_streamSize = 0;
+	camera_pending = false;
+}
+
 /* Change the resolution of the camera */
 void camera_changeRes(byte camRes)
 {
@@ -63,6 +105,9 @@ void camera_changeRes(byte camRes)
 	if (!checkDiagnostic(diag_camera))
 		return;
 
+	//The stream buffer is sized again for the new resolution
+	camera_releaseStream();
+
 	//Change resolution
 	camera_resolution = camRes;
 
@@ -152,134 +197,132 @@ void camera_init(void)
 	camera_setSaveRes();
 }
 
+/* Calculate the visible part and the placement of the decoded image once per frame */
+void camera_setView(int16_t width, int16_t height, bool mirror) {
+	//Source pixels that stay inside the screen after the alignment
+	camera_view.left = 5 * adjCombLeft;
+	camera_view.right = (width - 1) - (5 * adjCombRight);
+	camera_view.top = 5 * adjCombUp;
+	camera_view.bottom = (height - 1) - (5 * adjCombDown);
+
+	//Alignment offset
+	camera_dstBase = (5 * (adjCombDown - adjCombUp) * width) + (5 * (adjCombRight - adjCombLeft));
+	camera_dstRow = width;
+	camera_dstStep = 1;
+
+	//Mirror visual image horizontally, the visible part mirrors as well
+	if (mirror) {
+		uint16_t left = camera_view.left;
+		camera_view.left = (width - 1) - camera_view.right;
+		camera_view.right = (width - 1) - left;
+		camera_dstBase += width - 1;
+		camera_dstStep = -1;
+	}
+
+	//Rotated, count from the end of the buffer
+	if (rotationEnabled) {
+		camera_dstBase = ((int32_t)width * height - 1) - camera_dstBase;
+		camera_dstRow = -camera_dstRow;
+		camera_dstStep = -camera_dstStep;
+	}
+}
+
 /* Normal output function for the JPEG Decompressor - Teensy 3.6 */
 unsigned int camera_decompOutNormal(JDEC * jd, void * bitmap, JRECT * rect)
 {
 	unsigned short * bmp = (unsigned short *)bitmap;
-	unsigned short x, y;
-	uint32_t count = 0;
-	uint32_t imagepos;
-
-	//Go through the image vertically
-	for (y = rect->top; y <= rect->bottom; y++) {
-
-		//Check if we draw inside the screen on y position
-		if (((y + (5 * adjCombDown) <= 239) && (y - (5 * adjCombUp) >= 0))) {
-
-			//Go through the image horizontally
-			for (x = rect->left; x <= rect->right; x++) {
-
-				//Check if we draw inside the screen on x position
-				if (((x + (5 * adjCombRight) <= 319) && (x - (5 * adjCombLeft) >= 0))) {
-
-					//Get the image position
-					imagepos = x + (y * 320);
-
-					//Do the visual alignment
-					imagepos += 5 * adjCombRight;
-					imagepos -= 5 * adjCombLeft;
-					imagepos += 5 * adjCombDown * 320;
-					imagepos -= 5 * adjCombUp * 320;
-
-					//Do not use zero
-					if (bmp[count] == 0)
-						bmp[count] = 1;
-
-					//Write to image buffer, rotated
-					if (rotationEnabled)
-						bigBuffer[76799 - imagepos] = bmp[count];
-					//Write to image buffer, normal
-					else
-						bigBuffer[imagepos] = bmp[count];;
-				}
-
-				//Raise counter
-				count++;
-			}
+	uint16_t width = rect->right - rect->left + 1;
+
+	//Clip the rectangle to the visible part
+	uint16_t left = max(rect->left, camera_view.left);
+	uint16_t right = min(rect->right, camera_view.right);
+	uint16_t top = max(rect->top, camera_view.top);
+	uint16_t bottom = min(rect->bottom, camera_view.bottom);
+	if ((left > right) || (top > bottom))
+		return 1;
+
+	//Go through the visible rows
+	for (uint16_t y = top; y <= bottom; y++) {
+		unsigned short* src = bmp + ((y - rect->top) * width) + (left - rect->left);
+		unsigned short* dst = bigBuffer + camera_dstBase + (y * camera_dstRow) + (left * camera_dstStep);
+
+		for (uint16_t x = left; x <= right; x++) {
+			//Do not use zero
+			unsigned short pixel = *src++;
+			*dst = pixel ? pixel : 1;
+			dst += camera_dstStep;
 		}
 	}
 	return 1;
 }
 
+/* Recalculate the integer weight when the combined alpha has been changed */
+void camera_updateAlpha() {
+	if (adjCombAlpha != camera_alphaValue) {
+		camera_alphaValue = adjCombAlpha;
+		camera_alpha = constrain((int)roundf(adjCombAlpha * 256), 0, 256);
+	}
+}
+
+/* Blend two RGB565 pixels of the thermal and visual image, packed into one word each */
+inline uint32_t camera_blend2(uint32_t thermal, uint32_t visual) {
+	uint32_t alpha = camera_alpha;
+	uint32_t inv = 256 - alpha;
+	//Each channel of both pixels in its own 16 bit lane, the products stay below 2^14
+	uint32_t red = ((((thermal >> 11) & 0x001F001F) * inv) + (((visual >> 11) & 0x001F001F) * alpha) + 0x00800080) >> 8;
+	uint32_t green = ((((thermal >> 5) & 0x003F003F) * inv) + (((visual >> 5) & 0x003F003F) * alpha) + 0x00800080) >> 8;
+	uint32_t blue = (((thermal & 0x001F001F) * inv) + ((visual & 0x001F001F) * alpha) + 0x00800080) >> 8;
+	//Back to two RGB565 pixels
+	return ((red & 0x001F001F) << 11) | ((green & 0x003F003F) << 5) | (blue & 0x001F001F);
+}
+
+/* Blend a single RGB565 pixel */
+inline uint16_t camera_blend(uint16_t thermal, uint16_t visual) {
+	return camera_blend2(thermal, visual);
+}
+
 /* Combined output function for the JPEG Decompressor - Teensy 3.1 / 3.2 only */
 unsigned int camera_decompOutCombined(JDEC * jd, void * bitmap, JRECT * rect) {
-	//Help Variables
-	byte redV, greenV, blueV, redT, greenT, blueT, red, green, blue, xPos;
-	unsigned short pixel, x, y, imagepos, count;
 	unsigned short * bmp = (unsigned short *)bitmap;
-	count = 0;
-	//Go through the visual image
-	for (y = rect->top; y <= rect->bottom; y++) {
-
-		//Check if we draw inside the screen on y position
-		if (((y + (5 * adjCombDown) <= 119) && (y - (5 * adjCombUp) >= 0))) {
-
-			for (x = rect->left; x <= rect->right; x++) {
-
-				//Mirror visual image for old HW
-				if (mlx90614Version == mlx90614Version_old)
-					xPos = (159 - x);
-				else
-					xPos = x;
-
-				//Check if we draw inside the screen on x position
-				if (((xPos + (5 * adjCombRight) <= 159) && (xPos - (5 * adjCombLeft) >= 0))) {
-
-					//Get the image position
-					imagepos = xPos + (y * 160);
-					//Do the visual alignment
-					imagepos += 5 * adjCombRight;
-					imagepos -= 5 * adjCombLeft;
-					imagepos += 5 * adjCombDown * 160;
-					imagepos -= 5 * adjCombUp * 160;
-
-					//Create combined pixel out of thermal and visual
-					if (displayMode == displayMode_combined) {
-						//Get the visual image color
-						pixel = bmp[count++];
-						//And extract the RGB values out of it
-						redV = (pixel & 0xF800) >> 8;
-						greenV = (pixel & 0x7E0) >> 3;
-						blueV = (pixel & 0x1F) << 3;
-
-						//Get the thermal image color, rotated
-						if (rotationEnabled)
-							pixel = smallBuffer[19199 - imagepos];
-						//Get the thermal image color, normal
-						else
-							pixel = smallBuffer[imagepos];
-						//And extract the RGB values out of it
-						redT = (pixel & 0xF800) >> 8;
-						greenT = (pixel & 0x7E0) >> 3;
-						blueT = (pixel & 0x1F) << 3;
-
-						//Mix both
-						red = redT * (1 - adjCombAlpha) + redV * adjCombAlpha;
-						green = greenT * (1 - adjCombAlpha) + greenV * adjCombAlpha;
-						blue = blueT * (1 - adjCombAlpha) + blueV * adjCombAlpha;
-
-						//Set the pixel to the calculated RGB565 value
-						pixel = (((red & 248) | green >> 5) << 8)
-							| ((green & 28) << 3 | blue >> 3);
-
-					}
-
-					//Set pixel to visual image only
-					else
-						pixel = bmp[count++];
-
-					//Write to image buffer, rotated
-					if (rotationEnabled)
-						smallBuffer[19199 - imagepos] = pixel;
-					//Write to image buffer, normal
-					else
-						smallBuffer[imagepos] = pixel;
-				}
-				//Raise counter if it is not inside the image
-				else
-					count++;
+	uint16_t width = rect->right - rect->left + 1;
+
+	//Clip the rectangle to the visible part
+	uint16_t left = max(rect->left, camera_view.left);
+	uint16_t right = min(rect->right, camera_view.right);
+	uint16_t top = max(rect->top, camera_view.top);
+	uint16_t bottom = min(rect->bottom, camera_view.bottom);
+	if ((left > right) || (top > bottom))
+		return 1;
+
+	//Go through the visible rows
+	for (uint16_t y = top; y <= bottom; y++) {
+		unsigned short* src = bmp + ((y - rect->top) * width) + (left - rect->left);
+		unsigned short* dst = smallBuffer + camera_dstBase + (y * camera_dstRow) + (left * camera_dstStep);
+		uint16_t x = left;
+
+		//Visual only, copy the pixels
+		if (displayMode != displayMode_combined) {
+			for (; x <= right; x++) {
+				*dst = *src++;
+				dst += camera_dstStep;
 			}
+			continue;
 		}
+
+		//Blend two pixels with the thermal image at once
+		for (; x < right; x += 2) {
+			uint32_t visual = src[0] | ((uint32_t)src[1] << 16);
+			uint32_t thermal = dst[0] | ((uint32_t)dst[camera_dstStep] << 16);
+			uint32_t pixels = camera_blend2(thermal, visual);
+			dst[0] = pixels;
+			dst[camera_dstStep] = pixels >> 16;
+			src += 2;
+			dst += 2 * camera_dstStep;
+		}
+
+		//Odd pixel at the end of the row
+		if (x == right)
+			*dst = camera_blend(*dst, *src);
 	}
 	return 1;
 }
@@ -295,8 +338,8 @@ unsigned int camera_decompIn(JDEC * jd, byte* buff, unsigned int ndata) {
 	return ndata;
 }
 
-/* Transfer, decompress or save the visual image */
-void camera_get(byte mode, char* dirname = NULL)
+/* Transfer, decompress or save the visual image, returns false if it could not be transferred */
+bool camera_get(byte mode, char* dirname = NULL)
 {
 	uint32_t jpegLen;
 
@@ -312,32 +355,32 @@ void camera_get(byte mode, char* dirname = NULL)
 	else
 		jpegLen = vc0706_frameLength();
 
-	//Buffer for Teensy 3.1 / 3.2
-	if (teensyVersion == teensyVersion_old)
+	//The frame in the camera is transferred now
+	camera_pending = false;
+
+	//When streaming, use the persistent buffer
+	if (mode == camera_stream)
 	{
-		//When streaming, allocate bytes
-		if (mode == camera_stream)
-			camera_jpegData = (uint8_t*)malloc(jpegLen);
-		//For saving and serial, do write directly
-		else
-			camera_jpegData = NULL;
+		camera_jpegData = camera_getStreamData(jpegLen);
+		//Out of memory, skip this frame
+		if (camera_jpegData == NULL)
+			return false;
 	}
-	//Buffer for Teensy 3.6
+	//For saving and serial, do write directly on Teensy 3.1 / 3.2
+	else if (teensyVersion == teensyVersion_old)
+		camera_jpegData = NULL;
+	//Allocate the JPEG data on Teensy 3.6, the EXIF header is written separately
 	else
-	{
-		//If rotated and not streaming, add EXIF header
-		if ((rotationEnabled) && (mode != camera_stream))
-			camera_jpegData = (uint8_t*)malloc(jpegLen + 100);
-		//Otherwise allocate byte for JPEG data only
-		else
-			camera_jpegData = (uint8_t*)malloc(jpegLen);
-	}
+		camera_jpegData = (uint8_t*)malloc(jpegLen);
 
 	//Arducam
 	if (teensyVersion == teensyVersion_new) {
 		//Stream
-		if (mode == camera_stream)
+		if (mode == camera_stream) {
 			ov2640_transfer(camera_jpegData, 1, &jpegLen);
+			//The FIFO is free, capture the next frame while this one is decoded
+			camera_capture();
+		}
 
 		//Save
 		else if (mode == camera_save) {
@@ -350,8 +393,14 @@ void camera_get(byte mode, char* dirname = NULL)
 			//Create JPEG file
 			createJPEGFile(dirname);
 
-			//Write to SD file, EXIF included if rotated
-			sdFile.write(camera_jpegData, jpegLen);
+			//Write to SD file, with the EXIF header after the JFIF start if rotated
+			if (rotationEnabled) {
+				sdFile.write(camera_jpegData, 20);
+				sdFile.write(exifHeader_rotated, 100);
+				sdFile.write(&camera_jpegData[20], jpegLen - 20);
+			}
+			else
+				sdFile.write(camera_jpegData, jpegLen);
 
 			//Close file
 			sdFile.close();
@@ -367,20 +416,27 @@ void camera_get(byte mode, char* dirname = NULL)
 			//Transfer from camera
 			ov2640_transfer(camera_jpegData, 0, &jpegLen);
 			
-			//Send length
-			Serial.write((jpegLen & 0xFF00) >> 8);
-			Serial.write(jpegLen & 0x00FF);
-
-			//Send JPEG bytestream to serial port
-			Serial.write(camera_jpegData, jpegLen);
+			//Send length, including the EXIF header if rotated
+			uint32_t sendLen = rotationEnabled ? jpegLen + 100 : jpegLen;
+			Serial.write((sendLen & 0xFF00) >> 8);
+			Serial.write(sendLen & 0x00FF);
+
+			//Send JPEG bytestream to serial port, with the EXIF header after the JFIF start if rotated
+			if (rotationEnabled) {
+				Serial.write(camera_jpegData, 20);
+				Serial.write(exifHeader_rotated, 100);
+				Serial.write(&camera_jpegData[20], jpegLen - 20);
+			}
+			else
+				Serial.write(camera_jpegData, jpegLen);
 
 			//Free buffer
 			free(camera_jpegData);
 		}
 	}
-	//PTC-06 or PTC-08
-	else
-		vc0706_transfer(camera_jpegData, jpegLen, mode, dirname);
+	//PTC-06 or PTC-08, nothing to decompress when the camera stopped answering
+	else if (!vc0706_transfer(camera_jpegData, jpegLen, mode, dirname))
+		return false;
 
 	//For streaming, decompress data and capture next frame
 	if (mode == camera_stream) {
@@ -395,15 +451,28 @@ void camera_get(byte mode, char* dirname = NULL)
 		//Prepare the image for convertion to RGB565
 		jd_prepare(&camera_jd, camera_decompIn, camera_jdwork, 3100, &camera_iodev);
 
+		//Target is 320x240 or 160x120, mirrored for old HW in the small buffer
+		bool big = (teensyVersion == teensyVersion_new) && (hqRes);
+		uint16_t width = big ? 320 : 160;
+		camera_setView(width, big ? 240 : 120, !big && (mlx90614Version == mlx90614Version_old));
+
+		//Descale larger images while decoding
+		byte scale = 0;
+		while ((scale < 3) && ((camera_jd.width >> scale) > width))
+			scale++;
+
+		//MCUs outside the visible part are not transformed
+		camera_jd.roi = camera_view;
+
 		//Decompress into 320x240 buffer
-		if ((teensyVersion == teensyVersion_new) && (hqRes))
-			jd_decomp(&camera_jd, camera_decompOutNormal, 0);
+		if (big)
+			jd_decomp(&camera_jd, camera_decompOutNormal, scale);
 
 		//Decompress into 160x120 buffer, also with transparency
-		else
-			jd_decomp(&camera_jd, camera_decompOutCombined, 0);
-
-		//Free the jpeg data array
-		free(camera_jpegData);
+		else {
+			camera_updateAlpha();
+			jd_decomp(&camera_jd, camera_decompOutCombined, scale);
+		}
 	}
+	return true;
 }
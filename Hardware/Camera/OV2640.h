@@ -87,10 +87,14 @@
 #define FIFO_SIZE2 0x43
 #define FIFO_SIZE3 0x44
 
+//Bytes read from the FIFO per SPI block transfer
+#define ov2640_chunkSize 512
+
 /* Methods */
 
 /* I2C Write 8bit address, 8bit data */
 byte ov2640_wrSensorReg8_8(int regID, int regDat) {
+	mlx90614_release();
 	Wire.beginTransmission(0x60 >> 1);
 	Wire.write(regID & 0x00FF);
 	Wire.write(regDat & 0x00FF);
@@ -105,6 +109,7 @@ byte ov2640_wrSensorReg8_8(int regID, int regDat) {
 
 /* I2C Read 8bit address, 8bit data */
 byte ov2640_rdSensorReg8_8(uint8_t regID, uint8_t* regDat) {
+	mlx90614_release();
 	Wire.beginTransmission(0x60 >> 1);
 	Wire.write(regID & 0x00FF);
 	Wire.endTransmission();
@@ -288,9 +293,9 @@ uint32_t ov2640_readFifoLength(void) {
 
 /* Start the FIFO burst mode */
 void ov2640_startFifoBurst(void) {
+	startAltClockline();
 	CORE_PIN8_CONFIG = PORT_PCR_MUX(2);
 	CORE_PIN12_CONFIG = PORT_PCR_MUX(1);
-	startAltClockline();
 	SPI.beginTransaction(SPISettings(SPISPEED, MSBFIRST, SPI_MODE0));
 	digitalWriteFast(pin_cam_cs, LOW);
 	SPI.transfer(BURST_FIFO_READ);
@@ -387,18 +392,18 @@ void ov2640_transfer(uint8_t * jpegData, boolean stream, uint32_t* length)
 {
 repeat:
 
-	//Count variable
+	//Bytes stored and bytes left in the FIFO
 	uint32_t counter = 0;
+	uint32_t remaining = *length;
+	//Last byte of the previous chunk, for markers across chunks
+	uint8_t last = 0x00;
+	boolean is_header = 0;
 
 	//Start FIFO Burst
 	ov2640_startFifoBurst();
 
-	//Transfer data
-	uint8_t temp = 0xff, temp_last;
-	boolean is_header = 0;
-
-	//Repeat as long as needed
-	while (counter < *length)
+	//Read the FIFO in chunks, directly into the JPEG buffer
+	while (remaining > 0)
 	{
 		//If main menu should be entered
 		if (showMenu == showMenu_desired)
@@ -409,49 +414,62 @@ repeat:
 			return;
 		}
 
-		//Save last byte
-		temp_last = temp;
-		//Get new byte over SPI
-		temp = SPI.transfer(0x00);
+		//Get the next chunk over SPI
+		uint16_t chunk = min(remaining, (uint32_t)ov2640_chunkSize);
+		uint8_t* data = &jpegData[counter];
+		SPI.transfer(data, chunk);
+		remaining -= chunk;
 
-		//Normal bytestream
-		if (is_header)
-		{
-			jpegData[counter] = temp;
-			counter++;
-		}
-
-		//Start byte sqeuence
-		else if ((temp == 0xD8) & (temp_last == 0xFF))
+		//Find the start byte sequence, it is moved to the beginning
+		uint16_t start = 0;
+		if (!is_header)
 		{
+			while ((start < chunk) && !((data[start] == 0xD8) && (((start == 0) ? last : data[start - 1]) == 0xFF)))
+				start++;
+			//Not in this chunk, discard it
+			if (start == chunk)
+			{
+				last = data[chunk - 1];
+				continue;
+			}
 			is_header = 1;
-			jpegData[0] = temp_last;
-			jpegData[1] = temp;
-			counter = 2;
-		}
-
-		//If rotation enabled and saving / sending, include EXIF header
-		if ((counter == 20) && (!stream) && (rotationEnabled))
-		{
-			for (uint8_t i = 0; i < 100; i++)
+			//Start sequence within the chunk
+			if (start > 0)
 			{
-				jpegData[counter + i] = exifHeader_rotated[i];
+				memmove(jpegData, &data[start - 1], chunk - start + 1);
+				counter = chunk - start + 1;
 			}
-			counter += 100;
+			//Start sequence across chunks, a chunk was discarded before
+			else
+			{
+				memmove(&jpegData[1], data, chunk);
+				jpegData[0] = 0xFF;
+				counter = chunk + 1;
+			}
+			//Search the end sequence after the start sequence
+			start = 2;
+			data = jpegData;
 		}
+		else
+			counter += chunk;
 
-		//End byte sequence
-		if (((temp == 0xD9) && (temp_last == 0xFF)))
+		//Find the end byte sequence in the new bytes
+		uint8_t* end = &jpegData[counter];
+		for (uint8_t* pos = &data[start]; pos < end; pos++)
 		{
-			//Stop FIFO Burst
-			ov2640_endFifoBurst();
-			
-			//Save length
-			*length = counter;
+			if ((*pos == 0xD9) && (((pos == data) ? last : *(pos - 1)) == 0xFF))
+			{
+				//Stop FIFO Burst
+				ov2640_endFifoBurst();
 
-			//Everything was OK
-			return;
+				//Save length
+				*length = (pos - jpegData) + 1;
+
+				//Everything was OK
+				return;
+			}
 		}
+		last = *(end - 1);
 	}
 
 	//Stop FIFO Burst
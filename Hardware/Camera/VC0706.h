@@ -19,12 +19,23 @@
 #define VC0706_320x240 0x11
 #define VC0706_160x120 0x22
 
+//Divider values for the baudrate command
+#define vc0706_baud38400  0x2AF2
+#define vc0706_baud115200 0x0DA6
+
+//Size of one read command, equal to one SD sector
+#define vc0706_chunkSize 512
+//Number of retries for one chunk before the transfer is aborted
+#define vc0706_retries 5
+
 /* Variables */
 
 uint8_t  serialNum = 0;
 uint8_t  camerabuff[101];
 uint8_t  bufferLen = 0;
 uint16_t frameptr = 0;
+//Chunk buffer for serial transfer and sector buffer for saving
+uint8_t vc0706_chunk[vc0706_chunkSize] __attribute__((aligned(4)));
 
 //EXIF header for horizontal mirror in ThermocamV4
 const uint8_t exifHeader_mirror[] =
@@ -104,9 +115,9 @@ boolean vc0706_end() {
 }
 
 
-/* Change the baudrate */
-boolean vc0706_changeBaudRate() {
-	uint8_t args[] = { 0x03, 0x01, 0x0D, 0xA6 };
+/* Change the baudrate, the answer is sent with the old one */
+boolean vc0706_changeBaudRate(uint16_t divider) {
+	uint8_t args[] = { 0x03, 0x01, (uint8_t)(divider >> 8), (uint8_t)(divider & 0xFF) };
 	return vc0706_runCommand(0x24, args, sizeof(args), 5);
 }
 
@@ -130,30 +141,6 @@ boolean vc0706_setCompression(uint8_t c) {
 	return vc0706_runCommand(0x31, args, sizeof(args), 5);
 }
 
-/* Transfer a package from the VC0706 camera */
-void vc0706_transPackage(byte bytesToRead, uint8_t* buffer)
-{
-	int avail;
-	//Send counter and buffer length to zero
-	uint8_t counter = 0;
-	uint8_t bufferLen = 0;
-	//As long as no timeout and not all bytes read
-	while ((10 != counter) && (bufferLen != (bytesToRead + 5))) {
-		//Check how many bytes are available
-		avail = Serial1.available();
-		//If there are none, raise timeout counter
-		if (avail <= 0) {
-			delay(1);
-			counter++;
-			continue;
-		}
-		//Reset timeout counter if there is a packet
-		counter = 0;
-		//Add the data to the buffer
-		buffer[bufferLen++] = Serial1.read();
-	}
-}
-
 /* Control the framebuffer */
 boolean vc0706_cameraFrameBuffCtrl(uint8_t command) {
 	uint8_t args[] = { 0x1, command };
@@ -187,43 +174,60 @@ uint8_t vc0706_available(void) {
 	return bufferLen;
 }
 
-/* Read the JPEG picture */
-boolean vc0706_readPicture(uint8_t n) {
+/* Send the read command for the next part of the JPEG picture */
+void vc0706_requestPicture(uint16_t n) {
 	uint8_t args[] = { 0x0C, 0x0, 0x0A,
 		0, 0, (uint8_t)(frameptr >> 8), (uint8_t)(frameptr & 0xFF),
-		0, 0, 0, n,
+		0, 0, (uint8_t)(n >> 8), (uint8_t)(n & 0xFF),
 		10 >> 8, 10 & 0xFF };
+	vc0706_sendCommand(0x32, args, sizeof(args));
+}
 
-	if (!vc0706_runCommand(0x32, args, sizeof(args), 5, 0))
-		return 0;
-	frameptr += n;
-	return 1;
+/* Read a part of the JPEG picture, returns the number of bytes received */
+uint16_t vc0706_readPicture(uint8_t* buffer, uint16_t n) {
+	uint16_t pos = 0;
+	uint8_t counter = 0;
+	//As long as no timeout and not all bytes read
+	while ((10 != counter) && (pos != n)) {
+		int avail = Serial1.available();
+		//If there are none, raise timeout counter
+		if (avail <= 0) {
+			delay(1);
+			counter++;
+			continue;
+		}
+		counter = 0;
+		//Take everything from the UART buffer at once
+		if (avail > n - pos)
+			avail = n - pos;
+		Serial1.readBytes((char*)&buffer[pos], avail);
+		pos += avail;
+	}
+	return pos;
 }
 
-/* Transfer the JPEG bytestream*/
-void vc0706_transfer(uint8_t* jpegData, uint16_t jpegLen, byte mode, char* dirname)
+/* Transfer the JPEG bytestream, returns false when the camera stopped answering */
+bool vc0706_transfer(uint8_t* jpegData, uint16_t jpegLen, byte mode, char* dirname)
 {
-	//Count variable
-	uint16_t counter = 0;
-
-	//Create the buffer
-	uint8_t* buffer = (uint8_t*)malloc(128 + 5);
+	//Fill level of the chunk buffer
+	uint16_t pos = 0;
+	//Retries for the current chunk
+	byte retries = 0;
+	//Bytes announced and sent over serial
+	uint16_t sendLen = 0;
+	uint16_t sent = 0;
+
+	//When rotation is enabled or using the ThermocamV4, insert EXIF after the first 40 bytes
+	bool exif = (mode != camera_stream) &&
+		((rotationEnabled && (mlx90614Version == mlx90614Version_new)) || (mlx90614Version == mlx90614Version_old));
+	const uint8_t* exifHeader = (mlx90614Version == mlx90614Version_old) ? exifHeader_mirror : exifHeader_rotated;
 
 	//For serial transfer, send frame length
 	if (mode == camera_serial)
 	{
-		//When rotation is enabled or using the ThermocamV4, send EXIF
-		if ((rotationEnabled && (mlx90614Version == mlx90614Version_new)) || (mlx90614Version == mlx90614Version_old))
-		{
-			Serial.write(((jpegLen + 100) & 0xFF00) >> 8);
-			Serial.write((jpegLen + 100) & 0x00FF);
-		}
-		//Send JPEG Bytestream only
-		else
-		{
-			Serial.write((jpegLen & 0xFF00) >> 8);
-			Serial.write(jpegLen & 0x00FF);
-		}
+		sendLen = exif ? jpegLen + 100 : jpegLen;
+		Serial.write((sendLen & 0xFF00) >> 8);
+		Serial.write(sendLen & 0x00FF);
 	}
 
 	//For saving to SD card
@@ -235,93 +239,99 @@ void vc0706_transfer(uint8_t* jpegData, uint16_t jpegLen, byte mode, char* dirna
 		createJPEGFile(dirname);
 	}
 
+	//Request the first chunk, only up to the EXIF position if required
+	uint16_t n = min(jpegLen, exif ? 40 : vc0706_chunkSize);
+	vc0706_requestPicture(n);
+
 	//Transfer data
 	while (jpegLen > 0) {
-		//Calculate the bytes left to read
-		uint8_t bytesToRead = min(jpegLen, 128);
-
-		//Send the read command
-		if (!vc0706_readPicture(bytesToRead))
+		//Verify the answer and read the data, directly to the JPEG buffer for streaming
+		uint8_t* dest = (mode == camera_stream) ? &jpegData[frameptr] : &vc0706_chunk[pos];
+		if ((vc0706_readResponse(5, 200) != 5) || !vc0706_verifyResponse(0x32) ||
+			(vc0706_readPicture(dest, n) != n)) {
+			//Give up when the camera does not answer anymore
+			if (++retries == vc0706_retries)
+				break;
+			//Clear the input and request the same chunk again
+			vc0706_readResponse(100, 10);
+			vc0706_requestPicture(n);
 			continue;
-
-		//Transfer a package
-		vc0706_transPackage(bytesToRead, buffer);
-
-		//For streaming, add it to the jpeg data buffer
-		if (mode == camera_stream)
-		{
-			for (int i = 0; i < bytesToRead; i++) {
-				jpegData[counter] = buffer[i];
-				counter++;
-			}
 		}
+		retries = 0;
+		frameptr += n;
+		jpegLen -= n;
 
-		//For serial transfer
-		if (mode == camera_serial)
+		//Fill the chunk buffer, with the EXIF header after the first chunk
+		if (mode != camera_stream)
 		{
-			//Rotation on DIY-Thermocam V1 or V2
-			if ((counter == 0) && rotationEnabled && (mlx90614Version == mlx90614Version_new))
-			{
-				Serial.write(buffer, 40);
-				Serial.write(exifHeader_rotated, 100);
-				Serial.write(&buffer[40], (bytesToRead - 40));
-				counter++;
-			}
-			//Mirror on ThermocamV4
-			else if ((counter == 0) && (mlx90614Version == mlx90614Version_old))
-			{
-				Serial.write(buffer, 40);
-				Serial.write(exifHeader_mirror, sizeof(exifHeader_mirror));
-				Serial.write(&buffer[40], (bytesToRead - 40));
-				counter++;
+			pos += n;
+			if (exif) {
+				memcpy(&vc0706_chunk[pos], exifHeader, 100);
+				pos += 100;
+				exif = false;
 			}
-			//No EXIF
-			else
-				Serial.write(buffer, bytesToRead);
 		}
 
-		//For saving to SD card
-		if (mode == camera_save)
+		//Serial sends every chunk, saving only writes full sectors
+		bool flush = (mode == camera_serial) ||
+			((mode == camera_save) && ((pos == vc0706_chunkSize) || (jpegLen == 0)));
+		uint16_t len = pos;
+		if (flush)
+			pos = 0;
+		//Next chunk fills the rest of the sector buffer
+		uint16_t next = min(jpegLen, vc0706_chunkSize - pos);
+
+		//Request the next chunk before the current one is finished, except when the SD card is written
+		bool pipeline = (jpegLen > 0) && !(flush && (mode == camera_save));
+		if (pipeline)
+			vc0706_requestPicture(next);
+
+		//Read the trailing answer
+		vc0706_readResponse(5, 10);
+
+		//Write out the chunk buffer
+		if (flush)
 		{
-			//Rotation on DIY-Thermocam V1 or V2
-			if ((counter == 0) && rotationEnabled && (mlx90614Version == mlx90614Version_new))
-			{
-				sdFile.write(buffer, 40);
-				sdFile.write(exifHeader_rotated, 100);
-				sdFile.write(&buffer[40], (bytesToRead - 40));
-				counter++;
-			}
-			//Mirror on ThermocamV4
-			else if ((counter == 0) && (mlx90614Version == mlx90614Version_old))
-			{
-				sdFile.write(buffer, 40);
-				sdFile.write(exifHeader_mirror, sizeof(exifHeader_mirror));
-				sdFile.write(&buffer[40], (bytesToRead - 40));
-				counter++;
+			if (mode == camera_serial) {
+				Serial.write(vc0706_chunk, len);
+				sent += len;
 			}
-			//No EXIF
 			else
-				sdFile.write(buffer, bytesToRead);
+				sdFile.write(vc0706_chunk, len);
 		}
 
-		//Substract transfered bytes from total
-		jpegLen -= bytesToRead;
+		//Request the next chunk after the SD write
+		if ((jpegLen > 0) && !pipeline)
+			vc0706_requestPicture(next);
+		n = next;
 	}
 
-	//Free the buffer
-	free(buffer);
-
 	//End transmission
 	vc0706_end();
 
+	//Aborted, fill up the announced length with zeros so the host stays in sync, the image has no end marker
+	if ((mode == camera_serial) && (sent < sendLen)) {
+		memset(vc0706_chunk, 0, vc0706_chunkSize);
+		while (sent < sendLen) {
+			uint16_t len = min(sendLen - sent, vc0706_chunkSize);
+			Serial.write(vc0706_chunk, len);
+			sent += len;
+		}
+	}
+
 	//For saving to SD, close file
 	if (mode == camera_save)
 	{
+		//Do not leave a truncated image on the card
+		if (jpegLen > 0)
+			sdFile.remove();
 		//Close the file
-		sdFile.close();
+		else
+			sdFile.close();
 		//End SD Transmission
 		endAltClockline();
 	}
+	return (jpegLen == 0);
 }
 
 /* Start connecting to the camera */
@@ -331,11 +341,17 @@ void vc0706_begin(void) {
 	//Wait
 	delay(15);
 	//Change baudrate
-	vc0706_changeBaudRate();
+	vc0706_changeBaudRate(vc0706_baud115200);
 	//Reconnect using 115.2k
 	Serial1.begin(115200);
 	//Wait
 	delay(15);
+	//Check the link, the camera might have missed the change
+	if (vc0706_getImageSize() != 0xFF)
+		return;
+	//Fall back to the default baudrate
+	Serial1.begin(38400);
+	delay(15);
 }
 
 /* Init the camera module */
@@ -477,7 +477,8 @@ void block_idct (
 
 static
 JRESULT mcu_load (
-	JDEC* jd		/* Pointer to the decompressor object */
+	JDEC* jd,		/* Pointer to the decompressor object */
+	int idct		/* Apply the IDCT, only the stream is decoded otherwise */
 )
 {
 	long *tmp = (long*)jd->workbuf;	/* Block working buffer for de-quantize and IDCT */
@@ -542,7 +543,7 @@ JRESULT mcu_load (
 
 		if (JD_USE_SCALE && jd->scale == 3)
 			*bp = (*tmp / 256) + 128;	/* If scale ratio is 1/8, IDCT can be ommited and only DC element is used */
-		else
+		else if (idct)
 			block_idct(tmp, bp);		/* Apply IDCT and store the block to the MCU buffer */
 
 		bp += 64;				/* Next block */
@@ -778,6 +779,8 @@ JRESULT jd_prepare (
 	jd->infunc = infunc;	/* Stream input function */
 	jd->device = dev;		/* I/O device identifier */
 	jd->nrst = 0;			/* No restart interval (default) */
+	jd->roi.left = jd->roi.top = 0;		/* Whole image (default) */
+	jd->roi.right = jd->roi.bottom = 0xFFFF;
 
 	for (i = 0; i < 2; i++) {	/* Nulls pointers */
 		for (j = 0; j < 2; j++) {
@@ -933,7 +936,7 @@ JRESULT jd_decomp (
 	unsigned char scale								/* Output de-scaling factor (0 to 3) */
 )
 {
-	unsigned int x, y, mx, my;
+	unsigned int x, y, mx, my, roi;
 	unsigned short rst, rsc;
 	JRESULT rc;
 
@@ -954,8 +957,11 @@ JRESULT jd_decomp (
 				if (rc != JDR_OK) return rc;
 				rst = 1;
 			}
-			rc = mcu_load(jd);					/* Load an MCU (decompress huffman coded stream and apply IDCT) */
+			roi = (x >> scale) <= jd->roi.right && ((x + mx) >> scale) > jd->roi.left	/* MCU inside the region of interest? */
+				&& (y >> scale) <= jd->roi.bottom && ((y + my) >> scale) > jd->roi.top;
+			rc = mcu_load(jd, roi);				/* Load an MCU (decompress huffman coded stream and apply IDCT) */
 			if (rc != JDR_OK) return rc;
+			if (!roi) continue;					/* The stream is decoded, but nothing is output */
 			rc = mcu_output(jd, outfunc, x, y);	/* Output the MCU (color space conversion, scaling and output) */
 			if (rc != JDR_OK) return rc;
 		}
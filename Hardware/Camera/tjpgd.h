@@ -8,7 +8,7 @@
 
 #define	JD_SZBUF		512	/* Size of stream input buffer */
 #define JD_FORMAT		1	/* Output pixel format 0:RGB888 (3 unsigned char/pix), 1:RGB565 (1 unsigned short/pix) */
-#define	JD_USE_SCALE	0	/* Use descaling feature for output */
+#define	JD_USE_SCALE	1	/* Use descaling feature for output */
 #define JD_TBLCLIP		1	/* Use table for saturation (might be a bit faster but increases 1K bytes of code size) */
 
 /*---------------------------------------------------------------------------*/
@@ -63,6 +63,7 @@ struct JDEC {
 	unsigned int sz_pool;			/* Size of momory pool (bytes available) */
 	unsigned int (*infunc)(JDEC*, unsigned char*, unsigned int);/* Pointer to jpeg stream input function */
 	void* device;			/* Pointer to I/O device identifiler for the session */
+	JRECT roi;				/* Region of interest in output pixels, other MCUs are not transformed */
 };
 
 
@@ -53,6 +53,11 @@
 #define CMD_SET_ROTATION       139
 #define CMD_SET_CALIBRATION    140
 #define CMD_GET_HQRESOLUTION   141
+#define CMD_GET_PROFILE        142
+#define CMD_SET_PROFILEOVERLAY 143
+#define CMD_PROTOCOL_V2        144
+#define CMD_SET_CALTRACKING    145
+#define CMD_SET_AGCMODE        146
 
 //Serial frame commands
 #define CMD_FRAME_RAW          150
@@ -65,11 +70,71 @@
 #define FRAME_CAPTURE_VIDEO    182
 #define FRAME_NORMAL           183
 
+//Protocol v2 sync bytes at the start of every packet
+#define proto_sync1            0xA5
+#define proto_sync2            0x5A
+//Sync, type, sequence number and 32 bit length
+#define proto_headerSize       8
+//Maximum payload of a request packet
+#define proto_maxRequest       16
+
+//Protocol v2 packet types from the host
+#define proto_subscribe        1
+#define proto_getFrame         2
+#define proto_end              3
+//Protocol v2 packet types to the host
+#define proto_ack              128
+#define proto_nack             129
+#define proto_frame            130
+#define proto_event            131
+
+//Protocol v2 frame types
+#define proto_frameRaw         0
+#define proto_frameColor       1
+#define proto_frameDisplay     2
+#define proto_frameDelta       3
+#define proto_frameNone        255
+
+//Coding of a delta stream frame
+#define proto_deltaFrame       0
+#define proto_deltaKey         1
+#define proto_deltaPlain       2
+//Send a key frame after this number of delta frames
+#define proto_keyInterval      30
+
 /* Variables */
 
 //Command, default send frame
 byte sendCmd = FRAME_NORMAL;
 
+//Frame type pushed for every new frame in protocol v2
+byte proto_subscribed = proto_frameNone;
+//Sequence number of the next packet to the host
+byte proto_txSeq = 0;
+//CRC of the packet currently sent
+uint16_t proto_txCRC;
+//Request packet currently received
+byte proto_rxBuffer[proto_headerSize + proto_maxRequest + 2];
+byte proto_rxPos = 0;
+//Color and display frames to send after the raw ones, and the type requested first
+uint16_t proto_pendingColor = 0;
+uint16_t proto_pendingDisplay = 0;
+byte proto_pendingFirst;
+
+//Reference frame of the delta stream is up to date
+bool proto_deltaValid = false;
+//Delta frames since the last key frame
+byte proto_deltaCount = 0;
+//Coded frame staged until its length is known
+byte* proto_stage;
+uint32_t proto_stagePos;
+
+//CRC-16/CCITT lookup table for one nibble
+const uint16_t proto_crcTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
 /* Methods */
 
 /* Get integer out of a text string */
@@ -91,6 +156,60 @@ bool checkNoDisplay()
 	return false;
 }
 
+/* Update the CRC-16/CCITT with one byte */
+inline uint16_t proto_crc(uint16_t crc, byte data) {
+	crc = (crc << 4) ^ proto_crcTable[(crc >> 12) ^ (data >> 4)];
+	crc = (crc << 4) ^ proto_crcTable[(crc >> 12) ^ (data & 0x0F)];
+	return crc;
+}
+
+/* Start a protocol v2 packet to the host */
+void proto_begin(byte type, uint32_t length) {
+	byte header[proto_headerSize] = { proto_sync1, proto_sync2, type, proto_txSeq++,
+		(byte)(length >> 24), (byte)(length >> 16), (byte)(length >> 8), (byte)length };
+
+	//The CRC covers everything after the sync bytes
+	proto_txCRC = 0xFFFF;
+	for (byte i = 2; i < proto_headerSize; i++)
+		proto_txCRC = proto_crc(proto_txCRC, header[i]);
+	Serial.write(header, proto_headerSize);
+}
+
+/* Write payload bytes of a protocol v2 packet */
+void proto_write(const byte* data, uint16_t length) {
+	for (uint16_t i = 0; i < length; i++)
+		proto_txCRC = proto_crc(proto_txCRC, data[i]);
+	Serial.write(data, length);
+}
+
+/* Finish a protocol v2 packet with the CRC */
+void proto_finish() {
+	Serial.write((proto_txCRC & 0xFF00) >> 8);
+	Serial.write(proto_txCRC & 0x00FF);
+	Serial.flush();
+}
+
+/* Send 16 bit values in big endian, staged in chunks for bulk writes */
+void sendPixels(uint16_t* buffer, uint32_t count, bool framed = false) {
+	byte chunk[512];
+	uint32_t pos = 0;
+
+	while (pos < count) {
+		uint16_t len = min(count - pos, (uint32_t)(sizeof(chunk) / 2));
+		//Swap to big endian
+		for (uint16_t i = 0; i < len; i++) {
+			chunk[2 * i] = (buffer[pos + i] & 0xFF00) >> 8;
+			chunk[(2 * i) + 1] = buffer[pos + i] & 0x00FF;
+		}
+		//Write the chunk as one block
+		if (framed)
+			proto_write(chunk, 2 * len);
+		else
+			Serial.write(chunk, 2 * len);
+		pos += len;
+	}
+}
+
 /* Send the lepton raw limits */
 void sendRawLimits() {
 	//Send min
@@ -103,25 +222,12 @@ void sendRawLimits() {
 
 /* Send the lepton raw data*/
 void sendRawData(bool color = false) {
-	uint16_t result;
-
 	//For the Lepton2 sensor, write 4800 raw values
-	if ((leptonVersion != leptonVersion_3_shutter) && (!color)) {
-		for (int line = 0; line < 60; line++) {
-			for (int column = 0; column < 80; column++) {
-				result = smallBuffer[(line * 2 * 160) + (column * 2)];
-				Serial.write((result & 0xFF00) >> 8);
-				Serial.write(result & 0x00FF);
-			}
-		}
-	}
+	if ((leptonVersion != leptonVersion_3_shutter) && (!color))
+		sendPixels(smallBuffer, 4800);
 	//For the Lepton3 sensor, write 19200 raw values
-	else {
-		for (int i = 0; i < 19200; i++) {
-			Serial.write((smallBuffer[i] & 0xFF00) >> 8);
-			Serial.write(smallBuffer[i] & 0x00FF);
-		}
-	}
+	else
+		sendPixels(smallBuffer, 19200);
 }
 
 /* Sends the framebuffer */
@@ -129,23 +235,11 @@ void sendFramebuffer()
 {
 	//160x120
 	if ((teensyVersion == teensyVersion_old) || (!hqRes))
-	{
-		for (int i = 0; i < 19200; i++)
-		{
-			Serial.write((smallBuffer[i] & 0xFF00) >> 8);
-			Serial.write(smallBuffer[i] & 0x00FF);
-		}
-	}
+		sendPixels(smallBuffer, 19200);
 
 	//320x240
 	else
-	{
-		for (uint32_t i = 0; i < 76800; i++)
-		{
-			Serial.write((bigBuffer[i] & 0xFF00) >> 8);
-			Serial.write(bigBuffer[i] & 0x00FF);
-		}
-	}
+		sendPixels(bigBuffer, 76800);
 }
 
 /* Sends the configuration data */
@@ -645,7 +739,7 @@ void setFilterType()
 	byte read = Serial.read();
 
 	//Check if it has a valid number
-	if ((read >= filterType_none) && (read <= filterType_box))
+	if ((read >= filterType_none) && (read <= filterType_bilateral))
 	{
 		//Set filter type to input
 		filterType = read;
@@ -711,6 +805,121 @@ void sendDiagnostic()
 	Serial.write(diagnostic);
 }
 
+/* Send the profiler statistics and the lepton error counters */
+void sendProfile()
+{
+	uint32_t stats[4];
+
+	//Number of stages
+	Serial.write(profiler_stages);
+
+	//Min, average, max and 99th percentile in microseconds for every stage
+	for (byte stage = 0; stage < profiler_stages; stage++) {
+		profiler_getStats(stage, stats);
+		for (byte i = 0; i < 4; i++) {
+			Serial.write((stats[i] >> 24) & 0xFF);
+			Serial.write((stats[i] >> 16) & 0xFF);
+			Serial.write((stats[i] >> 8) & 0xFF);
+			Serial.write(stats[i] & 0xFF);
+		}
+	}
+
+	//Invalid lepton packages and resyncs
+	uint32_t counters[2] = { lepton_packageErrors, lepton_resyncs };
+	for (byte i = 0; i < 2; i++) {
+		Serial.write((counters[i] >> 24) & 0xFF);
+		Serial.write((counters[i] >> 16) & 0xFF);
+		Serial.write((counters[i] >> 8) & 0xFF);
+		Serial.write(counters[i] & 0xFF);
+	}
+}
+
+/* Show or hide the frame rate overlay */
+void setProfileOverlay()
+{
+	//If not enough data available, leave
+	if (Serial.available() < 1)
+	{
+		Serial.write(CMD_INVALID);
+		return;
+	}
+
+	//Read byte from serial port
+	byte read = Serial.read();
+
+	//Check if it has a valid number
+	if ((read >= 0) && (read <= 1))
+		profiler_overlay = read;
+	//Send invalid
+	else
+	{
+		Serial.write(CMD_INVALID);
+		return;
+	}
+
+	//Send ACK
+	Serial.write(CMD_SET_PROFILEOVERLAY);
+}
+
+/* Enable or disable the live calibration tracking */
+void setCalTracking()
+{
+	//If not enough data available, leave
+	if (Serial.available() < 1)
+	{
+		Serial.write(CMD_INVALID);
+		return;
+	}
+
+	//Read byte from serial port
+	byte read = Serial.read();
+
+	//Check if it has a valid number
+	if ((read >= 0) && (read <= 1))
+		calTracking = read;
+	//Send invalid
+	else
+	{
+		Serial.write(CMD_INVALID);
+		return;
+	}
+
+	//Send ACK
+	Serial.write(CMD_SET_CALTRACKING);
+}
+
+/* Set the automatic gain control mode */
+void setAgcMode()
+{
+	//If not enough data available, leave
+	if (Serial.available() < 1)
+	{
+		Serial.write(CMD_INVALID);
+		return;
+	}
+
+	//Read byte from serial port
+	byte read = Serial.read();
+
+	//Check if it has a valid number
+	if ((read >= agcMode_linear) && (read <= agcMode_local))
+	{
+		//Set AGC mode to input
+		agcMode = read;
+		//Save to EEPROM
+		EEPROM.write(eeprom_agcMode, agcMode);
+	}
+	//Send invalid
+	else
+	{
+		Serial.write(CMD_INVALID);
+		return;
+	}
+
+	//Send ACK
+	Serial.write(CMD_SET_AGCMODE);
+}
+
 /* Send the HQ Resolution information */
 void sendHQResolution()
 {
@@ -761,11 +970,8 @@ void sendFrame(bool color) {
 		Serial.clear();
 		//Convert to colors
 		if (color) {
-			//Apply low-pass filter
-			if (filterType == filterType_box)
-				boxFilter();
-			else if (filterType == filterType_gaussian)
-				gaussianFilter();
+			//Apply the selected filter
+			filterImage();
 			//Convert to RGB565
 			convertColors(true);
 		}
@@ -784,6 +990,28 @@ void sendFrame(bool color) {
 		sendCmd = FRAME_NORMAL;
 }
 
+/* Render the display content into the framebuffer */
+void createDisplayFrame() {
+	//Find min / max position, statistics come from the serial loop
+	if (minMaxPoints != minMaxPoints_disabled)
+		refreshMinMax();
+
+	//Apply the selected filter
+	filterImage();
+
+	//Teensy 3.6 - Resize to big buffer when HQRes
+	if ((teensyVersion == teensyVersion_new) && (hqRes))
+		smallToBigBuffer();
+
+	//Convert lepton data to RGB565 colors
+	convertColors();
+
+	//Display additional information
+	imgSave = imgSave_create;
+	displayInfos();
+	imgSave = imgSave_disabled;
+}
+
 /* Sends the display content as frame */
 void sendDisplayFrame() {
 	//Send type of frame response
@@ -792,27 +1020,8 @@ void sendDisplayFrame() {
 
 	//Send frame
 	if (sendCmd == FRAME_NORMAL) {
-		//Find min / max position
-		if (minMaxPoints != minMaxPoints_disabled)
-			refreshMinMax();
-
-		//Apply low-pass filter
-		if (filterType == filterType_box)
-			boxFilter();
-		else if (filterType == filterType_gaussian)
-			gaussianFilter();
-
-		//Teensy 3.6 - Resize to big buffer when HQRes
-		if ((teensyVersion == teensyVersion_new) && (hqRes))
-			smallToBigBuffer();
-
-		//Convert lepton data to RGB565 colors
-		convertColors();
-
-		//Display additional information
-		imgSave = imgSave_create;
-		displayInfos();
-		imgSave = imgSave_disabled;
+		//Render the display content
+		createDisplayFrame();
 
 		//Send the framebuffer
 		sendFramebuffer();
@@ -962,6 +1171,22 @@ bool serialHandler() {
 	case CMD_GET_HQRESOLUTION:
 		sendHQResolution();
 		break;
+		//Get the profiler statistics
+	case CMD_GET_PROFILE:
+		sendProfile();
+		break;
+		//Show or hide the frame rate overlay
+	case CMD_SET_PROFILEOVERLAY:
+		setProfileOverlay();
+		break;
+		//Enable or disable the live calibration tracking
+	case CMD_SET_CALTRACKING:
+		setCalTracking();
+		break;
+		//Change the automatic gain control mode
+	case CMD_SET_AGCMODE:
+		setAgcMode();
+		break;
 		//Send raw frame
 	case CMD_FRAME_RAW:
 		sendFrame(false);
@@ -974,6 +1199,9 @@ bool serialHandler() {
 	case CMD_FRAME_DISPLAY:
 		sendDisplayFrame();
 		break;
+		//Switch to the framed protocol v2
+	case CMD_PROTOCOL_V2:
+		return proto_run();
 		//End connection
 	case CMD_END:
 		return true;
@@ -1045,6 +1273,342 @@ bool touchHandler()
 }
 
 
+/* Get the next frame and its statistics for the serial modes */
+void serialGetFrame() {
+	//Check warmup status
+	checkWarmup();
+
+	//Get the temps
+	if (checkDiagnostic(diag_lep_data))
+		lepton_getRawValues();
+
+	//Compensate calibration with object temp
+	if (checkDiagnostic(diag_spot))
+		compensateCalib();
+	//Calibration of this frame for the colors and the temperature labels
+	calSnapshot();
+
+	//Get min, max and temp points in one pass
+	calcFrameStats();
+
+	//Find min and max if not in manual mode and limits not locked
+	if ((autoMode) && (!limitsLocked))
+		limitValues();
+
+	//Check button press if not in terminal mode
+	if (extButtonPressed())
+		buttonHandler();
+}
+
+/* Send a protocol v2 acknowledge for a request */
+void proto_sendAck(byte type, byte seq) {
+	byte payload[2] = { type, seq };
+	proto_begin(proto_ack, 2);
+	proto_write(payload, 2);
+	proto_finish();
+}
+
+/* Send a protocol v2 negative acknowledge for a request */
+void proto_sendNack(byte type, byte seq) {
+	byte payload[2] = { type, seq };
+	proto_begin(proto_nack, 2);
+	proto_write(payload, 2);
+	proto_finish();
+}
+
+/* Send a button or touch event as protocol v2 packet */
+void proto_sendEvent(byte event) {
+	proto_begin(proto_event, 1);
+	proto_write(&event, 1);
+	proto_finish();
+}
+
+/* Get the reference frame of the delta stream, NULL if there is no room for it */
+uint16_t* proto_deltaRef() {
+	//Teensy 3.6 - the big buffer is free in serial mode
+	if (teensyVersion == teensyVersion_new)
+		return bigBuffer;
+	//Lepton2 - behind the 80x60 raw values
+	if (leptonVersion != leptonVersion_3_shutter)
+		return &smallBuffer[4800];
+	//Teensy 3.2 with Lepton3 only sends key frames
+	return NULL;
+}
+
+/* Get the free memory for the coded frame, NULL if there is no room for it */
+byte* proto_deltaStage() {
+	//Teensy 3.6 - behind the reference in the big buffer
+	if (teensyVersion == teensyVersion_new)
+		return (byte*)&bigBuffer[19200];
+	//Lepton2 - behind the reference in the small buffer
+	if (leptonVersion != leptonVersion_3_shutter)
+		return (byte*)&smallBuffer[9600];
+	//Teensy 3.2 with Lepton3 sends plain values
+	return NULL;
+}
+
+/* Add a coded byte to the staged frame */
+void proto_stageByte(uint8_t value) {
+	proto_stage[proto_stagePos++] = value;
+}
+
+/* Send the raw values coded against the last frame */
+void proto_sendDelta(byte* header, byte headerSize) {
+	uint16_t* reference = proto_deltaRef();
+	uint32_t plainSize = 2 * rawWidth * rawHeight;
+
+	//Key frame at the start, periodically for resync and when the reference is lost
+	byte coding = proto_deltaFrame;
+	if ((reference == NULL) || (!proto_deltaValid) || (proto_deltaCount >= proto_keyInterval))
+		coding = proto_deltaKey;
+
+	//Code into the free memory, noisy frames like after the shutter can get bigger than plain values
+	uint32_t size = 0;
+	proto_stage = proto_deltaStage();
+	proto_stagePos = 0;
+	if (proto_stage != NULL)
+		size = riceEncode(proto_stageByte, (coding == proto_deltaFrame) ? reference : NULL, plainSize - 1);
+	if (size == 0) {
+		coding = proto_deltaPlain;
+		size = plainSize;
+	}
+
+	//Header, coding and data
+	proto_begin(proto_frame, headerSize + 1 + size);
+	proto_write(header, headerSize);
+	proto_write(&coding, 1);
+	if (coding == proto_deltaPlain)
+		sendPixels(smallBuffer, rawWidth * rawHeight, true);
+	else
+		proto_write(proto_stage, size);
+	proto_finish();
+
+	//Keep the current frame as reference for the next one
+	if (reference != NULL)
+		memcpy(reference, smallBuffer, plainSize);
+
+	//Delta frames follow until the next key interval
+	proto_deltaValid = (reference != NULL);
+	proto_deltaCount = (coding == proto_deltaFrame) ? proto_deltaCount + 1 : 0;
+}
+
+/* Render the current frame for color or display frame packets, the raw values are lost */
+void proto_convertFrame(byte type) {
+	//The delta reference survives in the big buffer unless the display frame is rendered there
+	uint16_t* reference = proto_deltaRef();
+	if ((reference != bigBuffer) || ((type == proto_frameDisplay) && (hqRes)))
+		proto_deltaValid = false;
+
+	//Filtered RGB565 image without overlays
+	if (type == proto_frameColor) {
+		filterImage();
+		convertColors(true);
+	}
+	//Display content
+	else
+		createDisplayFrame();
+}
+
+/* Send a raw, color or display frame as protocol v2 packet, color and display ones have been rendered */
+void proto_sendFrame(byte type) {
+	byte header[21];
+	uint16_t* buffer = smallBuffer;
+	uint16_t width = 160;
+	uint16_t height = 120;
+
+	//Raw values in the native sensor resolution
+	if ((type == proto_frameRaw) || (type == proto_frameDelta)) {
+		width = rawWidth;
+		height = rawHeight;
+	}
+	//Display content, 320x240 on the Teensy 3.6 with HQRes
+	else if ((type == proto_frameDisplay) && (teensyVersion == teensyVersion_new) && (hqRes)) {
+		buffer = bigBuffer;
+		width = 320;
+		height = 240;
+	}
+
+	//Frame type, size and raw limits
+	header[0] = type;
+	header[1] = (width & 0xFF00) >> 8;
+	header[2] = width & 0x00FF;
+	header[3] = (height & 0xFF00) >> 8;
+	header[4] = height & 0x00FF;
+	header[5] = (minValue & 0xFF00) >> 8;
+	header[6] = minValue & 0x00FF;
+	header[7] = (maxValue & 0xFF00) >> 8;
+	header[8] = maxValue & 0x00FF;
+	//Spot temperature and calibration
+	floatToBytes(&header[9], mlx90614_temp);
+	floatToBytes(&header[13], (float)calOffset);
+	floatToBytes(&header[17], (float)calSlope);
+
+	//Raw values coded against the last frame
+	if (type == proto_frameDelta) {
+		proto_sendDelta(header, sizeof(header));
+		return;
+	}
+
+	//Send header and pixels
+	uint32_t count = (uint32_t)width * height;
+	proto_begin(proto_frame, sizeof(header) + (2 * count));
+	proto_write(header, sizeof(header));
+	sendPixels(buffer, count, true);
+	proto_finish();
+}
+
+/* Keep a color or display frame for the end of the frame, after the raw ones */
+void proto_deferFrame(byte type) {
+	if ((proto_pendingColor == 0) && (proto_pendingDisplay == 0))
+		proto_pendingFirst = type;
+	if (type == proto_frameColor)
+		proto_pendingColor++;
+	else
+		proto_pendingDisplay++;
+}
+
+/* Render and send the kept frames of one type, the other one follows with the next frame */
+void proto_sendDeferred() {
+	byte type = proto_pendingFirst;
+	uint16_t* pending = (type == proto_frameColor) ? &proto_pendingColor : &proto_pendingDisplay;
+	if (*pending == 0)
+		return;
+
+	//Render once for all requests of this type
+	proto_convertFrame(type);
+	while (*pending > 0) {
+		proto_sendFrame(type);
+		(*pending)--;
+	}
+	proto_pendingFirst = (type == proto_frameColor) ? proto_frameDisplay : proto_frameColor;
+}
+
+/* Evaluate a complete protocol v2 request, returns true to go back to v1 */
+bool proto_handleRequest(uint32_t length) {
+	byte type = proto_rxBuffer[2];
+	byte seq = proto_rxBuffer[3];
+	byte* payload = &proto_rxBuffer[proto_headerSize];
+
+	//Check the CRC over everything after the sync bytes
+	uint16_t crc = 0xFFFF;
+	for (byte i = 2; i < proto_headerSize + length; i++)
+		crc = proto_crc(crc, proto_rxBuffer[i]);
+	if (crc != ((payload[length] << 8) | payload[length + 1])) {
+		proto_sendNack(type, seq);
+		return false;
+	}
+
+	switch (type) {
+		//Push the given frame type for every new frame, none to stop
+	case proto_subscribe:
+		if ((length != 1) || ((payload[0] > proto_frameDelta) && (payload[0] != proto_frameNone)))
+			break;
+		proto_subscribed = payload[0];
+		proto_sendAck(type, seq);
+		return false;
+		//Send a single frame, the frame packet is the answer
+	case proto_getFrame:
+		if ((length != 1) || (payload[0] > proto_frameDelta))
+			break;
+		//Color and display frames overwrite the raw values, they are sent after the raw ones
+		if ((payload[0] == proto_frameColor) || (payload[0] == proto_frameDisplay))
+			proto_deferFrame(payload[0]);
+		else
+			proto_sendFrame(payload[0]);
+		return false;
+		//Go back to protocol v1, answer the kept frames of this frame first
+	case proto_end:
+		proto_sendDeferred();
+		proto_pendingColor = 0;
+		proto_pendingDisplay = 0;
+		proto_sendAck(type, seq);
+		return true;
+	}
+
+	//Invalid request
+	proto_sendNack(type, seq);
+	return false;
+}
+
+/* Receive the available bytes of a protocol v2 request, returns true to go back to v1 */
+bool proto_receive() {
+	while (Serial.available() > 0) {
+		byte data = Serial.read();
+
+		//Wait for the sync bytes
+		if ((proto_rxPos == 0) && (data != proto_sync1))
+			continue;
+		if ((proto_rxPos == 1) && (data != proto_sync2)) {
+			proto_rxPos = (data == proto_sync1) ? 1 : 0;
+			continue;
+		}
+		proto_rxBuffer[proto_rxPos++] = data;
+
+		//Header not complete yet
+		if (proto_rxPos < proto_headerSize)
+			continue;
+
+		uint32_t length = ((uint32_t)proto_rxBuffer[4] << 24) | ((uint32_t)proto_rxBuffer[5] << 16) |
+			(proto_rxBuffer[6] << 8) | proto_rxBuffer[7];
+		//Request too long, resync on the next packet
+		if (length > proto_maxRequest) {
+			proto_sendNack(proto_rxBuffer[2], proto_rxBuffer[3]);
+			proto_rxPos = 0;
+			continue;
+		}
+
+		//Payload and CRC received
+		if (proto_rxPos == proto_headerSize + length + 2) {
+			proto_rxPos = 0;
+			if (proto_handleRequest(length))
+				return true;
+		}
+	}
+	return false;
+}
+
+/* Run the framed protocol v2, returns true when the connection ends */
+bool proto_run() {
+	//Acknowledge the switch, everything afterwards is framed
+	Serial.write(CMD_PROTOCOL_V2);
+	Serial.flush();
+	proto_subscribed = proto_frameNone;
+	proto_txSeq = 0;
+	proto_rxPos = 0;
+	proto_deltaValid = false;
+	proto_pendingColor = 0;
+	proto_pendingDisplay = 0;
+
+	while (true) {
+		//End connection when touched long or send visual event when short
+		if (touch_touched() && checkDiagnostic(diag_touch))
+			if (touchHandler())
+				return true;
+
+		//Get the next frame
+		serialGetFrame();
+
+		//Button and touch presses are sent as events
+		if (sendCmd != FRAME_NORMAL) {
+			proto_sendEvent(sendCmd);
+			sendCmd = FRAME_NORMAL;
+		}
+
+		//Evaluate requests from the host
+		if (proto_receive())
+			return false;
+
+		//Push the new frame when subscribed, color and display frames after the raw ones
+		if ((proto_subscribed == proto_frameColor) || (proto_subscribed == proto_frameDisplay))
+			proto_deferFrame(proto_subscribed);
+		else if (proto_subscribed != proto_frameNone)
+			proto_sendFrame(proto_subscribed);
+
+		//Render the color and display frames last
+		proto_sendDeferred();
+	}
+}
+
 /* Check for serial connection */
 void checkSerial() {
 	//If start command received
@@ -1099,27 +1663,8 @@ void serialOutput() {
 			if (touchHandler())
 				break;
 
-		//Check warmup status
-		checkWarmup();
-
-		//Get the temps
-		if (checkDiagnostic(diag_lep_data))
-			lepton_getRawValues();
-
-		//Compensate calibration with object temp
-		if (checkDiagnostic(diag_spot))
-			compensateCalib();
-
-		//Refresh the temp points
-		refreshTempPoints();
-
-		//Find min and max if not in manual mode and limits not locked
-		if ((autoMode) && (!limitsLocked))
-			limitValues();
-
-		//Check button press if not in terminal mode
-		if (extButtonPressed())
-			buttonHandler();
+		//Get the next frame
+		serialGetFrame();
 
 		//Check for serial commands
 		if (Serial.available() > 0) {
@@ -47,6 +47,35 @@ byte fch, fcl, bch, bcl, orient;
 uint16_t imageX, imageY;
 boolean display_writeToImage;
 
+//Two lines of SPI command words for the screen DMA
+uint32_t display_dmaLines[2][320];
+//Buffer that is written to the screen and if it is doubled
+uint16_t* display_dmaBuffer;
+bool display_dmaSmall;
+//Screen line that is currently transmitted
+volatile uint16_t display_dmaLine;
+//DMA is still queueing lines, cleared by the interrupt after the last one
+volatile bool display_dmaBusy = false;
+//Screen transaction has not been ended yet
+bool display_dmaActive = false;
+//SPI configuration before the screen transaction
+uint32_t display_dmaMCR;
+
+//Pixel runs of the overlay cache, position in the lower 17 bits and length above
+uint32_t display_overlayRuns[overlay_maxRuns];
+uint16_t display_overlayColors[overlay_maxRuns];
+//Number of runs used by all elements
+uint16_t display_overlayUsed = 0;
+//First run, number of runs, key and drawing context of each element
+uint16_t display_overlayStart[overlay_elements];
+uint16_t display_overlayCount[overlay_elements];
+uint32_t display_overlayKeys[overlay_elements];
+uint32_t display_overlayContext[overlay_elements];
+bool display_overlayValid[overlay_elements];
+//Element that is currently recorded and if it did not fit
+byte display_overlayRecord = overlay_none;
+bool display_overlayFull;
+
 /* Methods */
 
 void display_waitFifoNotFull()
@@ -136,13 +165,104 @@ void display_setAddr(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
 	display_writedata16_cont(y1);
 }
 
+/* Wait for the screen DMA to finish and release the SPI bus */
+void display_waitScreen()
+{
+	//No screen transfer running
+	if (!display_dmaActive)
+		return;
+
+	//Wait until the last line has been queued
+	while (display_dmaBusy);
+
+	//Wait for the end of queue and stop the FIFO requests
+	display_waitTransmitComplete(display_dmaMCR);
+	KINETISK_SPI0.RSER = 0;
+
+	SPI.endTransaction();
+	display_dmaActive = false;
+}
+
+/* Begin a SPI transaction for the display */
+void display_beginTransaction()
+{
+	//The bus may still be used by the screen DMA
+	display_waitScreen();
+	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+}
+
+/* Convert one screen line to SPI command words, doubled for the 160x120 array */
+void display_dmaFill(uint16_t line)
+{
+	uint32_t cmd = (pcs_data << 16) | SPI_PUSHR_CTAS(1) | SPI_PUSHR_CONT;
+
+	//160x120 array, each line is used for two screen lines
+	if (display_dmaSmall) {
+		uint16_t* src = &display_dmaBuffer[(line >> 1) * 160];
+		uint32_t* dest = display_dmaLines[(line >> 1) & 1];
+		for (byte x = 0; x < 160; x++) {
+			uint32_t word = src[x] | cmd;
+			*dest++ = word;
+			*dest++ = word;
+		}
+	}
+	//320x240 array
+	else {
+		uint16_t* src = &display_dmaBuffer[line * 320];
+		uint32_t* dest = display_dmaLines[line & 1];
+		for (uint16_t x = 0; x < 320; x++)
+			dest[x] = src[x] | cmd;
+	}
+}
+
+/* Let the DMA queue the current screen line */
+void display_dmaStartLine()
+{
+	uint16_t line = display_dmaLine;
+	byte shift = display_dmaSmall ? 1 : 0;
+	uint32_t* words = display_dmaLines[(line >> shift) & 1];
+
+	//Last pixel ends the queue and releases CS
+	if (line == 239)
+		words[319] = (words[319] & ~SPI_PUSHR_CONT) | SPI_PUSHR_EOQ;
+
+	spiTxDMA.sourceBuffer(words, 1280);
+	spiTxDMA.enable();
+
+	//Convert the next line of the buffer while this one is sent
+	if ((line < 239) && (((line + 1) >> shift) != (line >> shift)))
+		display_dmaFill(line + 1);
+}
+
+/* DMA interrupt, called after every queued screen line */
+void display_dmaISR()
+{
+	spiTxDMA.clearInterrupt();
+
+	//All lines queued, the transaction is ended by display_waitScreen()
+	if (++display_dmaLine == 240) {
+		display_dmaBusy = false;
+		return;
+	}
+
+	display_dmaStartLine();
+}
+
+/* Init the DMA channel for the screen transfer */
+void display_initDMA()
+{
+	spiTxDMA.begin();
+	spiTxDMA.triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_TX);
+	spiTxDMA.attachInterrupt(display_dmaISR);
+}
+
 /* Read 8-bit command from the screen */
 uint8_t display_readcommand8(uint8_t c, uint8_t index = 0)
 {
 	uint16_t wTimeout = 0xffff;
 	uint8_t r = 0;
 
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	while (((KINETISK_SPI0.SR) & (15 << 12)) && (--wTimeout));
 
 	KINETISK_SPI0.SR = SPI_SR_TCF;
@@ -179,7 +299,7 @@ uint8_t display_readcommand8(uint8_t c, uint8_t index = 0)
 /* Set display rotation */
 void display_setRotation(uint8_t m)
 {
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_writecommand_cont(ILI9341_MADCTL);
 	rotation = m % 4;
 	switch (rotation) {
@@ -221,7 +341,7 @@ byte display_InitLCD()
 	byte diag = display_readcommand8(ILI9341_RDSELFDIAG);
 
 	//Send the init commands
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	const uint8_t *addr = init_commands;
 	while (1) {
 		uint8_t count = *addr++;
@@ -239,7 +359,7 @@ byte display_InitLCD()
 	delay(120);
 
 	//Turn the display on
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_writecommand_last(ILI9341_DISPON);
 	SPI.endTransaction();
 
@@ -280,6 +400,9 @@ void display_init()
 		rotationEnabled = read;
 	else
 		rotationEnabled = 0;
+
+	//Prepare the screen DMA
+	display_initDMA();
 }
 
 /* Set the xy coordinates */
@@ -295,7 +418,7 @@ void display_setXY(word x1, word y1, word x2, word y2)
 
 	//Write to the display
 	if (!display_writeToImage) {
-		SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+		display_beginTransaction();
 		display_setAddr(x1, y1, x2, y2);
 		display_writecommand_last(ILI9341_RAMWR); // write to RAM
 		SPI.endTransaction();
@@ -330,7 +453,7 @@ void display_drawPixel(int x, int y)
 	if ((x < 0) || (x >= 320) || (y < 0) || (y >= 240))
 		return;
 	//Send pixel coordinates and color to screen
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x, y, x, y);
 	display_writecommand_cont(ILI9341_RAMWR);
 	display_writedata16_last(fch << 8 | fcl);
@@ -346,7 +469,7 @@ void display_drawHLine(int x, int y, int l)
 	if ((x + l - 1) >= 320)
 		l = 320 - x;
 
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x, y, x + l - 1, y);
 	display_writecommand_cont(ILI9341_RAMWR);
 	word color = (fch << 8 | fcl);
@@ -366,7 +489,7 @@ void display_drawVLine(int x, int y, int l)
 	if ((y + l - 1) >= 240)
 		l = 240 - y;
 
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x, y, x, y + l - 1);
 	display_writecommand_cont(ILI9341_RAMWR);
 	word color = (fch << 8 | fcl);
@@ -377,6 +500,113 @@ void display_drawVLine(int x, int y, int l)
 	SPI.endTransaction();
 }
 
+/* Combine a value into the key of an overlay element */
+uint32_t display_overlayKey(uint32_t key, uint32_t value)
+{
+	return (key ^ value) * 16777619;
+}
+
+/* Remove the runs of an overlay element from the cache */
+void display_overlayRemove(byte element)
+{
+	uint16_t start = display_overlayStart[element];
+	uint16_t count = display_overlayCount[element];
+	display_overlayValid[element] = false;
+	if (count == 0)
+		return;
+
+	//Move the runs of the following elements to the front
+	uint16_t tail = display_overlayUsed - start - count;
+	memmove(&display_overlayRuns[start], &display_overlayRuns[start + count], tail * 4);
+	memmove(&display_overlayColors[start], &display_overlayColors[start + count], tail * 2);
+	for (byte i = 0; i < overlay_elements; i++) {
+		if (display_overlayStart[i] > start)
+			display_overlayStart[i] -= count;
+	}
+	display_overlayUsed -= count;
+	display_overlayCount[element] = 0;
+}
+
+/* Blit an unchanged overlay element or start to record it, returns true if blitted */
+bool display_overlayCached(byte element, uint32_t key)
+{
+	//Only the image buffer is cached
+	if (!display_writeToImage)
+		return false;
+
+	//Font, color and buffer the runs have been recorded with
+	bool big = (teensyVersion == teensyVersion_new) && hqRes;
+	uint32_t context = display_overlayKey((uint32_t)cfont.font, (fch << 8) | fcl);
+	context = display_overlayKey(context, big);
+
+	//Nothing changed, copy the runs to the buffer
+	if ((display_overlayValid[element]) && (display_overlayKeys[element] == key) &&
+		(display_overlayContext[element] == context)) {
+		uint16_t* buffer = big ? bigBuffer : smallBuffer;
+		uint16_t end = display_overlayStart[element] + display_overlayCount[element];
+		for (uint16_t i = display_overlayStart[element]; i < end; i++) {
+			uint32_t run = display_overlayRuns[i];
+			uint16_t color = display_overlayColors[i];
+			uint16_t* dest = &buffer[run & 0x1FFFF];
+			for (uint16_t j = run >> 17; j > 0; j--)
+				*dest++ = color;
+		}
+		return true;
+	}
+
+	//Record it again at the end of the cache
+	display_overlayRemove(element);
+	display_overlayStart[element] = display_overlayUsed;
+	display_overlayKeys[element] = key;
+	display_overlayContext[element] = context;
+	display_overlayFull = false;
+	display_overlayRecord = element;
+	return false;
+}
+
+/* Stop to record the current overlay element */
+void display_overlayEnd()
+{
+	byte element = display_overlayRecord;
+	if (element == overlay_none)
+		return;
+	display_overlayRecord = overlay_none;
+
+	//Only use it if all runs did fit into the cache
+	if (display_overlayFull)
+		display_overlayRemove(element);
+	else
+		display_overlayValid[element] = true;
+}
+
+/* Add a pixel of the image buffer to the recorded overlay element */
+void display_overlayAdd(uint32_t pos, uint16_t color)
+{
+	uint16_t last = display_overlayUsed - 1;
+
+	//Extend the last run of the element if the pixel follows it
+	if (display_overlayCount[display_overlayRecord] != 0) {
+		uint32_t run = display_overlayRuns[last];
+		if ((display_overlayColors[last] == color) && (((run & 0x1FFFF) + (run >> 17)) == pos) &&
+			((run >> 17) < 32767)) {
+			display_overlayRuns[last] = run + (1 << 17);
+			return;
+		}
+	}
+
+	//No space left for a new run
+	if (display_overlayUsed == overlay_maxRuns) {
+		display_overlayFull = true;
+		return;
+	}
+
+	//Start a new run
+	display_overlayRuns[display_overlayUsed] = pos | (1 << 17);
+	display_overlayColors[display_overlayUsed] = color;
+	display_overlayUsed++;
+	display_overlayCount[display_overlayRecord]++;
+}
+
 /* Set a specific pixel in that color */
 void display_setPixel(word color)
 {
@@ -384,7 +614,7 @@ void display_setPixel(word color)
 
 	//Write to display
 	if (!display_writeToImage) {
-		SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+		display_beginTransaction();
 		display_writedata16_last(color);
 		SPI.endTransaction();
 	}
@@ -397,6 +627,8 @@ void display_setPixel(word color)
 			pos = ((imageY) * 320) + imageX;
 			if(pos < 76800)
 				bigBuffer[pos] = color;
+			else
+				return;
 		}
 			
 		//160x120 for Teensy 3.1 / 3.2
@@ -405,7 +637,13 @@ void display_setPixel(word color)
 			pos = ((imageY) * 160) + imageX;
 			if(pos < 19200)
 				smallBuffer[pos] = color;
+			else
+				return;
 		}
+
+		//Remember the pixel for the cached overlay
+		if (display_overlayRecord != overlay_none)
+			display_overlayAdd(pos, color);
 	}
 }
 
@@ -478,7 +716,7 @@ void display_fillScr(word color)
 {
 	int x = 0;
 	int y = 0;
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x, y, x + 319, y + 239);
 	display_writecommand_cont(ILI9341_RAMWR);
 	for (y = 240; y > 0; y--) {
@@ -535,7 +773,7 @@ void display_fillRect(int x1, int y1, int x2, int y2)
 		h = 240 - y1;
 
 	//Send to display
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x1, y1, x1 + w - 1, y1 + h - 1);
 	display_writecommand_cont(ILI9341_RAMWR);
 	word color = (fch << 8 | fcl);
@@ -1169,7 +1407,7 @@ void display_drawBitmap(int x, int y, int sx, int sy, unsigned short* data, int
 	unsigned int col;
 	int tx, ty, tsx, tsy, tc;
 	byte VH, VL;
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 
 	//Unscaled
 	if (scale == 1)
@@ -1289,7 +1527,7 @@ void display_drawBitmap(int x, int y, int sx, int sy, unsigned short* data, int
 /* Write a paletted bitmap with 2BPP */
 void display_writeRect2BPP(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t* pixels, const uint16_t* palette)
 {
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x, y, x + w - 1, y + h - 1);
 	display_writecommand_cont(ILI9341_RAMWR);
 	for (y = h; y > 0; y--) {
@@ -1310,7 +1548,7 @@ void display_writeRect2BPP(int16_t x, int16_t y, int16_t w, int16_t h, const uin
 /* Write a paletted bitmap with 4BPP */
 void display_writeRect4BPP(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t* pixels, const uint16_t* palette)
 {
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_setAddr(x, y, x + w - 1, y + h - 1);
 	display_writecommand_cont(ILI9341_RAMWR);
 	for (y = h; y > 0; y--) {
@@ -1354,7 +1592,7 @@ int display_getStringWidth(char* str)
 /* Enter sleep mode */
 void display_enterSleepMode()
 {
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_writecommand_last(ILI9341_SLPIN);
 	SPI.endTransaction();
 }
@@ -1362,7 +1600,7 @@ void display_enterSleepMode()
 /* Exit sleep mode */
 void display_exitSleepMode()
 {
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 	display_writecommand_last(ILI9341_SLPOUT);
 	SPI.endTransaction();
 }
@@ -1372,7 +1610,7 @@ uint16_t display_readPixel(int16_t x, int16_t y)
 {
 	uint8_t r, g, b;
 
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
 
 	display_setAddr(x, y, x, y);
 	display_writecommand_cont(ILI9341_RAMRD);
@@ -1397,45 +1635,29 @@ uint16_t display_readPixel(int16_t x, int16_t y)
 	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
 }
 
-/* Write RGB565 data to the screen */
+/* Start to write RGB565 data to the screen, returns while the DMA is sending */
 void display_writeScreen(unsigned short* pcolors, boolean small)
 {
-	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+	display_beginTransaction();
+	display_dmaMCR = SPI0_MCR;
 	display_setAddr(0, 0, 319, 239);
 	display_writecommand_cont(ILI9341_RAMWR);
 
-	//160x120 array, doubled
-	if (small) {
-		for (byte y = 120; y > 0; y--) {
-			for (byte x = 160; x > 1; x--) {
-				display_writedata16_cont(*pcolors);
-				display_writedata16_cont(*pcolors++);
-			}
-			display_writedata16_cont(*pcolors);
-			display_writedata16_last(*pcolors++);
-			pcolors = pcolors - 160;
-			for (byte x = 160; x > 1; x--) {
-				display_writedata16_cont(*pcolors);
-				display_writedata16_cont(*pcolors++);
-			}
-			display_writedata16_cont(*pcolors);
-			display_writedata16_last(*pcolors++);
-		}
-	}
-	//320x240 array
-	else
-	{
-		uint16_t *colors_end = &pcolors[76799];
-		uint16_t *colors_curr = pcolors;
+	//Convert the first line
+	display_dmaBuffer = pcolors;
+	display_dmaSmall = small;
+	display_dmaFill(0);
+	display_dmaLine = 0;
+	display_dmaBusy = true;
+	display_dmaActive = true;
 
-		// Quick write out the data;
-		while (colors_curr < colors_end) {
-			display_writedata16_cont(*colors_curr++);
-		}
-		display_writedata16_last(*colors_curr);
-	}
+	//The channel is shared with the Lepton, send 32-bit command words
+	spiTxDMA.destination((volatile uint32_t&)KINETISK_SPI0.PUSHR);
+	spiTxDMA.TCD->CSR = DMA_TCD_CSR_DREQ | DMA_TCD_CSR_INTMAJOR;
 
-	SPI.endTransaction();
+	//Let the transmit FIFO request the DMA
+	KINETISK_SPI0.RSER = SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS;
+	display_dmaStartLine();
 }
 
 /* Read multiple pixels from the screen */
@@ -1444,6 +1666,7 @@ void display_readScreen(byte step, unsigned short* pcolors)
 	uint8_t r, g, b;
 	uint16_t c = 19201;
 
+	display_waitScreen();
 	SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
 
 	display_setAddr(0, (step * 60), 319, (step * 60) + 59);
@@ -23,6 +23,7 @@
 #include "Lepton.h"
 #include "SD.h"
 #include "MassStorage.h"
+#include "Profiler.h"
 #include "Connection.h"
 
 /* Methods */
@@ -55,6 +56,8 @@ float bytesToFloat(uint8_t* farray)
 
 /* Switch the SPI clockline to pin 14 */
 void startAltClockline(boolean sdStart) {
+	//Do not switch the clockline during the screen DMA
+	display_waitScreen();
 	CORE_PIN13_CONFIG = PORT_PCR_MUX(1);
 	CORE_PIN14_CONFIG = PORT_PCR_DSE | PORT_PCR_MUX(2);
 	if (sdStart)
@@ -252,10 +255,16 @@ void readEEPROM() {
 		spotEnabled = false;
 	//Filter Type
 	read = EEPROM.read(eeprom_filterType);
-	if ((read == filterType_none) || (read == filterType_box) || (read == filterType_gaussian))
+	if ((read >= filterType_none) && (read <= filterType_bilateral))
 		filterType = read;
 	else
 		filterType = filterType_gaussian;
+	//AGC Mode
+	read = EEPROM.read(eeprom_agcMode);
+	if ((read >= agcMode_linear) && (read <= agcMode_local))
+		agcMode = read;
+	else
+		agcMode = agcMode_linear;
 	//Colorbar Enabled
 	read = EEPROM.read(eeprom_colorbarEnabled);
 	if ((read == false) || (read == true))
@@ -446,7 +455,7 @@ void initBuffer()
 	smallBuffer = (uint16_t*)malloc(38400);
 }
 
-/* Display the content of the small/big buffer on the screen */
+/* Start to display the small/big buffer, display_waitScreen() waits for the DMA */
 void displayBuffer()
 {
 	//Display 320x240 for Teensy 3.6
@@ -646,6 +655,8 @@ void initHardware()
 {
 	//Init UART
 	Serial.begin(115200);
+	//Enable the cycle counter for the profiler
+	profiler_init();
 	//Detect teensy version
 	detectTeensyVersion();
 	//Init GPIO
@@ -16,16 +16,48 @@
 /* Variables */
 //Array to store one Lepton frame
 byte leptonFrame[164];
+//Ring of package slots, filled by DMA
+byte leptonSlots[4][164];
 
 //Lepton frame error return
 enum LeptonReadError {
 	NONE, DISCARD, SEGMENT_ERROR, ROW_ERROR, SEGMENT_INVALID
 };
 
+//DMA channel for the SPI receive FIFO
+DMAChannel lepton_dmaRX(false);
+//Dummy byte clocked out to the Lepton
+uint8_t lepton_dmaFill = 0;
+//Timer to restart the capture after an error
+IntervalTimer lepton_retryTimer;
+
+//State of the frame capture
+volatile byte lepton_captureState = leptonCapture_idle;
+//Buffer the current capture is stored to
+uint16_t* volatile lepton_target;
+//Current slot, line, segment and error count of the capture
+volatile byte lepton_slot;
+volatile byte lepton_line;
+volatile byte lepton_segment;
+volatile byte lepton_segments;
+volatile byte lepton_error;
+//The package in flight belongs to a restarted segment
+volatile bool lepton_skipPackage;
+//Time the resync has been started
+volatile uint32_t lepton_resyncTime;
+//Total number of invalid packages and resyncs for the profiler
+volatile uint32_t lepton_packageErrors = 0;
+volatile uint32_t lepton_resyncs = 0;
+//A background capture has already been moved to the small buffer
+bool lepton_frameReady = false;
+
 /* Methods */
 
 /* Start Lepton SPI Transmission */
 void lepton_begin() {
+	//Let the screen DMA release the bus
+	display_waitScreen();
+
 	//Start alternative clock line, except for old HW
 	if (mlx90614Version == mlx90614Version_new)
 		startAltClockline();
@@ -55,43 +87,29 @@ void lepton_end() {
 		endAltClockline();
 }
 
-/* Reset the SPI bus to re-initiate Lepton communication */
-void lepton_reset()
-{
-	lepton_end();
-	delay(186);
-	lepton_begin();
-}
-
-/* Store one package of 80 columns into RAM */
-bool savePackage(byte line, byte segment = 0) {
+/* Store one package of 80 columns into the buffer */
+bool savePackage(byte* package, byte line, byte segment, uint16_t* buffer) {
 	//Go through the video pixels for one video line
 	for (int column = 0; column < 80; column++) {
 		//Make a 16-bit rawvalue from the lepton frame
-		uint16_t result = (uint16_t)(leptonFrame[2 * column + 4] << 8
-			| leptonFrame[2 * column + 5]);
+		uint16_t result = (uint16_t)(package[2 * column + 4] << 8
+			| package[2 * column + 5]);
 
 		//Invalid value, return
 		if (result == 0) {
 			return 0;
 		}
 
-		//Lepton2
+		//Lepton2, stored at the native 80x60
 		if (leptonVersion != leptonVersion_3_shutter) {
 			//Rotated or old hardware version
 			if (((mlx90614Version == mlx90614Version_old) && (!rotationEnabled)) ||
 				((mlx90614Version == mlx90614Version_new) && (rotationEnabled))) {
-				smallBuffer[(line * 2 * 160) + (column * 2)] = result;
-				smallBuffer[(line * 2 * 160) + (column * 2) + 1] = result;
-				smallBuffer[(line * 2 * 160) + 160 + (column * 2)] = result;
-				smallBuffer[(line * 2 * 160) + 160 + (column * 2) + 1] = result;
+				buffer[(line * 80) + column] = result;
 			}
 			//Non-rotated
 			else {
-				smallBuffer[19199 - ((line * 2 * 160) + (column * 2))] = result;
-				smallBuffer[19199 - ((line * 2 * 160) + (column * 2) + 1)] = result;
-				smallBuffer[19199 - ((line * 2 * 160) + 160 + (column * 2))] = result;
-				smallBuffer[19199 - ((line * 2 * 160) + 160 + (column * 2) + 1)] = result;
+				buffer[4799 - ((line * 80) + column)] = result;
 			}
 		}
 
@@ -101,16 +119,16 @@ bool savePackage(byte line, byte segment = 0) {
 			if (!rotationEnabled) {
 				switch (segment) {
 				case 1:
-					smallBuffer[19199 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[19199 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				case 2:
-					smallBuffer[14399 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[14399 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				case 3:
-					smallBuffer[9599 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[9599 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				case 4:
-					smallBuffer[4799 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[4799 - (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				}
 			}
@@ -118,16 +136,16 @@ bool savePackage(byte line, byte segment = 0) {
 			else {
 				switch (segment) {
 				case 1:
-					smallBuffer[((line / 2) * 160) + ((line % 2) * 80) + (column)] = result;
+					buffer[((line / 2) * 160) + ((line % 2) * 80) + (column)] = result;
 					break;
 				case 2:
-					smallBuffer[4800 + (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[4800 + (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				case 3:
-					smallBuffer[9600 + (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[9600 + (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				case 4:
-					smallBuffer[14400 + (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
+					buffer[14400 + (((line / 2) * 160) + ((line % 2) * 80) + (column))] = result;
 					break;
 				}
 			}
@@ -138,22 +156,24 @@ bool savePackage(byte line, byte segment = 0) {
 	return 1;
 }
 
-/* Get one line package from the Lepton */
-LeptonReadError lepton_getPackage(byte line, byte seg) {
-	//Receive one frame over SPI
+/* Receive one VoSPI package from the Lepton into the frame array */
+void lepton_readPackage() {
 	SPI.transfer(leptonFrame, 164);
+}
 
+/* Check the received package against the expected line and segment */
+LeptonReadError lepton_checkPackage(byte* package, byte line, byte seg) {
 	//Repeat as long as the frame is not valid, equals sync
-	if ((leptonFrame[0] & 0x0F) == 0x0F)
+	if ((package[0] & 0x0F) == 0x0F)
 		return DISCARD;
 
 	//Check if the line number matches the expected line
-	if (leptonFrame[1] != line)
+	if (package[1] != line)
 		return ROW_ERROR;
 
 	//For the Lepton3, check if the segment number matches
 	if ((line == 20) && (leptonVersion == leptonVersion_3_shutter)) {
-		byte segment = (leptonFrame[0] >> 4);
+		byte segment = (package[0] >> 4);
 		if (segment == 0)
 			return SEGMENT_INVALID;
 		if (segment != seg)
@@ -164,70 +184,215 @@ LeptonReadError lepton_getPackage(byte line, byte seg) {
 	return NONE;
 }
 
-/* Get one frame of raw values from the lepton */
-void lepton_getRawValues()
-{
-	byte line, error, segmentNumbers;
+/* Let the DMA receive the next package into the next slot of the ring */
+void lepton_startPackage() {
+	//Next slot
+	lepton_slot = (lepton_slot + 1) & 3;
+
+	//Receive 164 bytes into the slot, clock out the same amount
+	lepton_dmaRX.destinationBuffer(leptonSlots[lepton_slot], 164);
+	spiTxDMA.transferCount(164);
+
+	//Start the transfer
+	lepton_dmaRX.enable();
+	spiTxDMA.enable();
+}
+
+/* Timer interrupt, restarts the capture after an error */
+void lepton_retryISR() {
+	lepton_retryTimer.end();
+	lepton_startPackage();
+}
+
+/* Raise a Lepton error and restart at line 0 */
+void lepton_packageError(bool restart) {
+	//Restart at line 0
+	lepton_line = 0;
+	lepton_packageErrors++;
+
+	//Maximum error count, reset the Lepton SPI from the main loop
+	if (++lepton_error == 255) {
+		lepton_resyncs++;
+		//Stop the running transfer
+		lepton_dmaRX.disable();
+		spiTxDMA.disable();
+		//End transfer - CS HIGH
+		digitalWriteFast(pin_lepton_cs, HIGH);
+		lepton_resyncTime = millis();
+		lepton_captureState = leptonCapture_resync;
+		return;
+	}
+
+	//Stabilize framerate without blocking the CPU
+	if (restart)
+		lepton_retryTimer.begin(lepton_retryISR, 800);
+}
+
+/* DMA interrupt, called after every received package */
+void lepton_packageISR() {
+	lepton_dmaRX.clearInterrupt();
+
+	//Capture has been stopped meanwhile
+	if (lepton_captureState != leptonCapture_busy)
+		return;
+
+	//Package received while the last one was stored, try again after a short delay
+	if (lepton_skipPackage) {
+		lepton_skipPackage = false;
+		lepton_retryTimer.begin(lepton_retryISR, 800);
+		return;
+	}
+
+	//Package that has just been received
+	byte* package = leptonSlots[lepton_slot];
+	byte line = lepton_line;
+	byte segment = lepton_segment;
+
+	//Package invalid, try again after a short delay
+	if (lepton_checkPackage(package, line, segment) != NONE) {
+		lepton_packageError(true);
+		return;
+	}
+
+	//Go to the next line and segment
+	bool last = (line == 59) && (segment == lepton_segments);
+	if (++lepton_line == 60) {
+		lepton_line = 0;
+		lepton_segment++;
+		//Reset error counter for each segment
+		lepton_error = 0;
+	}
+
+	//Receive the next package while this one is stored
+	if (!last)
+		lepton_startPackage();
+
+	//Store the package, restart the segment for invalid values
+	if (!savePackage(package, line, segment, lepton_target)) {
+		lepton_segment = segment;
+		//The next package is in flight, it is dropped and the retry starts after it
+		lepton_skipPackage = !last;
+		lepton_packageError(last);
+		return;
+	}
+
+	//Frame complete
+	if (last)
+		lepton_captureState = leptonCapture_done;
+}
+
+/* Restart the capture at the first line of the first segment */
+void lepton_restartCapture() {
+	lepton_line = 0;
+	lepton_segment = 1;
+	lepton_error = 0;
+	lepton_skipPackage = false;
+	lepton_captureState = leptonCapture_busy;
+
+	//Clear the FIFOs and let them request the DMA
+	KINETISK_SPI0.MCR |= SPI_MCR_CLR_RXF | SPI_MCR_CLR_TXF;
+	KINETISK_SPI0.SR = 0xFF0F0000;
+	KINETISK_SPI0.RSER = SPI_RSER_RFDF_RE | SPI_RSER_RFDF_DIRS | SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS;
+
+	//Receive the first package
+	lepton_startPackage();
+}
 
+/* Start to capture one frame into the buffer over DMA */
+void lepton_startCapture(uint16_t* buffer) {
 	//Determine number of segments
 	if (leptonVersion == leptonVersion_3_shutter)
-		segmentNumbers = 4;
+		lepton_segments = 4;
 	else
-		segmentNumbers = 1;
+		lepton_segments = 1;
+
+	//Set the target buffer
+	lepton_target = buffer;
 
 	//Begin SPI Transmission
 	lepton_begin();
 
-	//Go through the segments
-	for (byte segment = 1; segment <= segmentNumbers; segment++) {
-		//Reset error counter for each segment
-		error = 0;
-
-		//Go through one segment, equals 60 lines of 80 values
-		do {
-			for (line = 0; line < 60; line++) {
-				//Maximum error count
-				if (error == 255) {
-					//If main menu should be entreed
-					if (showMenu == showMenu_desired) {
-						lepton_end();
-						return;
-					}
-
-					//Reset segment
-					segment = 1;
-					//Reset error
-					error = 0;
-					//Reset Lepton SPI
-					lepton_reset();
-					//Restart at line 0
-					break;
-				}
+	//The channel is shared with the display, transmit the dummy byte without interrupt
+	spiTxDMA.source(lepton_dmaFill);
+	spiTxDMA.destination((volatile uint8_t&)KINETISK_SPI0.PUSHR);
+	spiTxDMA.TCD->CSR = DMA_TCD_CSR_DREQ;
 
-				//Get a package from the lepton
-				LeptonReadError retVal = lepton_getPackage(line, segment);
-
-				//If everythin worked, continue
-				if (retVal == NONE)
-					if (savePackage(line, segment))
-						continue;
-
-				//Raise lepton error
-				error++;
-
-				//Stabilize framerate
-				uint32_t time = micros();
-				while ((micros() - time) < 800)
-					__asm__ volatile ("nop");
+	//Start the capture
+	lepton_restartCapture();
+}
 
-				//Restart at line 0
+/* Wait for the capture to finish and release the SPI bus */
+bool lepton_waitCapture() {
+	//No capture running
+	if (lepton_captureState == leptonCapture_idle)
+		return false;
+
+	//Wait for the frame to be complete
+	while (lepton_captureState != leptonCapture_done) {
+		//Resync after too many errors
+		if (lepton_captureState == leptonCapture_resync) {
+			//If main menu should be entered
+			if (showMenu == showMenu_desired)
 				break;
+
+			//Restart with the first segment after the Lepton has been deselected long enough
+			if ((millis() - lepton_resyncTime) >= 186) {
+				digitalWriteFast(pin_lepton_cs, LOW);
+				lepton_restartCapture();
 			}
-		} while (line != 60);
+		}
 	}
+	bool complete = (lepton_captureState == leptonCapture_done);
+
+	//Stop the DMA and the SPI FIFO requests
+	lepton_retryTimer.end();
+	lepton_dmaRX.disable();
+	spiTxDMA.disable();
+	KINETISK_SPI0.RSER = 0;
 
 	//End SPI Transmission
 	lepton_end();
+	lepton_captureState = leptonCapture_idle;
+
+	return complete;
+}
+
+/* Stream the next frame in the background while the current one is processed */
+void lepton_prefetch(uint16_t* buffer) {
+	//Only in the thermal live mode of the Teensy 3.6, the SPI bus is needed otherwise
+	if ((teensyVersion != teensyVersion_new) || (displayMode != displayMode_thermal) ||
+		(imgSave != imgSave_disabled) || (videoSave != videoSave_disabled) || (showMenu) || (serialMode))
+		return;
+
+	//Start the capture
+	lepton_startCapture(buffer);
+}
+
+/* Take a completed background capture for the next image */
+void lepton_usePrefetch() {
+	lepton_frameReady = true;
+}
+
+/* Get one frame of raw values from the lepton */
+void lepton_getRawValues()
+{
+	//Frame has already been captured in the background
+	if (lepton_frameReady) {
+		lepton_frameReady = false;
+		//Copy it from the back buffer once the screen has been sent
+		if (lepton_target != smallBuffer) {
+			display_waitScreen();
+			memcpy(smallBuffer, lepton_target, rawWidth * rawHeight * 2);
+		}
+		return;
+	}
+
+	//Let a background capture release the SPI bus
+	lepton_waitCapture();
+
+	//Capture a frame to the small buffer
+	lepton_startCapture(smallBuffer);
+	lepton_waitCapture();
 }
 
 /* Trigger a flat-field-correction on the Lepton */
@@ -237,6 +402,7 @@ bool lepton_ffc(bool message = false) {
 		showFullMessage((char*) "Performing FFC..", true);
 
 	//Send FFC run command
+	mlx90614_release();
 	Wire.beginTransmission(0x2A);
 	Wire.write(0x00);
 	Wire.write(0x04);
@@ -253,6 +419,7 @@ bool lepton_ffc(bool message = false) {
 
 /* Select I2C Register on the Lepton */
 void lepton_setReg(byte reg) {
+	mlx90614_release();
 	Wire.beginTransmission(0x2A);
 	Wire.write(reg >> 8 & 0xff);
 	Wire.write(reg & 0xff);
@@ -282,6 +449,7 @@ void lepton_ffcMode(bool automatic)
 		0, 0, 0, 0, 0, 0, 224, 147, 4, 0, 0, 0, 0, 0, 44, 1, 52, 0 };
 
 	//Data length
+	mlx90614_release();
 	Wire.beginTransmission(0x2A);
 	Wire.write(0x00);
 	Wire.write(0x06);
@@ -350,8 +518,26 @@ void lepton_version() {
 	EEPROM.write(eeprom_leptonVersion, leptonVersion);
 }
 
+/* Init the DMA channels for the frame capture */
+void lepton_initDMA() {
+	//Transmit channel, configured for each capture
+	spiTxDMA.begin();
+	spiTxDMA.triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_TX);
+
+	//Receive from the SPI FIFO and interrupt after each package
+	lepton_dmaRX.begin();
+	lepton_dmaRX.source((volatile uint8_t&)KINETISK_SPI0.POPR);
+	lepton_dmaRX.disableOnCompletion();
+	lepton_dmaRX.triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_RX);
+	lepton_dmaRX.attachInterrupt(lepton_packageISR);
+	lepton_dmaRX.interruptAtCompletion();
+}
+
 /* Init the FLIR Lepton LWIR sensor */
 void lepton_init() {
+	//Prepare the DMA capture
+	lepton_initDMA();
+
 	//Check the Lepton HW Revision
 	lepton_version();
 
@@ -370,7 +556,7 @@ void lepton_init() {
 	//Check if SPI works
 	lepton_begin();
 	do {
-		SPI.transfer(leptonFrame, 164);
+		lepton_readPackage();
 	}
 	//Repeat as long as the frame is not valid, equals sync
 	while (((leptonFrame[0] & 0x0F) == 0x0F) && ((millis() - calTimer) < 1000));
@@ -27,6 +27,17 @@
 #define mlx90614_Emissivity 0x24
 #define mlx90614_Filter 0x25
 
+//States of the non-blocking sampling, advanced by a timer interrupt
+#define mlx90614_stateIdle 0
+#define mlx90614_stateSend 1
+#define mlx90614_stateReceive 2
+//Time between two steps of the sampling in us, one transfer takes about 400us
+#define mlx90614_step 500
+//Abort a read of both temperatures that takes longer than this in ms
+#define mlx90614_timeout 20
+//A sample older than this in ms is not used anymore
+#define mlx90614_staleTime 3000
+
 //CRC Table to calculate I2C PEC
 const unsigned char mlx90614_crcTable[] = { 0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D, 0x70, 0x77, 0x7E,
 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D, 0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF,
@@ -43,7 +54,20 @@ const unsigned char mlx90614_crcTable[] = { 0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B,
 //Stores the object temp
 float mlx90614_temp = 0;
 //Stores the ambient temp
-float mlx90614_amb = 0;
+volatile float mlx90614_amb = 0;
+//Filtered object temp in Celcius from the non-blocking sampling
+volatile float mlx90614_object = 0;
+//Time of the last valid ambient and object sample
+volatile long mlx90614_ambTime = 0;
+volatile long mlx90614_objTime = 0;
+//State of the non-blocking sampling
+volatile byte mlx90614_state = mlx90614_stateIdle;
+//Current read is the ambient temp, otherwise the object temp
+volatile boolean mlx90614_readAmb = false;
+//Start time of the current read
+volatile long mlx90614_readTime = 0;
+//Timer for the steps of the sampling
+IntervalTimer mlx90614_timer;
 
 /* Methods */
 
@@ -58,10 +82,21 @@ char mlx90614_crc8(byte buffer[], int len) {
 	return m_crc;
 }
 
+/* Finish a pending non-blocking read before the bus is used otherwise */
+void mlx90614_release() {
+	if (mlx90614_state == mlx90614_stateIdle)
+		return;
+	//No further steps, then wait for the current transfer
+	mlx90614_timer.end();
+	Wire.finish(mlx90614_timeout * 1000);
+	mlx90614_state = mlx90614_stateIdle;
+}
+
 /* Receive data from the RAM over I2C */
 uint16_t mlx90614_getRawData(boolean TaTo, boolean* check) {
 	// Store the two relevant bytes of data for temperature
 	byte dataLow, dataHigh;
+	mlx90614_release();
 	Wire.beginTransmission(mlx90614_RAM);
 	//Measure Ambient Temp
 	if (TaTo)
@@ -92,6 +127,7 @@ uint16_t mlx90614_getRawData(boolean TaTo, boolean* check) {
 
 /* Send data to the EEPROM over I2C*/
 void mlx90614_send(byte address, byte LSB, byte MSB) {
+	mlx90614_release();
 	Wire.beginTransmission(mlx90614_EEPROM);
 	Wire.write(address);
 	Wire.write(LSB);
@@ -104,6 +140,7 @@ void mlx90614_send(byte address, byte LSB, byte MSB) {
 
 /* Receive data from the EEPROM over I2C */
 uint16_t mlx90614_receive(byte address, byte* error = NULL) {
+	mlx90614_release();
 	Wire.beginTransmission(mlx90614_EEPROM);
 	Wire.write(address);
 	Wire.endTransmission(I2C_NOSTOP);
@@ -304,6 +341,100 @@ float mlx90614_getTemp() {
 	return mlx90614_temp;
 }
 
+/* Check and filter a temperature from the non-blocking sampling */
+void mlx90614_evaluate(byte reg, byte* data) {
+	//Validate the PEC over addresses, command and data
+	byte msg[5] = { mlx90614_RAM << 1, reg, (mlx90614_RAM << 1) | 1, data[0], data[1] };
+	if (((byte)mlx90614_crc8(msg, 5) != data[2]) || (data[1] & 0x80))
+		return;
+
+	//Convert to Celcius
+	float tempData = (((((data[1] & 0x007F) << 8) + data[0]) * 0.02) - 0.01) - 273.15;
+
+	//Ambient temp changes slowly, filter it stronger
+	if (reg == mlx90614_AmbientTemp) {
+		if ((tempData < -40) || (tempData > 125))
+			return;
+		mlx90614_amb += (tempData - mlx90614_amb) / 8;
+		mlx90614_ambTime = millis();
+	}
+	//Object temp
+	else {
+		if ((tempData < -70) || (tempData > 380))
+			return;
+		mlx90614_object += (tempData - mlx90614_object) / 2;
+		mlx90614_objTime = millis();
+	}
+}
+
+/* Check if the last valid sample is too old to be used */
+bool mlx90614_stale(long sampleTime) {
+	return (millis() - sampleTime) > mlx90614_staleTime;
+}
+
+/* Select the register of the next temperature */
+void mlx90614_select() {
+	Wire.beginTransmission(mlx90614_RAM);
+	Wire.write(mlx90614_readAmb ? mlx90614_AmbientTemp : mlx90614_ObjectTemp);
+	Wire.sendTransmission(I2C_NOSTOP);
+	mlx90614_state = mlx90614_stateSend;
+}
+
+/* Timer interrupt, advances the sampling once the last transfer is done */
+void mlx90614_stepISR() {
+	//Transfer still running, the main loop frees the bus after the timeout
+	if (!Wire.done()) {
+		if ((millis() - mlx90614_readTime) > mlx90614_timeout)
+			mlx90614_timer.end();
+		return;
+	}
+
+	switch (mlx90614_state) {
+		//Register selected, request data and PEC with a repeated start
+	case mlx90614_stateSend:
+		if (Wire.status() != I2C_WAITING)
+			break;
+		Wire.sendRequest(mlx90614_RAM, 3, I2C_STOP);
+		mlx90614_state = mlx90614_stateReceive;
+		return;
+
+		//Data received, the ambient temp follows the object temp
+	case mlx90614_stateReceive:
+		if ((Wire.status() == I2C_WAITING) && (Wire.available() == 3)) {
+			byte data[3];
+			for (byte i = 0; i < 3; i++)
+				data[i] = Wire.read();
+			mlx90614_evaluate(mlx90614_readAmb ? mlx90614_AmbientTemp : mlx90614_ObjectTemp, data);
+		}
+		if (mlx90614_readAmb)
+			break;
+		mlx90614_readAmb = true;
+		mlx90614_select();
+		return;
+	}
+
+	//Both temperatures read or the sensor did not answer
+	mlx90614_timer.end();
+	mlx90614_state = mlx90614_stateIdle;
+}
+
+/* Start reading the object and ambient temp in the background, does not wait for the bus */
+void mlx90614_update() {
+	//Free the bus if the sensor hangs
+	if (mlx90614_state != mlx90614_stateIdle) {
+		if ((millis() - mlx90614_readTime) <= mlx90614_timeout)
+			return;
+		mlx90614_timer.end();
+		Wire.resetBus();
+	}
+
+	//The timer continues until both are read
+	mlx90614_readTime = millis();
+	mlx90614_readAmb = false;
+	mlx90614_select();
+	mlx90614_timer.begin(mlx90614_stepISR, mlx90614_step);
+}
+
 /* Initializes the sensor */
 void mlx90614_init() {
 	byte error;
@@ -377,4 +508,9 @@ void mlx90614_init() {
 		count++;
 		delay(10);
 	} while (check == 0);
+
+	//Start the non-blocking sampling from the measured values
+	mlx90614_object = mlx90614_temp;
+	mlx90614_ambTime = millis();
+	mlx90614_objTime = millis();
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+/*
+*
+* PROFILER - Measure the time of the live mode stages with the cycle counter
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+/* Defines */
+
+//Stages of the live mode loop
+#define profiler_checkSerial     0
+#define profiler_screenOffCheck  1
+#define profiler_getRawValues    2
+#define profiler_compensateCalib 3
+#define profiler_filter          4
+#define profiler_convertColors   5
+#define profiler_displayInfos    6
+#define profiler_showImage       7
+#define profiler_frame           8
+#define profiler_stages          9
+
+//Number of samples for the rolling statistics
+#if defined(__MK66FX1M0__)
+#define profiler_window 128
+#else
+#define profiler_window 32
+#endif
+
+/* Variables */
+
+//Rolling window of the stage times in microseconds
+uint32_t profiler_samples[profiler_stages][profiler_window];
+//Next position and number of samples in the window
+byte profiler_pos[profiler_stages];
+byte profiler_count[profiler_stages];
+//Cycle counter at the start of the current stage and frame
+uint32_t profiler_stageStart;
+uint32_t profiler_frameStart;
+//Show the frame rate and latency on the live image
+bool profiler_overlay = false;
+
+/* Methods */
+
+/* Enable the cycle counter of the core */
+void profiler_init() {
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+/* Add a sample to the window of a stage */
+void profiler_add(byte stage, uint32_t cycles) {
+	profiler_samples[stage][profiler_pos[stage]] = cycles / (F_CPU / 1000000);
+	profiler_pos[stage] = (profiler_pos[stage] + 1) % profiler_window;
+	if (profiler_count[stage] < profiler_window)
+		profiler_count[stage]++;
+}
+
+/* Start the time measurement of a stage */
+inline void profiler_start() {
+	profiler_stageStart = ARM_DWT_CYCCNT;
+}
+
+/* Stop the time measurement of a stage */
+inline void profiler_stop(byte stage) {
+	profiler_add(stage, ARM_DWT_CYCCNT - profiler_stageStart);
+}
+
+/* Start the time measurement of a frame */
+inline void profiler_frameBegin() {
+	profiler_frameStart = ARM_DWT_CYCCNT;
+}
+
+/* Stop the time measurement of a frame */
+inline void profiler_frameEnd() {
+	profiler_add(profiler_frame, ARM_DWT_CYCCNT - profiler_frameStart);
+}
+
+/* Get min, average, max and 99th percentile of a stage in microseconds */
+void profiler_getStats(byte stage, uint32_t* stats) {
+	uint32_t sorted[profiler_window];
+	uint32_t sum = 0;
+	byte count = profiler_count[stage];
+
+	//No samples yet
+	if (count == 0) {
+		memset(stats, 0, 4 * sizeof(uint32_t));
+		return;
+	}
+
+	//Insertion sort of the window, only done on request
+	for (byte i = 0; i < count; i++) {
+		uint32_t value = profiler_samples[stage][i];
+		sum += value;
+		byte j = i;
+		while ((j > 0) && (sorted[j - 1] > value)) {
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = value;
+	}
+
+	stats[0] = sorted[0];
+	stats[1] = sum / count;
+	stats[2] = sorted[count - 1];
+	//Nearest rank percentile
+	stats[3] = sorted[((count * 99) + 99) / 100 - 1];
+}
+
+/* Show the frame rate and the average frame time on the image */
+void profiler_showOverlay() {
+	char buffer[24];
+	uint32_t stats[4];
+
+	//No frame measured yet
+	profiler_getStats(profiler_frame, stats);
+	if (stats[1] == 0)
+		return;
+
+	//Frames per second with one decimal and the latency in ms
+	uint32_t fps = 10000000 / stats[1];
+	sprintf(buffer, "%lu.%lu FPS %lums", fps / 10, fps % 10, (stats[1] + 500) / 1000);
+	display_print(buffer, 5, 14);
+}
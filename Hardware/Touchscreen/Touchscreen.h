@@ -28,7 +28,8 @@ TS_Point touch_getPoint() {
 	//Get touch from capacitive
 	if (touch_capacitive)
 		return capTouch.getPoint();
-	//Get point from resistive
+	//Get point from resistive, it shares the SPI bus with the screen DMA
+	display_waitScreen();
 	return resTouch.getPoint();
 }
 
@@ -88,8 +89,11 @@ bool touch_touched() {
 	//Check for touch, capacitive or resistive
 	if (touch_capacitive)
 		touch = capTouch.touched();
-	else
+	else {
+		//Resistive shares the SPI bus with the screen DMA
+		display_waitScreen();
 		touch = resTouch.touched();
+	}
 	//If touch registered, set screen pressed marker
 	if (touch)
 		screenPressed = true;
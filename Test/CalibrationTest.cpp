@@ -0,0 +1,283 @@
+/*
+*
+* CALIBRATIONTEST - Spot sensor compensation against a model of the MLX90614
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Variables */
+
+//Temperatures the spot sensor model measures in Celcius
+float calTest_object;
+float calTest_ambient;
+//The spot sensor answers on the bus, and for the ambient temp
+bool calTest_responding;
+bool calTest_ambResponding;
+//Register selected by the last write
+byte calTest_register;
+
+/* Methods */
+
+/* MLX90614 model, a write selects the register */
+bool calTest_i2cWrite(uint8_t address, const uint8_t* data, size_t len) {
+	if ((address != mlx90614_RAM) || (!calTest_responding))
+		return false;
+	if (len > 0)
+		calTest_register = data[0];
+	return true;
+}
+
+/* MLX90614 model, a read returns the temperature of the selected register with PEC */
+size_t calTest_i2cRead(uint8_t address, uint8_t* data, size_t len) {
+	if ((address != mlx90614_RAM) || (!calTest_responding) || (len != 3))
+		return 0;
+	if ((calTest_register == mlx90614_AmbientTemp) && (!calTest_ambResponding))
+		return 0;
+	float temp = (calTest_register == mlx90614_AmbientTemp) ? calTest_ambient : calTest_object;
+	uint16_t raw = (uint16_t)roundf((temp + 273.15f + 0.01f) / 0.02f);
+	byte msg[5] = { mlx90614_RAM << 1, calTest_register, (mlx90614_RAM << 1) | 1, (byte)(raw & 0xFF), (byte)(raw >> 8) };
+	data[0] = msg[3];
+	data[1] = msg[4];
+	data[2] = mlx90614_crc8(msg, 5);
+	return 3;
+}
+
+/* Firmware with the spot sensor model and a flat scene at the ambient temp */
+void calTest_init() {
+	test_initFirmware(leptonVersion_3_shutter);
+	host_i2cWrite = calTest_i2cWrite;
+	host_i2cRead = calTest_i2cRead;
+	calTest_object = 25;
+	calTest_ambient = 25;
+	calTest_responding = true;
+	calTest_ambResponding = true;
+	mlx90614_state = mlx90614_stateIdle;
+	mlx90614_readTime = millis();
+	mlx90614_ambTime = millis();
+	mlx90614_objTime = millis();
+	calSlope = cal_stdSlope;
+	minValue = 8192;
+	maxValue = 8192;
+}
+
+/* Run the compensation of the live mode for some time */
+void calTest_run(uint32_t time) {
+	uint32_t start = millis();
+	while ((millis() - start) < time) {
+		compensateCalib();
+		delay(10);
+	}
+}
+
+/* The compensation falls back when the spot sensor stops answering */
+void testSpotStale() {
+	calTest_init();
+
+	//Spot temp above the scene raises the maximum
+	calTest_object = 40;
+	calTest_run(2000);
+	check(fabsf(mlx90614_temp - 40) < 0.1f);
+	check(calComp > 1);
+	float comp = calComp;
+
+	//The last sample is used for a short outage
+	calTest_responding = false;
+	calTest_run(mlx90614_staleTime - 500);
+	check(calComp == comp);
+
+	//Uncompensated calibration once the sample is stale
+	calTest_run(1000);
+	checkEqual(calComp, 0);
+	check(fabsf(calOffset - (mlx90614_amb - (calSlope * 8192))) < 0.01f);
+
+	//Compensated again with new samples
+	calTest_responding = true;
+	calTest_run(500);
+	check(calComp > 1);
+	host_i2cWrite = NULL;
+	host_i2cRead = NULL;
+}
+
+/* Both temperatures are read for every frame, also after the sensor did not answer */
+void testSpotRate() {
+	calTest_init();
+	calTest_object = 40;
+	calTest_ambient = 30;
+	delay(100);
+
+	//One frame reads both registers
+	long start = millis();
+	compensateCalib();
+	checkEqual(mlx90614_state, mlx90614_stateIdle);
+	check(mlx90614_objTime >= start);
+	check(mlx90614_ambTime >= start);
+	check(fabsf(mlx90614_object - 32.5f) < 0.1f);
+	check(fabsf(mlx90614_amb - 25.625f) < 0.1f);
+
+	//The filtered object temp settles within a few frames
+	for (byte i = 0; i < 8; i++)
+		compensateCalib();
+	check(fabsf(mlx90614_temp - 40) < 0.1f);
+
+	//No answer, the next frame reads again
+	calTest_responding = false;
+	long objTime = mlx90614_objTime;
+	delay(10);
+	compensateCalib();
+	checkEqual(mlx90614_state, mlx90614_stateIdle);
+	checkEqual(mlx90614_objTime, objTime);
+	calTest_responding = true;
+	start = millis();
+	compensateCalib();
+	checkEqual(mlx90614_state, mlx90614_stateIdle);
+	check(mlx90614_objTime >= start);
+
+	//Blocking reads wait for the background read
+	mlx90614_release();
+	check(fabsf(mlx90614_getAmb() - 30) < 0.1f);
+	host_i2cWrite = NULL;
+	host_i2cRead = NULL;
+}
+
+/* A stale ambient temp also ends the compensation */
+void testSpotAmbientStale() {
+	calTest_init();
+	calTest_object = 40;
+	calTest_run(1000);
+	check(calComp > 1);
+
+	//Only the object temp is still read
+	calTest_ambResponding = false;
+	calTest_run(mlx90614_staleTime + 500);
+	check(!mlx90614_stale(mlx90614_objTime));
+	checkEqual(calComp, 0);
+
+	//Compensated again with new samples
+	calTest_ambResponding = true;
+	calTest_run(500);
+	check(calComp > 1);
+	host_i2cWrite = NULL;
+	host_i2cRead = NULL;
+}
+
+/* Feed samples of a linear scene to the live tracking, returns the mean raw value */
+float calTest_track(float slope, float spread, uint16_t count) {
+	calStatus = cal_manual;
+	calTracking = true;
+	calSlope = cal_stdSlope;
+	calOffset = 0;
+	memset(&calTrackFit, 0, sizeof(calTrackFit));
+	float sum = 0;
+	for (uint16_t i = 0; i < count; i++) {
+		float x = 8000 + (spread * ((i % 11) - 5));
+		frameStats.centerAverage = x;
+		mlx90614_object = 20 + (slope * (x - 8000));
+		mlx90614_objTime = millis();
+		calTrack();
+		sum += x;
+		delay(100);
+	}
+	return sum / count;
+}
+
+/* Slope refined inside the plausible range */
+void testTrackSlope() {
+	calTest_init();
+	calTest_track(0.035f, 20, 100);
+	check(fabsf(calSlope - 0.035f) < 0.001f);
+	check(fabsf(((calSlope * 8000) + calOffset) - 20) < 0.05f);
+}
+
+/* Implausible slopes are limited, the offset still matches the samples */
+void testTrackClamp() {
+	calTest_init();
+	calTest_track(0.09f, 20, 100);
+	check(fabsf(calSlope - (cal_stdSlope * (1 + cal_trackSlope))) < 0.0001f);
+	check(fabsf(((calSlope * calTrackFit.meanX) + calOffset) - calTrackFit.meanY) < 0.01f);
+
+	calTest_track(0.001f, 20, 100);
+	check(fabsf(calSlope - (cal_stdSlope * (1 - cal_trackSlope))) < 0.0001f);
+}
+
+/* A flat scene only follows the offset */
+void testTrackSpread() {
+	calTest_init();
+	calTest_track(0.09f, 1, 100);
+	checkEqual(calTrackFit.count, 100);
+	check(calSlope == cal_stdSlope);
+	check(fabsf(((calSlope * calTrackFit.meanX) + calOffset) - calTrackFit.meanY) < 0.01f);
+}
+
+/* Samples of a spot sensor that stopped answering are not used */
+void testTrackStale() {
+	calTest_init();
+	calStatus = cal_manual;
+	calTracking = true;
+	memset(&calTrackFit, 0, sizeof(calTrackFit));
+	frameStats.centerAverage = 8000;
+	calTest_responding = false;
+	mlx90614_objTime = millis();
+	delay(mlx90614_staleTime + 100);
+	for (byte i = 0; i < 10; i++) {
+		compensateCalib();
+		delay(10);
+	}
+	checkEqual(calTrackFit.count, 0);
+	//New samples are used again
+	calTest_responding = true;
+	calTest_run(1000);
+	check(calTrackFit.count > 0);
+	calTracking = false;
+	calTrack();
+}
+
+/* The temperatures of the visual mode use the calibration of the current frame */
+void testSnapshotVisual() {
+	calTest_init();
+	test_loadVoSPI("lepton3.vospi", 245 * 164);
+	host_spiDevice = test_spiDevice;
+	host_pinHook = test_camPinHook;
+	test_camJpeg = test_readFixture("camera_320x240.jpg");
+	displayMode = displayMode_visual;
+	hqRes = true;
+	calSnapSlope = 0;
+	calSnapOffset = 0;
+
+	//The ambient temp changes the offset from frame to frame
+	calTest_ambient = 30;
+	for (byte i = 0; i < 20; i++) {
+		createVisCombImg();
+		check(abs(calSnapCenti(minValue) - (int32_t)round(calFunction(minValue) * 100)) <= 1);
+		check(abs(calSnapCenti(maxValue) - (int32_t)round(calFunction(maxValue) * 100)) <= 1);
+		delay(50);
+	}
+	host_pinHook = NULL;
+	displayMode = displayMode_thermal;
+}
+
+int main() {
+	test_run("Spot stale", testSpotStale);
+	test_run("Spot rate", testSpotRate);
+	test_run("Spot ambient stale", testSpotAmbientStale);
+	test_run("Track slope", testTrackSlope);
+	test_run("Track clamp", testTrackClamp);
+	test_run("Track spread", testTrackSpread);
+	test_run("Track stale", testTrackStale);
+	test_run("Snapshot visual", testSnapshotVisual);
+	return test_result();
+}
+
+#endif
@@ -0,0 +1,292 @@
+/*
+*
+* CAMERATEST - JPEG transfer from a model of the VC0706 camera on the UART
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Defines */
+
+//Size of the JPEG frames of the camera model
+#define vcTest_frameSize 3000
+
+/* Variables */
+
+//Read command of the camera model, with the bytes not yet read by the firmware at that time
+struct VcRead {
+	uint32_t offset;
+	uint16_t length;
+	size_t pending;
+};
+
+//JPEG frame in the buffer of the camera
+std::vector<uint8_t> vcTest_jpeg;
+//Command currently received
+std::vector<uint8_t> vcTest_cmd;
+//Read commands received and the end of the transfer
+std::vector<VcRead> vcTest_reads;
+bool vcTest_ended;
+//Read commands that are not answered, answered with too few bytes, and the first one of a camera that hangs
+std::vector<size_t> vcTest_dropReads;
+std::vector<size_t> vcTest_shortReads;
+long vcTest_deadFrom;
+
+/* Methods */
+
+/* Send an answer header or trailer of the camera */
+void vcTest_answer(Stream* stream, uint8_t cmd, uint8_t length = 0) {
+	uint8_t answer[5] = { 0x76, serialNum, cmd, 0x00, length };
+	stream->receive(answer, 5);
+}
+
+/* Check if a list contains the number of a read command */
+bool vcTest_contains(const std::vector<size_t>& list, size_t read) {
+	for (size_t i = 0; i < list.size(); i++)
+		if (list[i] == read)
+			return true;
+	return false;
+}
+
+/* Answer a read of the frame buffer, header, data and trailer */
+void vcTest_read(Stream* stream) {
+	VcRead read;
+	read.offset = ((uint32_t)vcTest_cmd[6] << 24) | ((uint32_t)vcTest_cmd[7] << 16) | (vcTest_cmd[8] << 8) | vcTest_cmd[9];
+	read.length = (vcTest_cmd[12] << 8) | vcTest_cmd[13];
+	read.pending = stream->rx.size();
+	size_t number = vcTest_reads.size();
+	vcTest_reads.push_back(read);
+
+	//Faults of the camera
+	if (vcTest_contains(vcTest_dropReads, number) || ((vcTest_deadFrom >= 0) && (number >= (size_t)vcTest_deadFrom)))
+		return;
+	uint16_t length = read.length;
+	if (vcTest_contains(vcTest_shortReads, number))
+		length -= 10;
+
+	vcTest_answer(stream, 0x32);
+	std::vector<uint8_t> data(length, 0);
+	for (uint16_t i = 0; i < length; i++)
+		if (read.offset + i < vcTest_jpeg.size())
+			data[i] = vcTest_jpeg[read.offset + i];
+	stream->receive(data.data(), data.size());
+	vcTest_answer(stream, 0x32);
+}
+
+/* VC0706 model on the UART, answers every complete command */
+void vcTest_peer(Stream* stream, const uint8_t* data, size_t len) {
+	vcTest_cmd.insert(vcTest_cmd.end(), data, data + len);
+	while (vcTest_cmd.size() >= 4) {
+		//Resync on the command sign
+		if (vcTest_cmd[0] != 0x56) {
+			vcTest_cmd.erase(vcTest_cmd.begin());
+			continue;
+		}
+		size_t size = 4 + vcTest_cmd[3];
+		if (vcTest_cmd.size() < size)
+			return;
+
+		uint8_t cmd = vcTest_cmd[2];
+		//Read of the frame buffer
+		if (cmd == 0x32)
+			vcTest_read(stream);
+		//Length of the frame buffer
+		else if (cmd == 0x34) {
+			vcTest_answer(stream, cmd, 4);
+			uint8_t length[4] = { 0, 0, (uint8_t)(vcTest_jpeg.size() >> 8), (uint8_t)vcTest_jpeg.size() };
+			stream->receive(length, 4);
+		}
+		//Frame buffer control, resume ends the transfer
+		else {
+			if ((cmd == 0x36) && (vcTest_cmd[4] == 0x03))
+				vcTest_ended = true;
+			vcTest_answer(stream, cmd);
+		}
+		vcTest_cmd.erase(vcTest_cmd.begin(), vcTest_cmd.begin() + size);
+	}
+}
+
+/* Firmware of the Teensy 3.1 / 3.2 and a camera model with a random frame */
+void vcTest_init(uint16_t size) {
+	test_initFirmware(leptonVersion_2_shutter);
+	teensyVersion = teensyVersion_old;
+	vcTest_jpeg.resize(size);
+	uint32_t seed = size;
+	for (uint16_t i = 0; i < size; i++) {
+		seed = (seed * 1103515245) + 12345;
+		vcTest_jpeg[i] = seed >> 16;
+	}
+	vcTest_cmd.clear();
+	vcTest_reads.clear();
+	vcTest_ended = false;
+	vcTest_dropReads.clear();
+	vcTest_shortReads.clear();
+	vcTest_deadFrom = -1;
+	Serial1.peer = vcTest_peer;
+	frameptr = 0;
+	sd.chdir("/");
+	strcpy(saveFilename, "20170101120000");
+}
+
+/* Expected file content, the EXIF header follows the first 40 bytes */
+std::vector<uint8_t> vcTest_expected(const uint8_t* exifHeader) {
+	std::vector<uint8_t> expected = vcTest_jpeg;
+	if (exifHeader != NULL)
+		expected.insert(expected.begin() + min(vcTest_jpeg.size(), (size_t)40), exifHeader, exifHeader + 100);
+	return expected;
+}
+
+/* Save a frame and compare the file */
+void vcTest_checkSave(uint16_t size, const uint8_t* exifHeader) {
+	vcTest_init(size);
+	rotationEnabled = (exifHeader == exifHeader_rotated);
+	mlx90614Version = (exifHeader == exifHeader_mirror) ? mlx90614Version_old : mlx90614Version_new;
+	check(vc0706_transfer(NULL, size, camera_save, NULL));
+	check(vcTest_ended);
+	check(host_sdFiles["/20170101120000.JPG"] == vcTest_expected(exifHeader));
+	Serial1.peer = NULL;
+}
+
+/* Streaming requests the next chunk before the trailer of the current one is read */
+void testStreamPipelined() {
+	vcTest_init(vcTest_frameSize);
+	std::vector<uint8_t> buffer(vcTest_frameSize);
+	vc0706_transfer(buffer.data(), vcTest_frameSize, camera_stream, NULL);
+	check(buffer == vcTest_jpeg);
+	checkEqual(vcTest_reads.size(), (vcTest_frameSize + vc0706_chunkSize - 1) / vc0706_chunkSize);
+	for (size_t i = 0; i < vcTest_reads.size(); i++) {
+		checkEqual(vcTest_reads[i].offset, i * vc0706_chunkSize);
+		//The trailer of the last chunk is still in the UART buffer
+		checkEqual(vcTest_reads[i].pending, (i == 0) ? 0 : 5);
+	}
+	check(vcTest_ended);
+	checkEqual(Serial1.available(), 0);
+	Serial1.peer = NULL;
+}
+
+/* Saving fills whole sectors, the next chunk is requested after the sector has been written */
+void testSaveSectors() {
+	vcTest_init(vcTest_frameSize);
+	vc0706_transfer(NULL, vcTest_frameSize, camera_save, NULL);
+	check(host_sdFiles["/20170101120000.JPG"] == vcTest_jpeg);
+	for (size_t i = 0; i < vcTest_reads.size(); i++) {
+		checkEqual(vcTest_reads[i].offset, i * vc0706_chunkSize);
+		checkEqual(vcTest_reads[i].pending, 0);
+	}
+	Serial1.peer = NULL;
+}
+
+/* The EXIF header shifts the following chunks against the sectors */
+void testSaveExif() {
+	//The second chunk fills the rest of the first sector
+	vcTest_init(vcTest_frameSize);
+	rotationEnabled = true;
+	vc0706_transfer(NULL, vcTest_frameSize, camera_save, NULL);
+	check(host_sdFiles["/20170101120000.JPG"] == vcTest_expected(exifHeader_rotated));
+	check(vcTest_reads.size() >= 3);
+	if (vcTest_reads.size() < 3)
+		return;
+	checkEqual(vcTest_reads[0].length, 40);
+	checkEqual(vcTest_reads[1].offset, 40);
+	checkEqual(vcTest_reads[1].length, vc0706_chunkSize - 140);
+	//Requested while the first sector was not full yet
+	checkEqual(vcTest_reads[1].pending, 5);
+	checkEqual(vcTest_reads[2].offset, vc0706_chunkSize - 100);
+	checkEqual(vcTest_reads[2].pending, 0);
+	Serial1.peer = NULL;
+
+	//Frames that end inside, at and behind the first sector and on a later sector boundary
+	vcTest_checkSave(40, exifHeader_rotated);
+	vcTest_checkSave(vc0706_chunkSize - 101, exifHeader_rotated);
+	vcTest_checkSave(vc0706_chunkSize - 100, exifHeader_rotated);
+	vcTest_checkSave(vc0706_chunkSize - 99, exifHeader_rotated);
+	vcTest_checkSave((3 * vc0706_chunkSize) - 100, exifHeader_rotated);
+	//Mirrored header of the ThermocamV4
+	vcTest_checkSave(vcTest_frameSize, exifHeader_mirror);
+}
+
+/* Serial transfer sends the length and every chunk */
+void testSerialExif() {
+	vcTest_init(vcTest_frameSize);
+	rotationEnabled = true;
+	check(vc0706_transfer(NULL, vcTest_frameSize, camera_serial, NULL));
+	std::vector<uint8_t> expected = vcTest_expected(exifHeader_rotated);
+	checkEqual(Serial.tx.size(), 2 + expected.size());
+	checkEqual((Serial.tx[0] << 8) | Serial.tx[1], expected.size());
+	check(std::vector<uint8_t>(Serial.tx.begin() + 2, Serial.tx.end()) == expected);
+	Serial1.peer = NULL;
+}
+
+/* Missing and incomplete answers are requested again */
+void testRetries() {
+	vcTest_init(vcTest_frameSize);
+	rotationEnabled = true;
+	//The pipelined request and its repetition, and a chunk in the middle of the frame
+	vcTest_dropReads = { 1, 2 };
+	vcTest_shortReads = { 4 };
+	vc0706_transfer(NULL, vcTest_frameSize, camera_save, NULL);
+	check(host_sdFiles["/20170101120000.JPG"] == vcTest_expected(exifHeader_rotated));
+	//Eight chunks of 40, 372, five times 512 and 28 bytes, every fault costs one request of the same chunk
+	checkEqual(vcTest_reads.size(), 8 + 3);
+	checkEqual(vcTest_reads[2].offset, vcTest_reads[1].offset);
+	checkEqual(vcTest_reads[5].offset, vcTest_reads[4].offset);
+	check(vcTest_ended);
+	checkEqual(Serial1.available(), 0);
+	Serial1.peer = NULL;
+}
+
+/* A camera that does not answer anymore aborts the transfer */
+void testAbort() {
+	vcTest_init(vcTest_frameSize);
+	vcTest_deadFrom = 2;
+	uint32_t start = millis();
+	check(!vc0706_transfer(NULL, vcTest_frameSize, camera_save, NULL));
+	//The retries of the third chunk, then the camera is released and the file closed
+	checkEqual(vcTest_reads.size(), 2 + vc0706_retries);
+	for (size_t i = 2; i < vcTest_reads.size(); i++)
+		checkEqual(vcTest_reads[i].offset, 2 * vc0706_chunkSize);
+	check(vcTest_ended);
+	check(!sdFile.isOpen());
+	//The truncated image has been removed
+	checkEqual(host_sdFiles.count("/20170101120000.JPG"), 0);
+	check((millis() - start) < 5000);
+	Serial1.peer = NULL;
+
+	//Serial transfer sends the announced length, filled up with zeros
+	vcTest_init(vcTest_frameSize);
+	rotationEnabled = true;
+	vcTest_deadFrom = 2;
+	check(!vc0706_transfer(NULL, vcTest_frameSize, camera_serial, NULL));
+	std::vector<uint8_t> expected = vcTest_expected(exifHeader_rotated);
+	checkEqual(Serial.tx.size(), 2 + expected.size());
+	checkEqual((Serial.tx[0] << 8) | Serial.tx[1], expected.size());
+	//The first 40 bytes, the EXIF header and one full chunk, every chunk is sent directly
+	size_t received = 140 + vc0706_chunkSize;
+	std::fill(expected.begin() + received, expected.end(), 0);
+	check(std::vector<uint8_t>(Serial.tx.begin() + 2, Serial.tx.end()) == expected);
+	Serial1.peer = NULL;
+}
+
+int main() {
+	test_run("VC0706 stream pipelined", testStreamPipelined);
+	test_run("VC0706 save sectors", testSaveSectors);
+	test_run("VC0706 save EXIF", testSaveExif);
+	test_run("VC0706 serial EXIF", testSerialExif);
+	test_run("VC0706 retries", testRetries);
+	test_run("VC0706 abort", testAbort);
+	return test_result();
+}
+
+#endif
@@ -0,0 +1,540 @@
+/*
+*
+* CONNECTIONTEST - Serial protocol v2 against a host model on the other end of the USB serial
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Defines */
+
+//Frames requested or pushed in the frame rate tests
+#define conn_frames 24
+
+/* Variables */
+
+//Packet of protocol v2 as the host sees it
+struct ConnPacket {
+	byte type;
+	byte seq;
+	std::vector<uint8_t> payload;
+	bool crcValid;
+};
+
+//Packets received by the host model and parse position in the transmitted bytes
+std::vector<ConnPacket> conn_packets;
+size_t conn_parsePos;
+//Frames the host model has received and wants, bytes of one protocol v1 frame
+uint16_t conn_framesReceived;
+uint16_t conn_framesWanted;
+size_t conn_v1FrameSize;
+//Completed Lepton captures and the capture count at the first and last received frame
+uint16_t conn_captures;
+uint16_t conn_firstCapture;
+uint16_t conn_lastCapture;
+//Packet and bit position of the delta frame decoder
+const ConnPacket* conn_bitPacket;
+uint32_t conn_bitPos;
+
+/* Methods */
+
+/* Build a protocol v2 request */
+std::vector<uint8_t> connPacket(byte type, byte seq, std::vector<uint8_t> payload) {
+	uint32_t length = payload.size();
+	std::vector<uint8_t> packet = { proto_sync1, proto_sync2, type, seq, (uint8_t)(length >> 24),
+		(uint8_t)(length >> 16), (uint8_t)(length >> 8), (uint8_t)length };
+	packet.insert(packet.end(), payload.begin(), payload.end());
+	uint16_t crc = 0xFFFF;
+	for (size_t i = 2; i < packet.size(); i++)
+		crc = proto_crc(crc, packet[i]);
+	packet.push_back(crc >> 8);
+	packet.push_back(crc & 0xFF);
+	return packet;
+}
+
+/* Queue bytes in the receive buffer of the firmware */
+void connSend(const std::vector<uint8_t>& data) {
+	Serial.receive(data.data(), data.size());
+}
+
+/* Parse the complete packets the firmware has sent, returns the number of new ones */
+size_t connParse() {
+	std::vector<uint8_t>& tx = Serial.tx;
+	size_t count = 0;
+	while (conn_parsePos + proto_headerSize <= tx.size()) {
+		//Everything in between, like the protocol switch acknowledge, is not framed
+		if ((tx[conn_parsePos] != proto_sync1) || (tx[conn_parsePos + 1] != proto_sync2)) {
+			conn_parsePos++;
+			continue;
+		}
+		const uint8_t* header = &tx[conn_parsePos];
+		uint32_t length = ((uint32_t)header[4] << 24) | ((uint32_t)header[5] << 16) | (header[6] << 8) | header[7];
+		if (conn_parsePos + proto_headerSize + length + 2 > tx.size())
+			break;
+
+		ConnPacket packet;
+		packet.type = header[2];
+		packet.seq = header[3];
+		packet.payload.assign(header + proto_headerSize, header + proto_headerSize + length);
+		uint16_t crc = 0xFFFF;
+		for (size_t i = 2; i < proto_headerSize + length; i++)
+			crc = proto_crc(crc, header[i]);
+		packet.crcValid = (crc == ((header[proto_headerSize + length] << 8) | header[proto_headerSize + length + 1]));
+		conn_packets.push_back(packet);
+		conn_parsePos += proto_headerSize + length + 2;
+		count++;
+	}
+	return count;
+}
+
+/* Count the completed captures, the Lepton is deselected after each frame */
+void connPinHook(uint8_t pin, uint8_t value) {
+	if ((pin == pin_lepton_cs) && (value == HIGH))
+		conn_captures++;
+}
+
+/* Note a received frame for the frame rate */
+void connFrameReceived() {
+	if (conn_framesReceived == 0)
+		conn_firstCapture = conn_captures;
+	conn_lastCapture = conn_captures;
+	conn_framesReceived++;
+}
+
+/* Protocol v1 host, requests the next raw frame as soon as the last one is complete */
+void connV1Host(Stream* stream, const uint8_t* data, size_t len) {
+	while ((stream->tx.size() - conn_parsePos) >= conn_v1FrameSize) {
+		conn_parsePos += conn_v1FrameSize;
+		connFrameReceived();
+		uint8_t cmd = (conn_framesReceived < conn_framesWanted) ? CMD_FRAME_RAW : CMD_END;
+		stream->receive(&cmd, 1);
+	}
+}
+
+/* Protocol v2 host, ends the push mode after the wanted number of frames */
+void connV2Host(Stream* stream, const uint8_t* data, size_t len) {
+	size_t first = conn_packets.size();
+	connParse();
+	for (size_t i = first; i < conn_packets.size(); i++) {
+		if (conn_packets[i].type != proto_frame)
+			continue;
+		connFrameReceived();
+		if (conn_framesReceived == conn_framesWanted) {
+			connSend(connPacket(proto_end, 100, {}));
+			connSend({ CMD_END });
+		}
+	}
+}
+
+/* Firmware and host model with a looping Lepton2 stream */
+void connInit() {
+	test_initFirmware(leptonVersion_2_shutter);
+	test_loadVoSPI("lepton2.vospi", 68 * 164);
+	conn_packets.clear();
+	conn_parsePos = 0;
+	conn_framesReceived = 0;
+	conn_captures = 0;
+	Serial.peer = NULL;
+	host_pinHook = connPinHook;
+	serialMode = true;
+}
+
+/* Check a response to a request */
+void checkResponse(const ConnPacket& packet, byte type, byte requestType, byte requestSeq) {
+	checkEqual(packet.type, type);
+	check(packet.crcValid);
+	checkEqual(packet.payload.size(), 2);
+	if (packet.payload.size() == 2) {
+		checkEqual(packet.payload[0], requestType);
+		checkEqual(packet.payload[1], requestSeq);
+	}
+}
+
+/* Check a raw frame packet against the raw values, by default the small buffer */
+void checkRawFrame(const ConnPacket& packet, const uint16_t* values = NULL) {
+	if (values == NULL)
+		values = smallBuffer;
+	checkEqual(packet.type, proto_frame);
+	check(packet.crcValid);
+	checkEqual(packet.payload.size(), 21 + (2 * 4800));
+	if (packet.payload.size() != 21 + (2 * 4800))
+		return;
+	checkEqual(packet.payload[0], proto_frameRaw);
+	checkEqual((packet.payload[1] << 8) | packet.payload[2], 80);
+	checkEqual((packet.payload[3] << 8) | packet.payload[4], 60);
+	uint16_t mismatches = 0;
+	for (uint16_t i = 0; i < 4800; i++)
+		if (((packet.payload[21 + (2 * i)] << 8) | packet.payload[22 + (2 * i)]) != values[i])
+			mismatches++;
+	checkEqual(mismatches, 0);
+}
+
+/* Read bits of a coded delta stream frame, most significant first */
+uint32_t connReadBits(byte count) {
+	uint32_t value = 0;
+	for (byte i = 0; i < count; i++) {
+		size_t pos = 22 + (conn_bitPos >> 3);
+		byte bit = 0;
+		if (pos < conn_bitPacket->payload.size())
+			bit = (conn_bitPacket->payload[pos] >> (7 - (conn_bitPos & 7))) & 1;
+		value = (value << 1) | bit;
+		conn_bitPos++;
+	}
+	return value;
+}
+
+/* Decode a Lepton2 delta stream frame into the small buffer, delta frames are predicted from the reference */
+void connDecodeDelta(const ConnPacket& packet, const uint16_t* reference) {
+	byte coding = packet.payload[21];
+	//Plain values
+	if (coding == proto_deltaPlain) {
+		for (uint16_t i = 0; i < 4800; i++)
+			smallBuffer[i] = (packet.payload[22 + (2 * i)] << 8) | packet.payload[23 + (2 * i)];
+		return;
+	}
+
+	//Same rice code as the raw data files
+	conn_bitPacket = &packet;
+	conn_bitPos = 0;
+	riceReset();
+	for (uint16_t y = 0; y < 60; y++) {
+		for (uint16_t x = 0; x < 80; x++) {
+			uint16_t index = riceIndex(x, y, false);
+			uint16_t predict = (coding == proto_deltaFrame) ? reference[index] : ricePredict(x, y, false);
+			byte k = riceParam();
+			uint16_t value;
+			uint32_t residual;
+			byte quotient = 0;
+			while ((quotient < rice_escape) && connReadBits(1))
+				quotient++;
+			if (quotient == rice_escape) {
+				value = connReadBits(16);
+				int32_t error = value - predict;
+				residual = (error < 0) ? ((-error * 2) - 1) : (error * 2);
+			}
+			else {
+				residual = (quotient << k) | connReadBits(k);
+				value = (residual & 1) ? (predict - ((residual + 1) >> 1)) : (predict + (residual >> 1));
+			}
+			riceUpdate(residual);
+			smallBuffer[index] = value;
+		}
+	}
+	//Nothing left behind the padding
+	checkEqual((conn_bitPos + 7) / 8, packet.payload.size() - 22);
+}
+
+/* The response sequence numbers count up from zero */
+void checkSequence() {
+	for (size_t i = 0; i < conn_packets.size(); i++)
+		checkEqual(conn_packets[i].seq, i);
+}
+
+/* Valid, corrupted and out of sequence requests in one burst */
+void testProtoRequests() {
+	connInit();
+	connSend({ CMD_PROTOCOL_V2 });
+	//The sequence number of the host is only echoed, out of order requests are answered as well
+	connSend(connPacket(proto_getFrame, 7, { proto_frameRaw }));
+	connSend(connPacket(proto_getFrame, 3, { proto_frameRaw }));
+	//Corrupted CRC
+	std::vector<uint8_t> corrupt = connPacket(proto_subscribe, 8, { proto_frameRaw });
+	corrupt[proto_headerSize] ^= 0x01;
+	connSend(corrupt);
+	//Unknown type and invalid frame type
+	connSend(connPacket(42, 9, {}));
+	connSend(connPacket(proto_getFrame, 10, { 9 }));
+	connSend(connPacket(proto_end, 11, {}));
+
+	check(!serialHandler());
+	checkEqual(Serial.tx[0], CMD_PROTOCOL_V2);
+	connParse();
+	checkEqual(conn_packets.size(), 6);
+	if (conn_packets.size() != 6)
+		return;
+	checkRawFrame(conn_packets[0]);
+	checkRawFrame(conn_packets[1]);
+	checkResponse(conn_packets[2], proto_nack, proto_subscribe, 8);
+	checkResponse(conn_packets[3], proto_nack, 42, 9);
+	checkResponse(conn_packets[4], proto_nack, proto_getFrame, 10);
+	checkResponse(conn_packets[5], proto_ack, proto_end, 11);
+	checkSequence();
+	//The corrupted subscription has not been taken
+	checkEqual(proto_subscribed, proto_frameNone);
+	checkEqual(Serial.available(), 0);
+}
+
+/* Noise, truncated and oversized requests, the receiver finds the next packet */
+void testProtoResync() {
+	connInit();
+	connSend({ CMD_PROTOCOL_V2 });
+	//Noise with single and repeated first sync bytes
+	connSend({ 0x00, proto_sync1, 0x13, 0xFF, proto_sync1, proto_sync1, proto_sync1 });
+	connSend(connPacket(proto_subscribe, 1, { proto_frameNone }));
+	//Length beyond the maximum request, the rest of it is noise
+	std::vector<uint8_t> oversized = connPacket(proto_subscribe, 2, std::vector<uint8_t>(proto_maxRequest + 1, 0));
+	check((oversized[oversized.size() - 2] != proto_sync1) && (oversized[oversized.size() - 1] != proto_sync1));
+	connSend(oversized);
+	connSend(connPacket(proto_subscribe, 3, { proto_frameNone }));
+	//Truncated request, the next one completes it and fails the CRC
+	std::vector<uint8_t> truncated = connPacket(proto_subscribe, 4, { proto_frameNone });
+	truncated.resize(proto_headerSize);
+	connSend(truncated);
+	std::vector<uint8_t> swallowed = connPacket(proto_subscribe, 5, { proto_frameNone });
+	check((swallowed[swallowed.size() - 2] != proto_sync1) && (swallowed[swallowed.size() - 1] != proto_sync1));
+	connSend(swallowed);
+	//The host repeats the unanswered request
+	connSend(connPacket(proto_subscribe, 6, { proto_frameNone }));
+	connSend(connPacket(proto_end, 7, {}));
+
+	check(!serialHandler());
+	connParse();
+	checkEqual(conn_packets.size(), 6);
+	if (conn_packets.size() != 6)
+		return;
+	checkResponse(conn_packets[0], proto_ack, proto_subscribe, 1);
+	checkResponse(conn_packets[1], proto_nack, proto_subscribe, 2);
+	checkResponse(conn_packets[2], proto_ack, proto_subscribe, 3);
+	checkResponse(conn_packets[3], proto_nack, proto_subscribe, 4);
+	checkResponse(conn_packets[4], proto_ack, proto_subscribe, 6);
+	checkResponse(conn_packets[5], proto_ack, proto_end, 7);
+	checkSequence();
+}
+
+/* Requests split over several reads of the receive buffer */
+void testProtoSplit() {
+	connInit();
+	proto_rxPos = 0;
+	proto_txSeq = 0;
+	std::vector<uint8_t> request = connPacket(proto_subscribe, 1, { proto_frameRaw });
+	std::vector<uint8_t> end = connPacket(proto_end, 2, {});
+	request.insert(request.end(), end.begin(), end.end());
+	for (size_t i = 0; i < request.size(); i++) {
+		connSend({ request[i] });
+		bool done = proto_receive();
+		check(done == (i == request.size() - 1));
+	}
+	connParse();
+	checkEqual(conn_packets.size(), 2);
+	if (conn_packets.size() != 2)
+		return;
+	checkResponse(conn_packets[0], proto_ack, proto_subscribe, 1);
+	checkResponse(conn_packets[1], proto_ack, proto_end, 2);
+	checkEqual(proto_subscribed, proto_frameRaw);
+	proto_subscribed = proto_frameNone;
+}
+
+/* Pushed raw frames come at least as often as requested ones of protocol v1 */
+void testProtoPushRate() {
+	//Protocol v1, one raw frame per request
+	connInit();
+	conn_v1FrameSize = 1 + (2 * 4800) + 4 + 4 + 8;
+	conn_framesWanted = conn_frames;
+	Serial.peer = connV1Host;
+	connSend({ CMD_FRAME_RAW });
+	serialOutput();
+	Serial.peer = NULL;
+	checkEqual(conn_framesReceived, conn_frames);
+	uint16_t v1Captures = conn_lastCapture - conn_firstCapture;
+
+	//Protocol v2, raw frames pushed after the subscription
+	connInit();
+	conn_framesWanted = conn_frames;
+	Serial.peer = connV2Host;
+	connSend({ CMD_PROTOCOL_V2 });
+	connSend(connPacket(proto_subscribe, 1, { proto_frameRaw }));
+	serialOutput();
+	Serial.peer = NULL;
+	host_pinHook = NULL;
+	checkEqual(conn_framesReceived, conn_frames);
+	uint16_t v2Captures = conn_lastCapture - conn_firstCapture;
+
+	//Every capture is pushed, and not less often than with the requests of v1
+	checkEqual(v2Captures, conn_frames - 1);
+	check(v2Captures <= v1Captures);
+	if (conn_packets.empty())
+		return;
+	checkResponse(conn_packets[0], proto_ack, proto_subscribe, 1);
+	checkRawFrame(conn_packets[conn_packets.size() - 2]);
+	checkResponse(conn_packets.back(), proto_ack, proto_end, 100);
+	checkSequence();
+	serialMode = false;
+}
+
+/* Color and display frames are sent after the raw ones of the same frame */
+void testProtoOrder() {
+	static uint16_t raw[4800];
+	static uint16_t colors[19200];
+	connInit();
+	proto_rxPos = 0;
+	proto_txSeq = 0;
+	proto_pendingColor = 0;
+	proto_pendingDisplay = 0;
+	serialGetFrame();
+	memcpy(raw, smallBuffer, sizeof(raw));
+
+	connSend(connPacket(proto_getFrame, 1, { proto_frameColor }));
+	connSend(connPacket(proto_getFrame, 2, { proto_frameRaw }));
+	connSend(connPacket(proto_getFrame, 3, { proto_frameDisplay }));
+	connSend(connPacket(proto_getFrame, 4, { proto_frameRaw }));
+	check(!proto_receive());
+	proto_sendDeferred();
+	connParse();
+	checkEqual(conn_packets.size(), 3);
+	if (conn_packets.size() != 3)
+		return;
+	checkRawFrame(conn_packets[0], raw);
+	checkRawFrame(conn_packets[1], raw);
+
+	//The color frame is made from the raw values of the frame
+	memcpy(smallBuffer, raw, sizeof(raw));
+	filterImage();
+	convertColors(true);
+	memcpy(colors, smallBuffer, sizeof(colors));
+	ConnPacket& color = conn_packets[2];
+	checkEqual(color.payload.size(), 21 + (2 * 19200));
+	if (color.payload.size() == 21 + (2 * 19200)) {
+		checkEqual(color.payload[0], proto_frameColor);
+		uint16_t mismatches = 0;
+		for (uint16_t i = 0; i < 19200; i++)
+			if (((color.payload[21 + (2 * i)] << 8) | color.payload[22 + (2 * i)]) != colors[i])
+				mismatches++;
+		checkEqual(mismatches, 0);
+	}
+
+	//The display frame follows with the next frame
+	serialGetFrame();
+	proto_sendDeferred();
+	connParse();
+	checkEqual(conn_packets.size(), 4);
+	if (conn_packets.size() == 4)
+		checkEqual(conn_packets[3].payload[0], proto_frameDisplay);
+	checkSequence();
+	checkEqual(proto_pendingColor + proto_pendingDisplay, 0);
+	serialMode = false;
+}
+
+/* A color request does not change the pushed raw frames */
+void testProtoPushColor() {
+	connInit();
+	conn_framesWanted = 3;
+	Serial.peer = connV2Host;
+	connSend({ CMD_PROTOCOL_V2 });
+	connSend(connPacket(proto_subscribe, 1, { proto_frameRaw }));
+	connSend(connPacket(proto_getFrame, 2, { proto_frameColor }));
+	serialOutput();
+	Serial.peer = NULL;
+	host_pinHook = NULL;
+
+	checkEqual(conn_packets.size(), 5);
+	if (conn_packets.size() != 5)
+		return;
+	checkResponse(conn_packets[0], proto_ack, proto_subscribe, 1);
+	checkEqual(conn_packets[2].type, proto_frame);
+	checkEqual(conn_packets[2].payload[0], proto_frameColor);
+	checkResponse(conn_packets[4], proto_ack, proto_end, 100);
+	checkSequence();
+
+	//Both pushed frames hold the raw values of the looping stream
+	std::vector<uint16_t> first(4800);
+	for (uint16_t i = 0; i < 4800; i++)
+		first[i] = (conn_packets[1].payload[21 + (2 * i)] << 8) | conn_packets[1].payload[22 + (2 * i)];
+	uint16_t invalid = 0;
+	for (uint16_t i = 0; i < 4800; i++)
+		if (first[i] >= 16384)
+			invalid++;
+	checkEqual(invalid, 0);
+	checkRawFrame(conn_packets[3], first.data());
+	serialMode = false;
+}
+
+/* Key, delta and plain frames of the delta stream on both Teensy versions */
+void testProtoDelta() {
+	static uint16_t frames[4][4800];
+	for (byte teensy = teensyVersion_old; teensy <= teensyVersion_new; teensy++) {
+		connInit();
+		teensyVersion = teensy;
+		proto_rxPos = 0;
+		proto_txSeq = 0;
+		proto_deltaValid = false;
+		proto_deltaCount = 0;
+		proto_pendingColor = 0;
+		proto_pendingDisplay = 0;
+
+		//Key frame, followed by a color frame
+		serialGetFrame();
+		memcpy(frames[0], smallBuffer, sizeof(frames[0]));
+		connSend(connPacket(proto_getFrame, 1, { proto_frameDelta }));
+		connSend(connPacket(proto_getFrame, 2, { proto_frameColor }));
+		check(!proto_receive());
+		proto_sendDeferred();
+
+		//The reference in the big buffer survives the color frame
+		serialGetFrame();
+		memcpy(frames[1], smallBuffer, sizeof(frames[1]));
+		connSend(connPacket(proto_getFrame, 3, { proto_frameDelta }));
+		check(!proto_receive());
+
+		//Noise gets bigger than plain values, the same noise again is coded against it
+		for (uint16_t i = 0; i < 4800; i++)
+			smallBuffer[i] = rand() & 0xFFFF;
+		memcpy(frames[2], smallBuffer, sizeof(frames[2]));
+		proto_sendFrame(proto_frameDelta);
+		proto_sendFrame(proto_frameDelta);
+
+		connParse();
+		checkEqual(conn_packets.size(), 5);
+		if (conn_packets.size() != 5)
+			continue;
+		checkSequence();
+		ConnPacket* delta[4] = { &conn_packets[0], &conn_packets[2], &conn_packets[3], &conn_packets[4] };
+		byte coding[4] = { proto_deltaKey, (teensy == teensyVersion_new) ? proto_deltaFrame : proto_deltaKey,
+			proto_deltaPlain, proto_deltaFrame };
+		const uint16_t* expected[4] = { frames[0], frames[1], frames[2], frames[2] };
+		const uint16_t* reference[4] = { NULL, frames[0], frames[1], frames[2] };
+		for (byte i = 0; i < 4; i++) {
+			check(delta[i]->crcValid);
+			checkEqual(delta[i]->payload[0], proto_frameDelta);
+			checkEqual(delta[i]->payload[21], coding[i]);
+			if (delta[i]->payload[21] != coding[i])
+				continue;
+			memset(smallBuffer, 0, 9600);
+			connDecodeDelta(*delta[i], reference[i]);
+			uint16_t mismatches = 0;
+			for (uint16_t j = 0; j < 4800; j++)
+				if (smallBuffer[j] != expected[i][j])
+					mismatches++;
+			checkEqual(mismatches, 0);
+		}
+		//Coded frames are smaller than the plain values
+		check(conn_packets[0].payload.size() < 22 + 9600);
+		checkEqual(conn_packets[3].payload.size(), 22 + 9600);
+		check(conn_packets[4].payload.size() < 22 + 1200);
+	}
+	serialMode = false;
+}
+
+int main() {
+	test_run("Protocol requests", testProtoRequests);
+	test_run("Protocol resync", testProtoResync);
+	test_run("Protocol split", testProtoSplit);
+	test_run("Protocol push rate", testProtoPushRate);
+	test_run("Protocol order", testProtoOrder);
+	test_run("Protocol push color", testProtoPushColor);
+	test_run("Protocol delta", testProtoDelta);
+	return test_result();
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+*
+* FILTERTEST - Spatial filters against reference images
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Methods */
+
+/* Load a raw image fixture of the current resolution into a buffer */
+void loadImage(const char* name, uint16_t* buffer) {
+	char path[48];
+	sprintf(path, "%s_%dx%d.raw", name, rawWidth, rawHeight);
+	std::vector<uint8_t> data = test_readFixture(path);
+	checkEqual(data.size(), rawWidth * rawHeight * 2);
+	for (uint16_t i = 0; i < rawWidth * rawHeight; i++)
+		buffer[i] = data[2 * i] | (data[(2 * i) + 1] << 8);
+}
+
+/* Run a filter on the input and compare with the reference, edges separately */
+void checkFilter(const char* name, void (*filter)()) {
+	static uint16_t expected[19200];
+	char path[32];
+	sprintf(path, "filter_%s", name);
+	loadImage("filter_input", smallBuffer);
+	loadImage(path, expected);
+
+	filter();
+
+	uint16_t edge = 0;
+	uint16_t inner = 0;
+	for (int16_t y = 0; y < rawHeight; y++) {
+		for (int16_t x = 0; x < rawWidth; x++) {
+			uint16_t pos = (y * rawWidth) + x;
+			if (smallBuffer[pos] == expected[pos])
+				continue;
+			if ((x < 2) || (y < 2) || (x >= rawWidth - 2) || (y >= rawHeight - 2))
+				edge++;
+			else
+				inner++;
+		}
+	}
+	if ((edge > 0) || (inner > 0))
+		printf("  %s at %dx%d\n", name, rawWidth, rawHeight);
+	checkEqual(edge, 0);
+	checkEqual(inner, 0);
+}
+
+/* All filters at the resolution of one Lepton */
+void checkFilters(byte lepton) {
+	test_initFirmware(lepton);
+	checkFilter("gaussian", gaussianFilter);
+	checkFilter("gaussian5", gaussian5Filter);
+	checkFilter("box", boxFilter);
+	checkFilter("median", medianFilter);
+	checkFilter("bilateral", bilateralFilter);
+}
+
+/* Lepton3 at 160x120 */
+void testFilters160x120() {
+	checkFilters(leptonVersion_3_shutter);
+}
+
+/* Lepton2 at 80x60 */
+void testFilters80x60() {
+	checkFilters(leptonVersion_2_shutter);
+}
+
+int main() {
+	test_run("Filters 160x120", testFilters160x120);
+	test_run("Filters 80x60", testFilters80x60);
+	return test_result();
+}
+
+#endif
@@ -0,0 +1,636 @@
+/*
+*
+* FIXTUREGEN - Create the Lepton VoSPI streams and camera images of the host tests
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* Defines */
+
+//VoSPI packet with ID, CRC and 80 pixels
+#define vospi_packetSize 164
+//Lines per segment or Lepton2 frame
+#define vospi_lines 60
+
+/* Variables */
+
+//Seed of the noise, fixed so that the fixtures are reproducible
+uint32_t gen_seed;
+
+//Quantization tables of the JPEG standard, annex K
+const uint8_t jpeg_lumQuant[64] = {
+	16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+	14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+	18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+	49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+const uint8_t jpeg_chromQuant[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+const uint8_t jpeg_zigzag[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+//Huffman tables of the JPEG standard, code counts per length and symbols
+const uint8_t jpeg_dcLumBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const uint8_t jpeg_dcChromBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const uint8_t jpeg_dcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const uint8_t jpeg_acLumBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+const uint8_t jpeg_acLumValues[162] = {
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+	0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+	0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA };
+const uint8_t jpeg_acChromBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const uint8_t jpeg_acChromValues[162] = {
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+	0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+	0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+	0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+	0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+	0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA };
+
+//Code and length of each symbol of a Huffman table
+struct HuffCode {
+	uint16_t code[256];
+	uint8_t length[256];
+};
+
+//Bit writer of the entropy coded segment
+struct BitWriter {
+	std::vector<uint8_t>* out;
+	uint32_t buffer;
+	int bits;
+};
+
+/* Methods */
+
+/* Pseudo random number of the noise */
+uint32_t gen_random() {
+	gen_seed = gen_seed * 1664525 + 1013904223;
+	return gen_seed >> 16;
+}
+
+/* Raw value of the thermal scene, the hot spot moves with the frame number */
+uint16_t gen_thermal(int x, int y, int width, int height, int frame) {
+	//Scale to 160x120 coordinates
+	float fx = (x * 160.0f) / width;
+	float fy = (y * 120.0f) / height;
+	//Warm floor at the bottom
+	float value = 7900 + (fy * 0.8f);
+	//Hot spot with soft edges
+	float dx = fx - (96 + (frame * 6));
+	float dy = fy - 48;
+	float dist = sqrtf((dx * dx) + (dy * dy));
+	if (dist < 22)
+		value += 520;
+	else if (dist < 30)
+		value += 520 * (30 - dist) / 8;
+	//Cold window
+	if ((fx >= 16) && (fx < 52) && (fy >= 14) && (fy < 44))
+		value -= 160;
+	//Sensor noise
+	value += (int)(gen_random() % 17) - 8;
+	return (uint16_t)value;
+}
+
+/* CRC-CCITT of a packet, the T bits and the CRC itself are zero */
+uint16_t vospi_crc(const uint8_t* packet) {
+	uint16_t crc = 0;
+	for (int i = 0; i < vospi_packetSize; i++) {
+		uint8_t value = packet[i];
+		if (i == 0)
+			value &= 0x0F;
+		if ((i == 2) || (i == 3))
+			value = 0;
+		crc ^= value << 8;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+	}
+	return crc;
+}
+
+/* Add a packet with ID and pixels */
+void vospi_packet(std::vector<uint8_t>& out, uint8_t id0, uint8_t id1, const uint16_t* pixels) {
+	uint8_t packet[vospi_packetSize];
+	packet[0] = id0;
+	packet[1] = id1;
+	for (int i = 0; i < 80; i++) {
+		packet[4 + (2 * i)] = pixels[i] >> 8;
+		packet[5 + (2 * i)] = pixels[i] & 0xFF;
+	}
+	uint16_t crc = vospi_crc(packet);
+	packet[2] = crc >> 8;
+	packet[3] = crc & 0xFF;
+	out.insert(out.end(), packet, packet + vospi_packetSize);
+}
+
+/* Add discard packets, sent while the Lepton has no new line */
+void vospi_discard(std::vector<uint8_t>& out, int count) {
+	uint16_t pixels[80];
+	for (int i = 0; i < count; i++) {
+		for (int j = 0; j < 80; j++)
+			pixels[j] = gen_random();
+		vospi_packet(out, 0x0F, gen_random() & 0xFF, pixels);
+	}
+}
+
+/* Add one segment of a Lepton3 frame, segment zero marks an invalid one */
+void vospi_segment(std::vector<uint8_t>& out, const uint16_t* frame, int segment, int id) {
+	for (int line = 0; line < vospi_lines; line++) {
+		const uint16_t* pixels = &frame[((segment - 1) * 4800) + (line * 80)];
+		uint8_t id0 = (line == 20) ? (id << 4) : 0;
+		vospi_packet(out, id0, line, pixels);
+	}
+}
+
+/* Create a frame of the thermal scene, Lepton3 frames are ordered like the segments */
+std::vector<uint16_t> gen_frame(bool lepton3, int frame) {
+	int width = lepton3 ? 160 : 80;
+	int height = lepton3 ? 120 : 60;
+	std::vector<uint16_t> values(width * height);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			values[(y * width) + x] = gen_thermal(x, y, width, height, frame);
+	return values;
+}
+
+/* Add a complete Lepton2 frame */
+void vospi_lepton2(std::vector<uint8_t>& out, const std::vector<uint16_t>& frame) {
+	for (int line = 0; line < vospi_lines; line++)
+		vospi_packet(out, 0, line, &frame[line * 80]);
+}
+
+/* Add a complete Lepton3 frame */
+void vospi_lepton3(std::vector<uint8_t>& out, const std::vector<uint16_t>& frame) {
+	for (int segment = 1; segment <= 4; segment++)
+		vospi_segment(out, frame.data(), segment, segment);
+}
+
+/* Write a fixture file */
+bool gen_write(const std::string& dir, const char* name, const std::vector<uint8_t>& data) {
+	std::string path = dir + name;
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Cannot write %s\n", path.c_str());
+		return false;
+	}
+	fwrite(data.data(), 1, data.size(), file);
+	fclose(file);
+	printf("%s: %u bytes\n", path.c_str(), (unsigned)data.size());
+	return true;
+}
+
+/* Add a marker segment with its length */
+void jpeg_segment(std::vector<uint8_t>& out, uint8_t marker, const std::vector<uint8_t>& data) {
+	out.push_back(0xFF);
+	out.push_back(marker);
+	out.push_back((data.size() + 2) >> 8);
+	out.push_back((data.size() + 2) & 0xFF);
+	out.insert(out.end(), data.begin(), data.end());
+}
+
+/* Build the codes of a Huffman table */
+void jpeg_huffCodes(const uint8_t* bits, const uint8_t* values, HuffCode* table) {
+	uint16_t code = 0;
+	int k = 0;
+	for (int length = 1; length <= 16; length++) {
+		for (int i = 0; i < bits[length - 1]; i++) {
+			table->code[values[k]] = code++;
+			table->length[values[k]] = length;
+			k++;
+		}
+		code <<= 1;
+	}
+}
+
+/* Add a Huffman table to the DHT segment */
+void jpeg_huffTable(std::vector<uint8_t>& dht, uint8_t id, const uint8_t* bits, const uint8_t* values) {
+	dht.push_back(id);
+	int count = 0;
+	for (int i = 0; i < 16; i++) {
+		dht.push_back(bits[i]);
+		count += bits[i];
+	}
+	dht.insert(dht.end(), values, values + count);
+}
+
+/* Write bits, with a stuffed zero after every 0xFF */
+void jpeg_putBits(BitWriter* writer, uint32_t code, int length) {
+	writer->buffer = (writer->buffer << length) | (code & ((1 << length) - 1));
+	writer->bits += length;
+	while (writer->bits >= 8) {
+		uint8_t value = (writer->buffer >> (writer->bits - 8)) & 0xFF;
+		writer->out->push_back(value);
+		if (value == 0xFF)
+			writer->out->push_back(0x00);
+		writer->bits -= 8;
+	}
+}
+
+/* Magnitude category and bits of a coefficient */
+void jpeg_category(int value, int* size, uint32_t* bits) {
+	int magnitude = (value < 0) ? -value : value;
+	*size = 0;
+	while (magnitude > 0) {
+		(*size)++;
+		magnitude >>= 1;
+	}
+	*bits = (value < 0) ? (value - 1) : value;
+}
+
+/* Transform, quantize and encode one 8x8 block */
+void jpeg_block(BitWriter* writer, const float* block, const uint8_t* quant, int* lastDC, const HuffCode* dc, const HuffCode* ac) {
+	//Forward DCT
+	int coeffs[64];
+	for (int v = 0; v < 8; v++) {
+		for (int u = 0; u < 8; u++) {
+			float sum = 0;
+			for (int y = 0; y < 8; y++)
+				for (int x = 0; x < 8; x++)
+					sum += block[(y * 8) + x] * cosf(((2 * x + 1) * u * (float)M_PI) / 16) * cosf(((2 * y + 1) * v * (float)M_PI) / 16);
+			float cu = (u == 0) ? (1 / sqrtf(2)) : 1;
+			float cv = (v == 0) ? (1 / sqrtf(2)) : 1;
+			coeffs[(v * 8) + u] = (int)lroundf((0.25f * cu * cv * sum) / quant[(v * 8) + u]);
+		}
+	}
+
+	//DC difference
+	int size;
+	uint32_t bits;
+	jpeg_category(coeffs[0] - *lastDC, &size, &bits);
+	*lastDC = coeffs[0];
+	jpeg_putBits(writer, dc->code[size], dc->length[size]);
+	if (size > 0)
+		jpeg_putBits(writer, bits, size);
+
+	//AC run lengths in zigzag order
+	int run = 0;
+	for (int i = 1; i < 64; i++) {
+		int value = coeffs[jpeg_zigzag[i]];
+		if (value == 0) {
+			run++;
+			continue;
+		}
+		while (run > 15) {
+			jpeg_putBits(writer, ac->code[0xF0], ac->length[0xF0]);
+			run -= 16;
+		}
+		jpeg_category(value, &size, &bits);
+		uint8_t symbol = (run << 4) | size;
+		jpeg_putBits(writer, ac->code[symbol], ac->length[symbol]);
+		jpeg_putBits(writer, bits, size);
+		run = 0;
+	}
+	//End of block
+	if (run > 0)
+		jpeg_putBits(writer, ac->code[0x00], ac->length[0x00]);
+}
+
+/* Color of the visual scene, the warm object of the thermal scene is red */
+void gen_visual(int x, int y, int width, int height, float* r, float* g, float* b) {
+	float fx = (x * 160.0f) / width;
+	float fy = (y * 120.0f) / height;
+	//Sky and floor
+	*r = 90 + fy;
+	*g = 120 + (fy / 2);
+	*b = 200 - fy;
+	//Object at the position of the hot spot
+	float dx = fx - 96;
+	float dy = fy - 48;
+	if (((dx * dx) + (dy * dy)) < (24 * 24)) {
+		*r = 220;
+		*g = 60 + (fx - 72);
+		*b = 40;
+	}
+	//Window frame
+	if ((fx >= 16) && (fx < 52) && (fy >= 14) && (fy < 44)) {
+		bool frame = (fx < 18) || (fx >= 50) || (fy < 16) || (fy >= 42);
+		*r = frame ? 240 : 30;
+		*g = frame ? 240 : 50;
+		*b = frame ? 240 : 80;
+	}
+	//Texture
+	*r += (int)(gen_random() % 9) - 4;
+	*g += (int)(gen_random() % 9) - 4;
+	*b += (int)(gen_random() % 9) - 4;
+}
+
+/* Encode the visual scene as baseline JPEG with 4:2:2 subsampling like the cameras */
+std::vector<uint8_t> gen_jpeg(int width, int height, int quality) {
+	std::vector<float> Y(width * height), Cb(width * height), Cr(width * height);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float r, g, b;
+			gen_visual(x, y, width, height, &r, &g, &b);
+			Y[(y * width) + x] = (0.299f * r) + (0.587f * g) + (0.114f * b) - 128;
+			Cb[(y * width) + x] = (-0.168736f * r) - (0.331264f * g) + (0.5f * b);
+			Cr[(y * width) + x] = (0.5f * r) - (0.418688f * g) - (0.081312f * b);
+		}
+	}
+
+	//Scaled quantization tables
+	int scale = (quality < 50) ? (5000 / quality) : (200 - (2 * quality));
+	uint8_t lumQuant[64], chromQuant[64];
+	for (int i = 0; i < 64; i++) {
+		int lum = ((jpeg_lumQuant[i] * scale) + 50) / 100;
+		int chrom = ((jpeg_chromQuant[i] * scale) + 50) / 100;
+		lumQuant[i] = (lum < 1) ? 1 : ((lum > 255) ? 255 : lum);
+		chromQuant[i] = (chrom < 1) ? 1 : ((chrom > 255) ? 255 : chrom);
+	}
+
+	std::vector<uint8_t> out = { 0xFF, 0xD8 };
+	//JFIF header, the firmware inserts the EXIF header after these first 20 bytes
+	jpeg_segment(out, 0xE0, { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+	std::vector<uint8_t> dqt = { 0 };
+	for (int i = 0; i < 64; i++)
+		dqt.push_back(lumQuant[jpeg_zigzag[i]]);
+	dqt.push_back(1);
+	for (int i = 0; i < 64; i++)
+		dqt.push_back(chromQuant[jpeg_zigzag[i]]);
+	jpeg_segment(out, 0xDB, dqt);
+	jpeg_segment(out, 0xC0, { 8, (uint8_t)(height >> 8), (uint8_t)height, (uint8_t)(width >> 8), (uint8_t)width,
+		3, 1, 0x21, 0, 2, 0x11, 1, 3, 0x11, 1 });
+	std::vector<uint8_t> dht;
+	jpeg_huffTable(dht, 0x00, jpeg_dcLumBits, jpeg_dcValues);
+	jpeg_huffTable(dht, 0x10, jpeg_acLumBits, jpeg_acLumValues);
+	jpeg_huffTable(dht, 0x01, jpeg_dcChromBits, jpeg_dcValues);
+	jpeg_huffTable(dht, 0x11, jpeg_acChromBits, jpeg_acChromValues);
+	jpeg_segment(out, 0xC4, dht);
+	jpeg_segment(out, 0xDA, { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 });
+
+	HuffCode dcLum = {}, acLum = {}, dcChrom = {}, acChrom = {};
+	jpeg_huffCodes(jpeg_dcLumBits, jpeg_dcValues, &dcLum);
+	jpeg_huffCodes(jpeg_acLumBits, jpeg_acLumValues, &acLum);
+	jpeg_huffCodes(jpeg_dcChromBits, jpeg_dcValues, &dcChrom);
+	jpeg_huffCodes(jpeg_acChromBits, jpeg_acChromValues, &acChrom);
+
+	//MCUs of 16x8 pixels, two luminance blocks and one of each chroma
+	BitWriter writer = { &out, 0, 0 };
+	int lastY = 0, lastCb = 0, lastCr = 0;
+	float block[64];
+	for (int my = 0; my < height; my += 8) {
+		for (int mx = 0; mx < width; mx += 16) {
+			for (int half = 0; half < 2; half++) {
+				for (int y = 0; y < 8; y++)
+					for (int x = 0; x < 8; x++)
+						block[(y * 8) + x] = Y[((my + y) * width) + mx + (half * 8) + x];
+				jpeg_block(&writer, block, lumQuant, &lastY, &dcLum, &acLum);
+			}
+			for (int c = 0; c < 2; c++) {
+				std::vector<float>& plane = (c == 0) ? Cb : Cr;
+				for (int y = 0; y < 8; y++)
+					for (int x = 0; x < 8; x++)
+						block[(y * 8) + x] = (plane[((my + y) * width) + mx + (2 * x)] + plane[((my + y) * width) + mx + (2 * x) + 1]) / 2;
+				jpeg_block(&writer, block, chromQuant, (c == 0) ? &lastCb : &lastCr, &dcChrom, &acChrom);
+			}
+		}
+	}
+	//Pad the last byte with ones
+	if (writer.bits > 0)
+		jpeg_putBits(&writer, 0x7F, 8 - writer.bits);
+	out.push_back(0xFF);
+	out.push_back(0xD9);
+	return out;
+}
+
+/* Image for the filters, the scene with spikes and hot edges that the replicated borders see */
+std::vector<uint16_t> gen_filterInput(int width, int height) {
+	std::vector<uint16_t> image(width * height);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint16_t value = gen_thermal(x, y, width, height, 0);
+			//Hot first column and cold last line
+			if (x == 0)
+				value += 240;
+			if (y == height - 1)
+				value -= 200;
+			//Single pixel spikes, also on the edges and corners
+			uint32_t spike = gen_random() % 40;
+			if (spike == 0)
+				value += 300 + (gen_random() % 200);
+			else if (spike == 1)
+				value -= 300 + (gen_random() % 200);
+			image[(y * width) + x] = value;
+		}
+	}
+	//Hot corners
+	image[0] += 700;
+	image[width - 1] += 500;
+	image[(height - 1) * width] += 600;
+	image[(height * width) - 1] += 800;
+	return image;
+}
+
+/* Pixel of an image, coordinates outside are replicated from the edge */
+uint16_t ref_pixel(const std::vector<uint16_t>& image, int width, int height, int x, int y) {
+	x = (x < 0) ? 0 : ((x >= width) ? width - 1 : x);
+	y = (y < 0) ? 0 : ((y >= height) ? height - 1 : y);
+	return image[(y * width) + x];
+}
+
+/* Direct 2D convolution with a separable kernel, rounded division by the kernel sum */
+std::vector<uint16_t> ref_convolve(const std::vector<uint16_t>& image, int width, int height, const int* kernel, int size) {
+	std::vector<uint16_t> out(image.size());
+	int radius = size / 2;
+	uint32_t total = 0;
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			total += kernel[i] * kernel[j];
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint32_t sum = 0;
+			for (int j = -radius; j <= radius; j++)
+				for (int i = -radius; i <= radius; i++)
+					sum += kernel[j + radius] * kernel[i + radius] * ref_pixel(image, width, height, x + i, y + j);
+			out[(y * width) + x] = (sum + (total / 2)) / total;
+		}
+	}
+	return out;
+}
+
+/* Median of the 3x3 neighbourhood by sorting it */
+std::vector<uint16_t> ref_median(const std::vector<uint16_t>& image, int width, int height) {
+	std::vector<uint16_t> out(image.size());
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint16_t window[9];
+			int count = 0;
+			for (int j = -1; j <= 1; j++)
+				for (int i = -1; i <= 1; i++)
+					window[count++] = ref_pixel(image, width, height, x + i, y + j);
+			std::sort(window, window + 9);
+			out[(y * width) + x] = window[4];
+		}
+	}
+	return out;
+}
+
+/* Bilateral filter with a gaussian range weight of sigma 20, quantized like the firmware table */
+std::vector<uint16_t> ref_bilateral(const std::vector<uint16_t>& image, int width, int height) {
+	std::vector<uint16_t> out(image.size());
+	const int spatial[3] = { 1, 2, 1 };
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint16_t value = image[(y * width) + x];
+			uint32_t sum = 0;
+			uint32_t weights = 0;
+			for (int j = -1; j <= 1; j++) {
+				for (int i = -1; i <= 1; i++) {
+					uint16_t neighbour = ref_pixel(image, width, height, x + i, y + j);
+					int diff = abs((int)neighbour - (int)value) / 4;
+					//Range weight of the difference step, zero from 60 on
+					uint32_t range = (diff >= 15) ? 0 : (uint32_t)lroundf(64 * expf(-(diff * 4.0f * diff * 4.0f) / (2 * 20.0f * 20.0f)));
+					uint32_t weight = spatial[j + 1] * spatial[i + 1] * range;
+					sum += weight * neighbour;
+					weights += weight;
+				}
+			}
+			out[(y * width) + x] = (sum + (weights / 2)) / weights;
+		}
+	}
+	return out;
+}
+
+/* Raw values as little endian bytes */
+std::vector<uint8_t> gen_raw(const std::vector<uint16_t>& image) {
+	std::vector<uint8_t> out;
+	for (size_t i = 0; i < image.size(); i++) {
+		out.push_back(image[i] & 0xFF);
+		out.push_back(image[i] >> 8);
+	}
+	return out;
+}
+
+/* Write the input and the reference output of every filter for one resolution */
+bool gen_filters(const std::string& dir, int width, int height) {
+	const int gaussian[3] = { 1, 2, 1 };
+	const int gaussian5[5] = { 1, 4, 6, 4, 1 };
+	const int box[3] = { 1, 1, 1 };
+	std::vector<uint16_t> input = gen_filterInput(width, height);
+	std::string size = std::to_string(width) + "x" + std::to_string(height);
+	bool ok = true;
+	ok &= gen_write(dir, ("filter_input_" + size + ".raw").c_str(), gen_raw(input));
+	ok &= gen_write(dir, ("filter_gaussian_" + size + ".raw").c_str(), gen_raw(ref_convolve(input, width, height, gaussian, 3)));
+	ok &= gen_write(dir, ("filter_gaussian5_" + size + ".raw").c_str(), gen_raw(ref_convolve(input, width, height, gaussian5, 5)));
+	ok &= gen_write(dir, ("filter_box_" + size + ".raw").c_str(), gen_raw(ref_convolve(input, width, height, box, 3)));
+	ok &= gen_write(dir, ("filter_median_" + size + ".raw").c_str(), gen_raw(ref_median(input, width, height)));
+	ok &= gen_write(dir, ("filter_bilateral_" + size + ".raw").c_str(), gen_raw(ref_bilateral(input, width, height)));
+	return ok;
+}
+
+/* Create all fixtures in the given directory */
+int main(int argc, char** argv) {
+	std::string dir = (argc > 1) ? std::string(argv[1]) + "/" : "Fixtures/";
+	bool ok = true;
+
+	//Lepton2: discard packets before and between two frames
+	gen_seed = 1;
+	{
+		std::vector<uint8_t> out;
+		vospi_discard(out, 5);
+		vospi_lepton2(out, gen_frame(false, 0));
+		vospi_discard(out, 3);
+		vospi_lepton2(out, gen_frame(false, 1));
+		ok &= gen_write(dir, "lepton2.vospi", out);
+	}
+
+	//Lepton2: line 30 is repeated as 29, then the capture waits for the next frame
+	gen_seed = 2;
+	{
+		std::vector<uint8_t> out;
+		std::vector<uint16_t> frame = gen_frame(false, 0);
+		vospi_discard(out, 2);
+		for (int line = 0; line < vospi_lines; line++) {
+			int sent = (line == 30) ? 29 : line;
+			vospi_packet(out, 0, sent, &frame[sent * 80]);
+		}
+		vospi_discard(out, 3);
+		vospi_lepton2(out, gen_frame(false, 1));
+		ok &= gen_write(dir, "lepton2_rowerror.vospi", out);
+	}
+
+	//Lepton2: more discard packets than the error limit, forces a resync
+	gen_seed = 3;
+	{
+		std::vector<uint8_t> out;
+		vospi_discard(out, 300);
+		vospi_lepton2(out, gen_frame(false, 2));
+		ok &= gen_write(dir, "lepton2_resync.vospi", out);
+	}
+
+	//Lepton3: discard packets before and between two frames
+	gen_seed = 4;
+	{
+		std::vector<uint8_t> out;
+		vospi_discard(out, 3);
+		vospi_lepton3(out, gen_frame(true, 0));
+		vospi_discard(out, 2);
+		vospi_lepton3(out, gen_frame(true, 1));
+		ok &= gen_write(dir, "lepton3.vospi", out);
+	}
+
+	//Lepton3: starts with segments 3 and 4, then an invalid frame and a valid one
+	gen_seed = 5;
+	{
+		std::vector<uint8_t> out;
+		std::vector<uint16_t> partial = gen_frame(true, 0);
+		std::vector<uint16_t> invalid = gen_frame(true, 1);
+		vospi_discard(out, 3);
+		vospi_segment(out, partial.data(), 3, 3);
+		vospi_segment(out, partial.data(), 4, 4);
+		for (int segment = 1; segment <= 4; segment++)
+			vospi_segment(out, invalid.data(), segment, 0);
+		vospi_lepton3(out, gen_frame(true, 2));
+		ok &= gen_write(dir, "lepton3_segment.vospi", out);
+	}
+
+	//Camera pictures for the low and middle resolution
+	gen_seed = 6;
+	ok &= gen_write(dir, "camera_160x120.jpg", gen_jpeg(160, 120, 80));
+	ok &= gen_write(dir, "camera_320x240.jpg", gen_jpeg(320, 240, 80));
+
+	//Filters at the Lepton3 and Lepton2 resolution
+	gen_seed = 7;
+	ok &= gen_filters(dir, 160, 120);
+	ok &= gen_filters(dir, 80, 60);
+
+	return ok ? 0 : 1;
+}
+
+#endif
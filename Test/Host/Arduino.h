@@ -0,0 +1,585 @@
+/*
+*
+* ARDUINO - Teensy core stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+//Standard headers first, the core macros below would break them
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Defines */
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+#define PROGMEM
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define MSBFIRST 1
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define BYTE 0
+#define A14 40
+
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+
+//Same typed helpers as the Teensy core, every argument is evaluated once
+#define min(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); (_a < _b) ? _a : _b; })
+#define max(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); (_a > _b) ? _a : _b; })
+#define abs(x) ({ __typeof__(x) _x = (x); (_x > 0) ? _x : -_x; })
+#define constrain(amt, low, high) ({ __typeof__(amt) _amt = (amt); __typeof__(low) _low = (low); \
+	__typeof__(high) _high = (high); (_amt < _low) ? _low : ((_amt > _high) ? _high : _amt); })
+#define round(x) ({ __typeof__(x) _x = (x); (_x >= 0) ? (long)(_x + 0.5) : (long)(_x - 0.5); })
+
+/* Re-map a number from one range to another */
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+//The restart hook of the mass storage mode is ARM code
+#define asm(code) ((void)0)
+
+//Interrupts are delivered from host_pump(), there is nothing to mask
+#define __disable_irq() ((void)0)
+#define __enable_irq() ((void)0)
+#define NVIC_DISABLE_IRQ(n) ((void)(n))
+#define NVIC_ENABLE_IRQ(n) ((void)(n))
+#define NVIC_CLEAR_PENDING(n) ((void)(n))
+#define NVIC_SET_PRIORITY(n, p) ((void)(n))
+#define digitalPinToInterrupt(p) (p)
+
+//Registers without a function on the host
+#define SIM_SCGC4 host_reg
+#define SIM_SCGC4_USBOTG 1
+#define SIM_CLKDIV1 host_reg
+#define SIM_CLKDIV2 host_reg
+#define ADC1_SC3 host_reg
+#define ADC1_SC1A host_reg
+#define ADC_SC3_CAL 0
+#define MCG_C1 host_reg
+#define MCG_C1_CLKS(n) (n)
+#define MCG_C1_FRDIV(n) (n)
+#define IRQ_USBOTG 1
+#define IRQ_PORTA 1
+#define IRQ_PORTB 1
+#define IRQ_PORTC 1
+#define IRQ_PORTD 1
+#define IRQ_PORTE 1
+#define CORE_PIN8_CONFIG host_reg
+#define CORE_PIN11_CONFIG host_reg
+#define CORE_PIN12_CONFIG host_reg
+#define CORE_PIN13_CONFIG host_reg
+#define CORE_PIN14_CONFIG host_reg
+#define PORT_PCR_MUX(n) (n)
+#define PORT_PCR_DSE 1
+#define PORT_PCR_SRE 2
+#define SCB_AIRCR host_reg
+
+//Cycle counter of the profiler, counts the host time in cycles of the target clock
+#define ARM_DEMCR host_reg
+#define ARM_DEMCR_TRCENA 1
+#define ARM_DWT_CTRL host_reg
+#define ARM_DWT_CTRL_CYCCNTENA 1
+#define ARM_DWT_CYCCNT host_cycles()
+
+//SPI module, the status register always reports an idle bus
+#define SPI0_MCR KINETISK_SPI0.MCR
+#define SPI0_SR KINETISK_SPI0.SR
+#define SPI0_RSER KINETISK_SPI0.RSER
+#define SPI0_PUSHR KINETISK_SPI0.PUSHR
+#define SPI0_POPR KINETISK_SPI0.POPR
+#define SPI_PUSHR_CONT (1u << 31)
+#define SPI_PUSHR_CTAS(n) ((n) << 28)
+#define SPI_PUSHR_EOQ (1u << 27)
+#define SPI_PUSHR_PCS(n) ((n) << 16)
+#define SPI_SR_TCF (1u << 31)
+#define SPI_SR_EOQF (1u << 28)
+#define SPI_SR_TFFF (1u << 25)
+#define SPI_SR_RFOF (1u << 19)
+#define SPI_SR_RFDF (1u << 17)
+#define SPI_SR_TXCTR 0xF000
+#define SPI_SR_RXCTR 0xF0
+#define SPI_MCR_MSTR (1u << 31)
+#define SPI_MCR_CLR_TXF (1u << 11)
+#define SPI_MCR_CLR_RXF (1u << 10)
+#define SPI_MCR_PCSIS(n) ((n) << 16)
+#define SPI_MCR_HALT 1
+#define SPI_RSER_EOQF_RE (1u << 28)
+#define SPI_RSER_TFFF_RE (1u << 25)
+#define SPI_RSER_TFFF_DIRS (1u << 24)
+#define SPI_RSER_RFDF_RE (1u << 17)
+#define SPI_RSER_RFDF_DIRS (1u << 16)
+
+//DMA
+#define DMA_TCD_CSR_INTMAJOR 2
+#define DMA_TCD_CSR_DREQ 8
+#define DMAMUX_SOURCE_SPI0_RX 14
+#define DMAMUX_SOURCE_SPI0_TX 15
+
+//Maximum number of events delivered by one host_pump() call
+#define host_pumpLimit 1000000
+
+/* Variables */
+
+//Target of all registers without a function
+volatile uint32_t host_reg;
+//Start of the host clock and the time skipped by delays and timers in microseconds
+std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+uint64_t host_skipped = 0;
+//Pin levels, analog values and pin interrupts
+uint8_t host_pins[64];
+uint16_t host_analog[64];
+void (*host_pinISR[64])();
+//Called for every pin change, lets the device models follow the chip selects
+void (*host_pinHook)(uint8_t pin, uint8_t value) = NULL;
+//Emulated EEPROM
+uint8_t host_eeprom[4096];
+//Device on the SPI bus, replaces the transmitted bytes with the received ones
+void (*host_spiDevice)(uint8_t* data, size_t len) = NULL;
+//Running inside host_pump(), interrupts do not nest
+bool host_pumping = false;
+
+/* Methods */
+
+void host_pump();
+
+/* Microseconds since the start, including the skipped time */
+inline uint64_t host_micros() {
+	auto elapsed = std::chrono::steady_clock::now() - host_start;
+	return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + host_skipped;
+}
+
+/* Cycles of the target clock since the start, only the real time */
+inline uint32_t host_cycles() {
+	auto elapsed = std::chrono::steady_clock::now() - host_start;
+	uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	return (uint32_t)((ns * (F_CPU / 1000000)) / 1000);
+}
+
+/* Let the clock skip ahead without waiting */
+inline void host_skip(uint64_t us) {
+	host_skipped += us;
+}
+
+/* Exchange bytes with the SPI device */
+inline void host_spiTransfer(uint8_t* data, size_t len) {
+	if (host_spiDevice != NULL)
+		host_spiDevice(data, len);
+	else
+		memset(data, 0, len);
+}
+
+inline uint32_t millis() { return (uint32_t)(host_micros() / 1000); }
+inline uint32_t micros() { return (uint32_t)host_micros(); }
+inline void delay(uint32_t ms) { host_skip((uint64_t)ms * 1000); host_pump(); }
+inline void delayMicroseconds(uint32_t us) { host_skip(us); }
+inline void yield() { host_pump(); }
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+	if (mode == INPUT_PULLUP)
+		host_pins[pin] = HIGH;
+}
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+	host_pins[pin] = value ? HIGH : LOW;
+	if (host_pinHook != NULL)
+		host_pinHook(pin, host_pins[pin]);
+}
+inline void digitalWriteFast(uint8_t pin, uint8_t value) { digitalWrite(pin, value); }
+inline int digitalRead(uint8_t pin) { return host_pins[pin]; }
+inline int digitalReadFast(uint8_t pin) { return host_pins[pin]; }
+inline int analogRead(uint8_t pin) { return host_analog[pin]; }
+inline void analogWrite(uint8_t pin, int value) { host_analog[pin] = value; }
+inline void analogReadResolution(int bits) {}
+inline void analogReadAveraging(int num) {}
+inline void attachInterrupt(uint8_t pin, void (*isr)(), int mode) { host_pinISR[pin] = isr; }
+inline void detachInterrupt(uint8_t pin) { host_pinISR[pin] = NULL; }
+
+inline uint8_t eeprom_read_byte(const uint8_t* addr) { return host_eeprom[(uintptr_t)addr & 4095]; }
+inline void eeprom_write_byte(uint8_t* addr, uint8_t value) { host_eeprom[(uintptr_t)addr & 4095] = value; }
+#define eeprom_read_byte(addr) eeprom_read_byte((const uint8_t*)(uintptr_t)(addr))
+#define eeprom_write_byte(addr, value) eeprom_write_byte((uint8_t*)(uintptr_t)(addr), value)
+
+/* Integer to string in any base */
+inline char* ultoa(unsigned long value, char* str, int base) {
+	char digits[33];
+	int len = 0;
+	do {
+		int digit = value % base;
+		digits[len++] = (digit < 10) ? ('0' + digit) : ('A' + digit - 10);
+		value /= base;
+	} while (value != 0);
+	for (int i = 0; i < len; i++)
+		str[i] = digits[len - 1 - i];
+	str[len] = '\0';
+	return str;
+}
+inline char* ltoa(long value, char* str, int base) {
+	if ((value < 0) && (base == 10)) {
+		str[0] = '-';
+		ultoa(-(unsigned long)value, str + 1, base);
+		return str;
+	}
+	return ultoa((unsigned long)value, str, base);
+}
+inline char* itoa(int value, char* str, int base) { return ltoa(value, str, base); }
+inline char* dtostrf(double value, signed char width, unsigned char prec, char* str) {
+	sprintf(str, "%*.*f", width, prec, value);
+	return str;
+}
+
+/* SPI module registers */
+struct host_spiStatus {
+	operator uint32_t() const { return SPI_SR_TCF | SPI_SR_EOQF | SPI_SR_TFFF; }
+	host_spiStatus& operator=(uint32_t value) { return *this; }
+};
+struct KINETISK_SPI_t {
+	volatile uint32_t MCR;
+	volatile uint32_t TCR;
+	volatile uint32_t CTAR0;
+	volatile uint32_t CTAR1;
+	host_spiStatus SR;
+	volatile uint32_t RSER;
+	volatile uint32_t PUSHR;
+	volatile uint32_t POPR;
+};
+KINETISK_SPI_t KINETISK_SPI0;
+
+/* DMA channel, the transfer is done by host_pump() */
+class DMAChannel {
+public:
+	struct TCD_t {
+		volatile uint16_t CSR;
+	};
+	TCD_t* TCD;
+
+	DMAChannel(bool allocate = true) : TCD(&tcd) { list().push_back(this); }
+	void begin(bool force = false) {}
+	void source(volatile const uint8_t& p) { src = &p; }
+	void source(volatile const uint16_t& p) { src = &p; }
+	void source(volatile const uint32_t& p) { src = &p; }
+	void sourceBuffer(volatile const uint8_t* p, unsigned len) { src = p; count = len; }
+	void sourceBuffer(volatile const uint16_t* p, unsigned len) { src = p; count = len / 2; }
+	void sourceBuffer(volatile const uint32_t* p, unsigned len) { src = p; count = len / 4; }
+	void destination(volatile uint8_t& p) { dest = &p; }
+	void destination(volatile uint16_t& p) { dest = &p; }
+	void destination(volatile uint32_t& p) { dest = &p; }
+	void destinationBuffer(volatile uint8_t* p, unsigned len) { dest = p; count = len; }
+	void destinationBuffer(volatile uint16_t* p, unsigned len) { dest = p; count = len / 2; }
+	void transferSize(unsigned len) {}
+	void transferCount(unsigned len) { count = len; }
+	void disableOnCompletion() { tcd.CSR |= DMA_TCD_CSR_DREQ; }
+	void interruptAtCompletion() { tcd.CSR |= DMA_TCD_CSR_INTMAJOR; }
+	void triggerAtHardwareEvent(uint8_t source) {}
+	void attachInterrupt(void (*function)()) { isr = function; }
+	void detachInterrupt() { isr = NULL; }
+	void clearInterrupt() {}
+	void enable() { pending = true; host_pump(); }
+	void disable() { pending = false; }
+
+	/* Do the pending transfer and raise the interrupt, returns false if there was none */
+	bool run() {
+		if (!pending)
+			return false;
+		pending = false;
+		//Receive from the SPI device, transmitted data only clocks it
+		if (src == (volatile const void*)&KINETISK_SPI0.POPR)
+			host_spiTransfer((uint8_t*)dest, count);
+		if ((tcd.CSR & DMA_TCD_CSR_INTMAJOR) && (isr != NULL))
+			isr();
+		return true;
+	}
+
+	static std::vector<DMAChannel*>& list() {
+		static std::vector<DMAChannel*> channels;
+		return channels;
+	}
+
+private:
+	TCD_t tcd = { 0 };
+	volatile const void* src = NULL;
+	volatile void* dest = NULL;
+	unsigned count = 0;
+	void (*isr)() = NULL;
+	bool pending = false;
+};
+
+/* Interval timer, fired by host_pump() once no transfer is pending */
+class IntervalTimer {
+public:
+	IntervalTimer() { list().push_back(this); }
+	bool begin(void (*function)(), unsigned us) {
+		callback = function;
+		period = us;
+		active = true;
+		host_pump();
+		return true;
+	}
+	void end() { active = false; }
+
+	/* Let the period pass and call the function, returns false if not active */
+	bool run() {
+		if (!active)
+			return false;
+		host_skip(period);
+		callback();
+		return true;
+	}
+
+	static std::vector<IntervalTimer*>& list() {
+		static std::vector<IntervalTimer*> timers;
+		return timers;
+	}
+
+private:
+	void (*callback)() = NULL;
+	unsigned period = 0;
+	bool active = false;
+};
+
+/* Deliver all pending transfers and timer events like the interrupts would */
+void host_pump() {
+	if (host_pumping)
+		return;
+	host_pumping = true;
+
+	uint32_t events = 0;
+	bool busy = true;
+	while (busy) {
+		busy = false;
+		//Transfers first, they complete within microseconds
+		for (DMAChannel* channel : DMAChannel::list())
+			busy |= channel->run();
+		if (busy) {
+			events++;
+		}
+		//Then the timers
+		else {
+			for (IntervalTimer* timer : IntervalTimer::list()) {
+				if (timer->run()) {
+					busy = true;
+					events++;
+					break;
+				}
+			}
+		}
+		//A periodic timer that is never stopped
+		if (events > host_pumpLimit) {
+			fprintf(stderr, "host_pump: no end of the interrupts\n");
+			abort();
+		}
+	}
+	host_pumping = false;
+}
+
+/* Arduino string, only what the firmware uses */
+class String {
+public:
+	String(const char* str = "") : s(str) {}
+	String(const std::string& str) : s(str) {}
+	String(char c) : s(1, c) {}
+	String(int value, int base = DEC) { char buf[34]; s = itoa(value, buf, base); }
+	String(unsigned int value, int base = DEC) { char buf[34]; s = ultoa(value, buf, base); }
+	String(long value, int base = DEC) { char buf[34]; s = ltoa(value, buf, base); }
+	String(unsigned long value, int base = DEC) { char buf[34]; s = ultoa(value, buf, base); }
+	String(float value, int decimals = 2) { char buf[32]; s = dtostrf(value, 1, decimals, buf); }
+	String(double value, int decimals = 2) { char buf[32]; s = dtostrf(value, 1, decimals, buf); }
+	const char* c_str() const { return s.c_str(); }
+	unsigned int length() const { return s.length(); }
+	char operator[](unsigned int index) const { return (index < s.length()) ? s[index] : 0; }
+	char charAt(unsigned int index) const { return (*this)[index]; }
+	String substring(unsigned int from) const { return (from < s.length()) ? s.substr(from) : ""; }
+	String substring(unsigned int from, unsigned int to) const {
+		if (from > to) { unsigned int t = from; from = to; to = t; }
+		return (from < s.length()) ? s.substr(from, to - from) : "";
+	}
+	void toCharArray(char* buf, unsigned int size) const {
+		if (size == 0)
+			return;
+		strncpy(buf, s.c_str(), size - 1);
+		buf[size - 1] = '\0';
+	}
+	long toInt() const { return atol(s.c_str()); }
+	float toFloat() const { return atof(s.c_str()); }
+	String& operator+=(const String& other) { s += other.s; return *this; }
+	friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+	bool operator==(const String& other) const { return s == other.s; }
+	bool operator!=(const String& other) const { return s != other.s; }
+	bool operator<(const String& other) const { return s < other.s; }
+	bool operator>(const String& other) const { return s > other.s; }
+	bool operator<=(const String& other) const { return s <= other.s; }
+	bool operator>=(const String& other) const { return s >= other.s; }
+
+private:
+	std::string s;
+};
+
+/* Stream with a receive queue and a log of the transmitted bytes */
+class Stream {
+public:
+	//Received bytes not yet read and all bytes written
+	std::deque<uint8_t> rx;
+	std::vector<uint8_t> tx;
+	//Device on the other end, called with every write
+	void (*peer)(Stream* stream, const uint8_t* data, size_t len) = NULL;
+
+	virtual int available() { return rx.size(); }
+	virtual int read() {
+		if (rx.empty())
+			return -1;
+		uint8_t value = rx.front();
+		rx.pop_front();
+		return value;
+	}
+	virtual int peek() { return rx.empty() ? -1 : rx.front(); }
+	virtual size_t write(uint8_t value) { return write(&value, 1); }
+	virtual size_t write(const uint8_t* data, size_t len) {
+		tx.insert(tx.end(), data, data + len);
+		if (peer != NULL)
+			peer(this, data, len);
+		return len;
+	}
+	size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+	size_t write(const char* data, size_t len) { return write((const uint8_t*)data, len); }
+	size_t write(int value) { return write((uint8_t)value); }
+	size_t write(unsigned int value) { return write((uint8_t)value); }
+	size_t write(long value) { return write((uint8_t)value); }
+	size_t write(unsigned long value) { return write((uint8_t)value); }
+	virtual void flush() {}
+	void setTimeout(unsigned long ms) { timeout = ms; }
+
+	/* Read with the timeout, which passes at once when nothing arrives */
+	size_t readBytes(uint8_t* buffer, size_t len) {
+		size_t count = 0;
+		while (count < len) {
+			int value = read();
+			if (value < 0) {
+				host_pump();
+				value = read();
+			}
+			if (value < 0) {
+				host_skip((uint64_t)timeout * 1000);
+				break;
+			}
+			buffer[count++] = value;
+		}
+		return count;
+	}
+	size_t readBytes(char* buffer, size_t len) { return readBytes((uint8_t*)buffer, len); }
+	String readString() {
+		std::string str;
+		int value;
+		while ((value = read()) >= 0)
+			str += (char)value;
+		return String(str);
+	}
+	String readStringUntil(char end) {
+		std::string str;
+		int value;
+		while (((value = read()) >= 0) && (value != end))
+			str += (char)value;
+		return String(str);
+	}
+
+	/* Queue bytes as if they had been received */
+	void receive(const uint8_t* data, size_t len) { rx.insert(rx.end(), data, data + len); }
+
+	size_t print(const char* str) { return write(str); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(const String& str) { return write(str.c_str()); }
+	size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+	size_t print(int value, int base = DEC) { return print((long)value, base); }
+	size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+	//The BYTE format of the Teensy core writes the value itself
+	size_t print(long value, int base = DEC) { char buf[34]; return (base == BYTE) ? write((uint8_t)value) : write(ltoa(value, buf, base)); }
+	size_t print(unsigned long value, int base = DEC) { char buf[34]; return (base == BYTE) ? write((uint8_t)value) : write(ultoa(value, buf, base)); }
+	size_t print(double value, int digits = 2) { char buf[48]; return write(dtostrf(value, 1, digits, buf)); }
+	size_t println() { return write("\r\n"); }
+	template <class T> size_t println(T value) { size_t n = print(value); return n + println(); }
+	template <class T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+
+protected:
+	unsigned long timeout = 1000;
+};
+
+/* USB serial */
+class usb_serial_class : public Stream {
+public:
+	void begin(long baud) {}
+	void end() {}
+	void clear() { rx.clear(); }
+	void send_now() {}
+	int availableForWrite() { return 64; }
+	operator bool() { return true; }
+};
+
+/* Hardware serial */
+class HardwareSerial : public Stream {
+public:
+	long baud = 0;
+	void begin(long rate) { baud = rate; }
+	void end() {}
+	void clear() { rx.clear(); }
+};
+
+usb_serial_class Serial;
+HardwareSerial Serial1;
+
+/* Realtime clock */
+class Teensy3Clock_t {
+public:
+	unsigned long value = 1483228800;
+	unsigned long get() { return value; }
+	void set(unsigned long time) { value = time; }
+};
+Teensy3Clock_t Teensy3Clock;
+
+/* Milliseconds since the last assignment */
+class elapsedMillis {
+public:
+	elapsedMillis() : ms(millis()) {}
+	operator unsigned long() const { return millis() - ms; }
+	elapsedMillis& operator=(unsigned long value) { ms = millis() - value; return *this; }
+
+private:
+	unsigned long ms;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+*
+* ADC - ADC library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_ADC_H
+#define HOST_ADC_H
+
+#include "Arduino.h"
+
+/* Defines */
+
+#define ADC_0 0
+#define ADC_1 1
+#define ADC_LOW_SPEED 0
+#define ADC_MED_SPEED 1
+#define ADC_HIGH_SPEED 2
+
+/* Both ADCs, the values come from host_analog */
+class ADC {
+public:
+	int analogRead(uint8_t pin, int adc = ADC_0) { return host_analog[pin]; }
+	int getMaxValue(int adc = ADC_0) { return (1 << resolution) - 1; }
+	void setAveraging(int num, int adc = ADC_0) {}
+	void setResolution(int bits, int adc = ADC_0) { resolution = bits; }
+	void setConversionSpeed(int speed, int adc = ADC_0) {}
+	void setSamplingSpeed(int speed, int adc = ADC_0) {}
+
+private:
+	int resolution = 10;
+};
+
+#endif
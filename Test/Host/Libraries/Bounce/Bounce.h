@@ -0,0 +1,42 @@
+/*
+*
+* BOUNCE - Bounce library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_BOUNCE_H
+#define HOST_BOUNCE_H
+
+#include "Arduino.h"
+
+/* Pin without bouncing, reports the level of host_pins */
+class Bounce {
+public:
+	Bounce(uint8_t pin, unsigned long interval) : pin(pin), state(host_pins[pin]) {}
+	void interval(unsigned long interval) {}
+	int read() { return state; }
+	int update() {
+		uint8_t level = digitalRead(pin);
+		changed = (level != state);
+		state = level;
+		return changed;
+	}
+	bool risingEdge() { return changed && state; }
+	bool fallingEdge() { return changed && !state; }
+
+private:
+	uint8_t pin;
+	uint8_t state;
+	bool changed = false;
+};
+
+#endif
@@ -0,0 +1,40 @@
+/*
+*
+* EEPROM - EEPROM library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include "Arduino.h"
+
+/* EEPROM, stored in host_eeprom */
+class EEPROMClass {
+public:
+	uint8_t read(int address) { return host_eeprom[address & 4095]; }
+	void write(int address, uint8_t value) { host_eeprom[address & 4095] = value; }
+	void update(int address, uint8_t value) { write(address, value); }
+	uint16_t length() { return sizeof(host_eeprom); }
+	template <class T> T& get(int address, T& value) {
+		memcpy(&value, &host_eeprom[address], sizeof(T));
+		return value;
+	}
+	template <class T> const T& put(int address, const T& value) {
+		memcpy(&host_eeprom[address], &value, sizeof(T));
+		return value;
+	}
+};
+
+EEPROMClass EEPROM;
+
+#endif
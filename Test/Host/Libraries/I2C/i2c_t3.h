@@ -0,0 +1,107 @@
+/*
+*
+* I2C_T3 - I2C library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_I2C_T3_H
+#define HOST_I2C_T3_H
+
+#include "Arduino.h"
+
+/* Defines */
+
+#define I2C_MASTER 0
+#define I2C_SLAVE 1
+#define I2C_PINS_16_17 0
+#define I2C_PINS_18_19 1
+#define I2C_PULLUP_EXT 0
+#define I2C_PULLUP_INT 1
+#define I2C_RATE_100 0
+#define I2C_RATE_400 1
+#define I2C_RATE_1000 2
+#define I2C_OP_MODE_ISR 0
+#define I2C_OP_MODE_DMA 1
+#define I2C_NOSTOP 0
+#define I2C_STOP 1
+//Bus status
+#define I2C_WAITING 0
+#define I2C_ADDR_NAK 5
+
+/* Variables */
+
+//I2C device, gets the written bytes and returns false for a missing acknowledge
+bool (*host_i2cWrite)(uint8_t address, const uint8_t* data, size_t len) = NULL;
+//I2C device, fills the requested bytes and returns how many it has sent
+size_t (*host_i2cRead)(uint8_t address, uint8_t* data, size_t len) = NULL;
+
+/* Methods */
+
+/* I2C bus, every transfer is done at once */
+class i2c_t3 : public Stream {
+public:
+	i2c_t3(int bus = 0) {}
+	void begin() {}
+	void begin(int mode, int address, int pins, int pullup, uint32_t rate) {}
+	void setDefaultTimeout(uint32_t us) {}
+	void pinConfigure(int pins, int pullup) {}
+	void setRate(int rate) {}
+	void setOpMode(int mode) {}
+	void resetBus() { busStatus = I2C_WAITING; }
+
+	void beginTransmission(uint8_t address) {
+		txAddress = address;
+		txData.clear();
+	}
+	size_t write(uint8_t data) {
+		txData.push_back(data);
+		return 1;
+	}
+	size_t write(const uint8_t* data, size_t len) {
+		txData.insert(txData.end(), data, data + len);
+		return len;
+	}
+	uint8_t send(uint8_t data) { return write(data); }
+	//Error codes like the Wire library, 2 for a missing acknowledge of the address
+	uint8_t endTransmission(int stop = I2C_STOP) {
+		bool ack = (host_i2cWrite != NULL) && host_i2cWrite(txAddress, txData.data(), txData.size());
+		txData.clear();
+		busStatus = ack ? I2C_WAITING : I2C_ADDR_NAK;
+		return ack ? 0 : 2;
+	}
+	void sendTransmission(int stop = I2C_STOP) { endTransmission(stop); }
+	uint8_t requestFrom(int address, int len, int stop = I2C_STOP) {
+		rx.clear();
+		uint8_t data[256];
+		size_t count = 0;
+		if (host_i2cRead != NULL)
+			count = host_i2cRead(address, data, min(len, 256));
+		Stream::receive(data, count);
+		busStatus = (count > 0) ? I2C_WAITING : I2C_ADDR_NAK;
+		return count;
+	}
+	void sendRequest(uint8_t address, size_t len, int stop = I2C_STOP) { requestFrom(address, len, stop); }
+	uint8_t receive() { return read(); }
+	bool done() { return true; }
+	bool finish(uint32_t timeout = 0) { return true; }
+	uint8_t status() { return busStatus; }
+	uint8_t getError() { return busStatus; }
+
+private:
+	uint8_t txAddress = 0;
+	std::vector<uint8_t> txData;
+	uint8_t busStatus = I2C_WAITING;
+};
+
+i2c_t3 Wire;
+
+#endif
@@ -0,0 +1,41 @@
+/*
+*
+* METRO - Metro library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_METRO_H
+#define HOST_METRO_H
+
+#include "Arduino.h"
+
+/* Interval check on millis() */
+class Metro {
+public:
+	Metro(unsigned long interval = 1000) : period(interval), previous(millis()) {}
+	void begin(unsigned long interval, bool autoreset = false) { period = interval; reset(); }
+	void interval(unsigned long interval) { period = interval; }
+	void reset() { previous = millis(); }
+	bool check() {
+		if ((millis() - previous) >= period) {
+			previous = millis();
+			return true;
+		}
+		return false;
+	}
+
+private:
+	unsigned long period;
+	unsigned long previous;
+};
+
+#endif
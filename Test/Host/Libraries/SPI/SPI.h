@@ -0,0 +1,62 @@
+/*
+*
+* SPI - SPI library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include "Arduino.h"
+
+/* Bus settings, only kept for the device models */
+class SPISettings {
+public:
+	SPISettings() {}
+	SPISettings(uint32_t clock, uint8_t order, uint8_t mode) : clock(clock), mode(mode) {}
+	uint32_t clock = 4000000;
+	uint8_t mode = SPI_MODE0;
+};
+
+/* SPI bus, the transfers go to host_spiDevice */
+class SPIClass {
+public:
+	SPISettings settings;
+
+	void begin() {}
+	void end() {}
+	void beginTransaction(SPISettings value) { settings = value; }
+	void endTransaction() {}
+	void usingInterrupt(uint8_t irq) {}
+	void setMOSI(uint8_t pin) {}
+	void setMISO(uint8_t pin) {}
+	void setSCK(uint8_t pin) {}
+	void setClockDivider(uint8_t divider) {}
+	bool pinIsChipSelect(uint8_t pin) { return true; }
+	bool pinIsChipSelect(uint8_t pin1, uint8_t pin2) { return true; }
+	uint8_t setCS(uint8_t pin) { return 1; }
+
+	uint8_t transfer(uint8_t data) {
+		host_spiTransfer(&data, 1);
+		return data;
+	}
+	uint16_t transfer16(uint16_t data) {
+		uint8_t buf[2] = { (uint8_t)(data >> 8), (uint8_t)data };
+		host_spiTransfer(buf, 2);
+		return (buf[0] << 8) | buf[1];
+	}
+	void transfer(void* buf, size_t count) { host_spiTransfer((uint8_t*)buf, count); }
+};
+
+SPIClass SPI;
+
+#endif
@@ -0,0 +1,434 @@
+/*
+*
+* SDFAT - SdFat library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_SDFAT_H
+#define HOST_SDFAT_H
+
+#include "Arduino.h"
+
+/* Defines */
+
+#define SPI_FULL_SPEED 2
+#define SPI_HALF_SPEED 4
+#define O_READ 0x01
+#define O_RDONLY O_READ
+#define O_WRITE 0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_AT_END 0x08
+#define O_SYNC 0x08
+#define O_TRUNC 0x10
+#define O_CREAT 0x20
+#define O_EXCL 0x40
+#define FILE_READ O_READ
+#define FILE_WRITE (O_RDWR | O_CREAT | O_AT_END)
+#define FAT_DATE(year, month, day) (((year) - 1980) << 9 | (month) << 5 | (day))
+#define FAT_TIME(hour, minute, second) ((hour) << 11 | (minute) << 5 | (second) >> 1)
+#define BOOTSIG0 0x55
+#define BOOTSIG1 0xAA
+#define EXTENDED_BOOT_SIG 0x29
+#define FSINFO_LEAD_SIG 0x41615252
+#define FSINFO_STRUCT_SIG 0x61417272
+
+/* Structures of the FAT file system, used to format the card */
+
+struct dir_t {
+	uint8_t name[11];
+	uint8_t attributes;
+	uint8_t reservedNT;
+	uint8_t creationTimeTenths;
+	uint16_t creationTime;
+	uint16_t creationDate;
+	uint16_t lastAccessDate;
+	uint16_t firstClusterHigh;
+	uint16_t lastWriteTime;
+	uint16_t lastWriteDate;
+	uint16_t firstClusterLow;
+	uint32_t fileSize;
+} __attribute__((packed));
+
+struct part_t {
+	uint8_t boot;
+	uint8_t beginHead;
+	unsigned beginSector : 6;
+	unsigned beginCylinderHigh : 2;
+	uint8_t beginCylinderLow;
+	uint8_t type;
+	uint8_t endHead;
+	unsigned endSector : 6;
+	unsigned endCylinderHigh : 2;
+	uint8_t endCylinderLow;
+	uint32_t firstSector;
+	uint32_t totalSectors;
+} __attribute__((packed));
+
+struct mbr_t {
+	uint8_t codeArea[440];
+	uint32_t diskSignature;
+	uint16_t usuallyZero;
+	part_t part[4];
+	uint8_t mbrSig0;
+	uint8_t mbrSig1;
+} __attribute__((packed));
+
+struct fat_boot_t {
+	uint8_t jump[3];
+	char oemId[8];
+	uint16_t bytesPerSector;
+	uint8_t sectorsPerCluster;
+	uint16_t reservedSectorCount;
+	uint8_t fatCount;
+	uint16_t rootDirEntryCount;
+	uint16_t totalSectors16;
+	uint8_t mediaType;
+	uint16_t sectorsPerFat16;
+	uint16_t sectorsPerTrack;
+	uint16_t headCount;
+	uint32_t hidddenSectors;
+	uint32_t totalSectors32;
+	uint8_t driveNumber;
+	uint8_t reserved1;
+	uint8_t bootSignature;
+	uint32_t volumeSerialNumber;
+	char volumeLabel[11];
+	char fileSystemType[8];
+	uint8_t bootCode[448];
+	uint8_t bootSectorSig0;
+	uint8_t bootSectorSig1;
+} __attribute__((packed));
+
+struct fat32_boot_t {
+	uint8_t jump[3];
+	char oemId[8];
+	uint16_t bytesPerSector;
+	uint8_t sectorsPerCluster;
+	uint16_t reservedSectorCount;
+	uint8_t fatCount;
+	uint16_t rootDirEntryCount;
+	uint16_t totalSectors16;
+	uint8_t mediaType;
+	uint16_t sectorsPerFat16;
+	uint16_t sectorsPerTrack;
+	uint16_t headCount;
+	uint32_t hidddenSectors;
+	uint32_t totalSectors32;
+	uint32_t sectorsPerFat32;
+	uint16_t fat32Flags;
+	uint16_t fat32Version;
+	uint32_t fat32RootCluster;
+	uint16_t fat32FSInfo;
+	uint16_t fat32BackBootBlock;
+	uint8_t fat32Reserved[12];
+	uint8_t driveNumber;
+	uint8_t reserved1;
+	uint8_t bootSignature;
+	uint32_t volumeSerialNumber;
+	char volumeLabel[11];
+	char fileSystemType[8];
+	uint8_t bootCode[420];
+	uint8_t bootSectorSig0;
+	uint8_t bootSectorSig1;
+} __attribute__((packed));
+
+struct fat32_fsinfo_t {
+	uint32_t leadSignature;
+	uint8_t reserved1[480];
+	uint32_t structSignature;
+	uint32_t freeCount;
+	uint32_t nextFree;
+	uint8_t reserved2[12];
+	uint8_t tailSignature[4];
+} __attribute__((packed));
+
+union cache_t {
+	uint8_t data[512];
+	uint16_t fat16[256];
+	uint32_t fat32[128];
+	dir_t dir[16];
+	mbr_t mbr;
+	fat_boot_t fbs;
+	fat32_boot_t fbs32;
+	fat32_fsinfo_t fsinfo;
+};
+
+/* Variables */
+
+//Files and directories of the card, by absolute path
+std::map<std::string, std::vector<uint8_t>> host_sdFiles;
+std::map<std::string, bool> host_sdDirs = { { "/", true } };
+//Creation order of all entries, listed like on a FAT card
+std::vector<std::string> host_sdOrder;
+//Current directory
+std::string host_sdCwd = "/";
+//A card is inserted
+bool host_sdPresent = true;
+//Number of write calls, lets the tests count the SD transfers
+uint32_t host_sdWrites = 0;
+
+/* Methods */
+
+/* Absolute path of a name in the current directory */
+inline std::string host_sdPath(const char* name) {
+	std::string path = (name[0] == '/') ? std::string(name) : host_sdCwd + "/" + name;
+	//Remove double and trailing slashes
+	std::string clean;
+	for (char c : path) {
+		if ((c == '/') && (!clean.empty()) && (clean.back() == '/'))
+			continue;
+		clean += c;
+	}
+	if ((clean.size() > 1) && (clean.back() == '/'))
+		clean.pop_back();
+	return clean;
+}
+
+/* Directory of an absolute path */
+inline std::string host_sdParent(const std::string& path) {
+	size_t pos = path.rfind('/');
+	return (pos == 0) ? "/" : path.substr(0, pos);
+}
+
+/* Remove all stored files and directories */
+inline void host_sdClear() {
+	host_sdFiles.clear();
+	host_sdDirs = { { "/", true } };
+	host_sdOrder.clear();
+	host_sdCwd = "/";
+}
+
+/* Raw card access, only used to format the card */
+class SdSpiCard {
+public:
+	uint32_t cardSize() { return host_sdPresent ? 7744512 : 0; }
+	uint8_t type() { return 3; }
+	bool readBlock(uint32_t block, uint8_t* data) { memset(data, 0, 512); return true; }
+	bool writeBlock(uint32_t block, const uint8_t* data) { return true; }
+	bool writeStart(uint32_t block, uint32_t count) { return true; }
+	bool writeData(const uint8_t* data) { return true; }
+	bool writeStop() { return true; }
+	bool erase(uint32_t first, uint32_t last) { return true; }
+};
+
+/* Volume information */
+class FatVolume {
+public:
+	uint32_t freeClusterCount() { return 241000; }
+	uint8_t blocksPerCluster() { return 64; }
+	uint32_t clusterCount() { return 242000; }
+	uint8_t fatType() { return 32; }
+};
+
+/* File or directory on the card */
+class SdFile : public Stream {
+public:
+	/* Open a file or directory by name in the current directory */
+	bool open(const char* name, uint8_t flags = O_READ) {
+		close();
+		return openPath(host_sdPath(name), flags);
+	}
+	bool open(SdFile* dir, const char* name, uint8_t flags) {
+		close();
+		return openPath(host_sdPath((dir->path + "/" + name).c_str()), flags);
+	}
+
+	/* Open the next entry of a directory */
+	bool openNext(SdFile* dir, uint8_t flags = O_READ) {
+		close();
+		while (dir->next < host_sdOrder.size()) {
+			std::string entry = host_sdOrder[dir->next++];
+			if ((host_sdParent(entry) == dir->path) && (entry != "/") && openPath(entry, flags))
+				return true;
+		}
+		return false;
+	}
+
+	bool close() {
+		opened = false;
+		directory = false;
+		return true;
+	}
+	bool isOpen() { return opened; }
+	bool isFile() { return opened && !directory; }
+	bool isDir() { return opened && directory; }
+	operator bool() { return opened; }
+
+	bool getName(char* name, size_t size) {
+		if ((!opened) || (size == 0))
+			return false;
+		std::string base = path.substr(path.rfind('/') + 1);
+		strncpy(name, base.c_str(), size - 1);
+		name[size - 1] = '\0';
+		return true;
+	}
+
+	uint32_t fileSize() { return isFile() ? data().size() : 0; }
+	uint32_t curPosition() { return pos; }
+	bool seekSet(uint32_t position) {
+		if ((!isFile()) || (position > data().size()))
+			return false;
+		pos = position;
+		return true;
+	}
+	bool seekCur(int32_t offset) { return seekSet(pos + offset); }
+	bool seekEnd(int32_t offset = 0) { return seekSet(fileSize() + offset); }
+
+	int available() { return isFile() ? (fileSize() - pos) : 0; }
+	int peek() { return (available() > 0) ? data()[pos] : -1; }
+	int read() { return (available() > 0) ? data()[pos++] : -1; }
+	int read(void* buf, size_t len) {
+		if (!isFile())
+			return -1;
+		size_t count = min(len, (size_t)available());
+		memcpy(buf, data().data() + pos, count);
+		pos += count;
+		return count;
+	}
+
+	size_t write(uint8_t value) { return write(&value, 1); }
+	size_t write(const uint8_t* buf, size_t len) {
+		if ((!isFile()) || (!(flags & O_WRITE)))
+			return 0;
+		std::vector<uint8_t>& file = data();
+		if (flags & O_APPEND)
+			pos = file.size();
+		if ((pos + len) > file.size())
+			file.resize(pos + len);
+		memcpy(file.data() + pos, buf, len);
+		pos += len;
+		host_sdWrites++;
+		return len;
+	}
+	size_t write(const void* buf, size_t len) { return write((const uint8_t*)buf, len); }
+	size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+
+	bool sync() { return opened; }
+	bool truncate(uint32_t length) {
+		if ((!isFile()) || (length > fileSize()))
+			return false;
+		data().resize(length);
+		if (pos > length)
+			pos = length;
+		return true;
+	}
+	bool remove() {
+		if (!isFile())
+			return false;
+		host_sdFiles.erase(path);
+		close();
+		return true;
+	}
+	bool timestamp(uint8_t flags, uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) { return opened; }
+	bool preAllocate(uint32_t length) { return isFile(); }
+	static void dateTimeCallback(void (*callback)(uint16_t* date, uint16_t* time)) {}
+
+	//Absolute path of the opened entry
+	std::string path = "/";
+	//Position of the next entry for openNext()
+	size_t next = 0;
+
+private:
+	bool openPath(const std::string& name, uint8_t mode) {
+		//Directory
+		if (host_sdDirs.count(name)) {
+			path = name;
+			opened = true;
+			directory = true;
+			next = 0;
+			return true;
+		}
+		//Create the file if the directory exists
+		if (!host_sdFiles.count(name)) {
+			if ((!(mode & O_CREAT)) || (!host_sdDirs.count(host_sdParent(name))))
+				return false;
+			host_sdFiles[name];
+			host_sdOrder.push_back(name);
+		}
+		else if ((mode & O_CREAT) && (mode & O_EXCL))
+			return false;
+		path = name;
+		flags = mode;
+		opened = true;
+		directory = false;
+		if (mode & O_TRUNC)
+			data().clear();
+		pos = (mode & O_AT_END) ? data().size() : 0;
+		return true;
+	}
+	std::vector<uint8_t>& data() { return host_sdFiles[path]; }
+
+	bool opened = false;
+	bool directory = false;
+	uint8_t flags = 0;
+	uint32_t pos = 0;
+};
+
+/* Card with the file system */
+class SdFat {
+public:
+	bool begin(uint8_t csPin = 0, uint8_t divisor = SPI_FULL_SPEED) { return host_sdPresent; }
+	bool chdir(bool set_cwd = false) { return chdir("/"); }
+	bool chdir(const char* name, bool set_cwd = false) {
+		std::string path = host_sdPath(name);
+		if (!host_sdDirs.count(path))
+			return false;
+		host_sdCwd = path;
+		cwd.path = path;
+		cwd.next = 0;
+		return true;
+	}
+	bool exists(const char* name) {
+		std::string path = host_sdPath(name);
+		return host_sdFiles.count(path) || host_sdDirs.count(path);
+	}
+	bool remove(const char* name) { return host_sdFiles.erase(host_sdPath(name)) > 0; }
+	bool mkdir(const char* name, bool pFlag = true) {
+		std::string path = host_sdPath(name);
+		if (exists(name) || (!host_sdDirs.count(host_sdParent(path))))
+			return false;
+		host_sdDirs[path] = true;
+		host_sdOrder.push_back(path);
+		return true;
+	}
+	bool rmdir(const char* name) {
+		std::string path = host_sdPath(name);
+		for (auto& file : host_sdFiles)
+			if (host_sdParent(file.first) == path)
+				return false;
+		return host_sdDirs.erase(path) > 0;
+	}
+	bool rename(const char* oldName, const char* newName) {
+		std::string from = host_sdPath(oldName);
+		if (!host_sdFiles.count(from))
+			return false;
+		std::string to = host_sdPath(newName);
+		host_sdFiles[to] = host_sdFiles[from];
+		host_sdFiles.erase(from);
+		for (std::string& entry : host_sdOrder)
+			if (entry == from)
+				entry = to;
+		return true;
+	}
+	SdFile* vwd() { return &cwd; }
+	FatVolume* vol() { return &volume; }
+	SdSpiCard* card() { return &spiCard; }
+
+private:
+	SdFile cwd;
+	FatVolume volume;
+	SdSpiCard spiCard;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+*
+* TIME - Time library stand-in for the host build
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+#ifndef HOST_TIME_H
+#define HOST_TIME_H
+
+#include <time.h>
+#include "Arduino.h"
+
+/* Defines */
+
+#define timeNotSet 0
+#define timeNeedsSync 1
+#define timeSet 2
+
+/* Variables */
+
+//System time at millis() zero
+time_t host_timeBase = 0;
+bool host_timeSet = false;
+
+/* Methods */
+
+inline time_t now() { return host_timeBase + (millis() / 1000); }
+inline void setTime(time_t value) {
+	host_timeBase = value - (millis() / 1000);
+	host_timeSet = true;
+}
+inline void setTime(int hr, int min, int sec, int day, int month, int yr) {
+	struct tm parts = {};
+	parts.tm_year = yr - 1900;
+	parts.tm_mon = month - 1;
+	parts.tm_mday = day;
+	parts.tm_hour = hr;
+	parts.tm_min = min;
+	parts.tm_sec = sec;
+	setTime(timegm(&parts));
+}
+inline void setSyncProvider(time_t (*provider)()) { setTime(provider()); }
+inline int timeStatus() { return host_timeSet ? timeSet : timeNotSet; }
+
+/* Calendar parts of a time */
+inline struct tm host_breakTime(time_t value) {
+	struct tm parts;
+	gmtime_r(&value, &parts);
+	return parts;
+}
+inline int second(time_t t) { return host_breakTime(t).tm_sec; }
+inline int minute(time_t t) { return host_breakTime(t).tm_min; }
+inline int hour(time_t t) { return host_breakTime(t).tm_hour; }
+inline int day(time_t t) { return host_breakTime(t).tm_mday; }
+inline int weekday(time_t t) { return host_breakTime(t).tm_wday + 1; }
+inline int month(time_t t) { return host_breakTime(t).tm_mon + 1; }
+inline int year(time_t t) { return host_breakTime(t).tm_year + 1900; }
+inline int second() { return second(now()); }
+inline int minute() { return minute(now()); }
+inline int hour() { return hour(now()); }
+inline int day() { return day(now()); }
+inline int weekday() { return weekday(now()); }
+inline int month() { return month(now()); }
+inline int year() { return year(now()); }
+
+#endif
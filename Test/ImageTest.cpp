@@ -0,0 +1,324 @@
+/*
+*
+* IMAGETEST - Upscaling and colorization of the thermal image
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Methods */
+
+/* Fill the small buffer with a gradient and steps in both directions, set the limits to it */
+void fillPattern() {
+	for (uint16_t y = 0; y < rawHeight; y++)
+		for (uint16_t x = 0; x < rawWidth; x++)
+			smallBuffer[(y * rawWidth) + x] = 7800 + (x * 960 / rawWidth) + (y * 960 / rawHeight) +
+				((x >= (rawWidth / 3)) ? 800 : 0) + ((y >= (rawHeight / 3)) ? 1200 : 0);
+	calcFrameStats();
+	limitValues();
+}
+
+/* Largest difference of the red, green and blue channel */
+uint16_t colorDiff(uint16_t first, uint16_t second) {
+	uint16_t red = abs((first >> 11) - (second >> 11));
+	uint16_t green = abs(((first >> 5) & 0x3F) - ((second >> 5) & 0x3F));
+	uint16_t blue = abs((first & 0x1F) - (second & 0x1F));
+	return max(max(red, green), blue);
+}
+
+/* Both upscaler orders give the same image with a linear color scheme */
+void checkUpscaler(byte lepton) {
+	static uint16_t values[76800];
+	test_initFirmware(lepton);
+	hqRes = true;
+	colorScheme = colorScheme_grayscale;
+	selectColorScheme();
+	fillPattern();
+
+	//Interpolate the raw values, then colorize
+	upscaleColored = false;
+	initUpscaleTables();
+	upscaleValues(false);
+	convertColors();
+	memcpy(values, bigBuffer, sizeof(values));
+
+	//Colorize, then interpolate the colors
+	smallToBigBuffer();
+	convertColors();
+
+	//Pixels on the raw positions are not interpolated
+	uint16_t exact = 0;
+	for (byte i = 0; i < 240; i++)
+		for (uint16_t j = 0; j < 320; j++)
+			if ((upscaleWeightY[i] == 0) && (upscaleWeightX[j] == 0) &&
+				(bigBuffer[(i * 320) + j] != colorLUTLookup(smallBuffer[(upscaleY[i] * rawWidth) + upscaleX[j]])))
+				exact++;
+	checkEqual(exact, 0);
+	uint16_t worst = 0;
+	for (uint32_t i = 0; i < 76800; i++)
+		worst = max(worst, colorDiff(bigBuffer[i], values[i]));
+	check(worst <= 1);
+}
+
+/* Lepton3 at 160x120 */
+void testUpscaler160x120() {
+	checkUpscaler(leptonVersion_3_shutter);
+}
+
+/* Lepton2 at 80x60 */
+void testUpscaler80x60() {
+	checkUpscaler(leptonVersion_2_shutter);
+}
+
+/* Local equalization of the live image, the raw values are kept for saving */
+void checkLocal(byte lepton) {
+	static uint16_t raw[19200];
+	test_initFirmware(lepton);
+	hqRes = true;
+	filterType = filterType_none;
+	agcMode = agcMode_local;
+	uint16_t count = rawWidth * rawHeight;
+
+	//The first frame collects the tile histograms, the second one uses them
+	for (byte i = 0; i < 2; i++) {
+		fillPattern();
+		memcpy(raw, smallBuffer, count * 2);
+		filterImage(true);
+		check(memcmp(raw, smallBuffer, count * 2) == 0);
+	}
+	check(agcLocalApply);
+
+	//Both upscaler orders take the equalized values at the raw positions
+	static uint16_t local[160];
+	initUpscaleTables();
+	for (byte order = 0; order < 2; order++) {
+		upscaleColored = false;
+		if (order == upscale_values) {
+			upscaleValues(false);
+			convertColors();
+		}
+		else
+			upscaleColors(false);
+		uint16_t wrong = 0;
+		for (byte i = 0; i < 240; i++) {
+			agcLocalLine(&smallBuffer[upscaleY[i] * rawWidth], upscaleY[i], local);
+			for (uint16_t j = 0; j < 320; j++)
+				if ((upscaleWeightY[i] == 0) && (upscaleWeightX[j] == 0) &&
+					(colorDiff(bigBuffer[(i * 320) + j], colorLUTLookup(local[upscaleX[j]])) > 1))
+					wrong++;
+		}
+		checkEqual(wrong, 0);
+	}
+	check(memcmp(raw, smallBuffer, count * 2) == 0);
+
+	//Colors of the small buffer differ from the linear ones
+	convertColors(true);
+	uint16_t changed = 0;
+	for (uint16_t i = 0; i < 19200; i++) {
+		uint16_t pos = (lepton == leptonVersion_3_shutter) ? i : ((((i / 160) / 2) * 80) + ((i % 160) / 2));
+		if (smallBuffer[i] != colorLUTLookup(raw[pos]))
+			changed++;
+	}
+	check(changed > 0);
+
+	//Loaded, converted and sent frames are colorized without the maps of the live image
+	memcpy(smallBuffer, raw, count * 2);
+	filterImage();
+	check(!agcLocalApply);
+	convertColors(true);
+	uint16_t linear = 0;
+	for (uint16_t i = 0; i < 19200; i++) {
+		uint16_t pos = (lepton == leptonVersion_3_shutter) ? i : ((((i / 160) / 2) * 80) + ((i % 160) / 2));
+		if (smallBuffer[i] != colorLUTLookup(raw[pos]))
+			linear++;
+	}
+	checkEqual(linear, 0);
+}
+
+/* Lepton3 at 160x120 */
+void testLocal160x120() {
+	checkLocal(leptonVersion_3_shutter);
+}
+
+/* Lepton2 at 80x60 */
+void testLocal80x60() {
+	checkLocal(leptonVersion_2_shutter);
+}
+
+/* The global map settles for a static scene and keeps the color table */
+void testEqualizeStatic() {
+	test_initFirmware(leptonVersion_3_shutter);
+	agcMode = agcMode_equalize;
+	for (byte i = 0; i < 30; i++) {
+		fillPattern();
+		updateColorLUT();
+	}
+	uint16_t version = agcMapVersion;
+	for (byte i = 0; i < 10; i++) {
+		fillPattern();
+		updateColorLUT();
+	}
+	checkEqual(agcMapVersion, version);
+	check(colorLUTEqualize);
+	check(colorLUTAgcVersion == version);
+
+	//Color bar labels are placed at the first value of their level
+	for (byte i = 1; i < 3; i++) {
+		uint32_t level = (65535 * i) / 3;
+		uint16_t value = agcLevelValue(level);
+		check((value > minValue) && (value < maxValue));
+		check(agcLevel(value) >= level);
+		check(agcLevel(value - 1) < level);
+	}
+}
+
+/* Resize and shift of the visual image before the remap tables, the buffer was white before the decode */
+void oldResize(uint16_t* pixels, uint16_t w1, uint16_t h1) {
+	uint16_t w2 = round(adjCombFactor * w1);
+	uint16_t h2 = round(adjCombFactor * h1);
+	int x_ratio = (int)((w1 << 16) / w2) + 1;
+	int y_ratio = (int)((h1 << 16) / h2) + 1;
+	for (int i = 0; i < h2; i++)
+		for (int j = 0; j < w2; j++)
+			pixels[(i * w1) + j] = pixels[(((i * y_ratio) >> 16) * w1) + ((j * x_ratio) >> 16)];
+	for (int j = 0; j < h2; j++)
+		for (int i = w2; i < w1; i++)
+			pixels[i + (j * w1)] = 65535;
+	for (int j = h2; j < h1; j++)
+		for (int i = 0; i < w1; i++)
+			pixels[i + (j * w1)] = 65535;
+
+	uint16_t rightMove = round((w1 - w2) / 2.0);
+	for (int i = 0; i < rightMove; i++) {
+		for (int col = (w1 - 1); col > 0; col--)
+			for (int row = 0; row < h1; row++)
+				pixels[col + (row * w1)] = pixels[col - 1 + (row * w1)];
+		for (int row = 0; row < h1; row++)
+			pixels[row * w1] = 65535;
+	}
+	uint16_t downMove = round((h1 - h2) / 2.0);
+	for (int i = 0; i < downMove; i++) {
+		for (int col = 0; col < w1; col++)
+			for (int row = (h1 - 1); row > 0; row--)
+				pixels[col + (row * w1)] = pixels[col + ((row - 1) * w1)];
+		for (int col = 0; col < w1; col++)
+			pixels[col] = 65535;
+	}
+}
+
+/* Capture and decode a visual frame onto a buffer filled with one value */
+void decodeOnto(uint16_t* buffer, uint32_t size, uint16_t value) {
+	for (uint32_t i = 0; i < size; i++)
+		buffer[i] = value;
+	camera_capture();
+	camera_get(camera_stream);
+}
+
+/* Alignment settings of the combined image */
+void setAlignment(float factor, byte left, byte right, byte up, byte down, bool rotation) {
+	adjCombFactor = factor;
+	adjCombLeft = left;
+	adjCombRight = right;
+	adjCombUp = up;
+	adjCombDown = down;
+	rotationEnabled = rotation;
+}
+
+/* Alignments with uneven offsets, each one normal and rotated */
+const float remapFactors[3] = { 0.9f, 1.0f, 0.85f };
+const byte remapOffsets[3][4] = { { 2, 0, 1, 3 }, { 0, 3, 2, 0 }, { 4, 1, 0, 2 } };
+
+/* The 320x240 visual image matches the old resize on the white buffer, without clearing it */
+void testRemap320x240() {
+	static uint16_t expected[76800];
+	test_initFirmware(leptonVersion_3_shutter);
+	host_spiDevice = test_spiDevice;
+	host_pinHook = test_camPinHook;
+	test_camJpeg = test_readFixture("camera_320x240.jpg");
+	displayMode = displayMode_visual;
+	hqRes = true;
+
+	for (byte i = 0; i < 6; i++) {
+		const byte* offsets = remapOffsets[i / 2];
+		setAlignment(remapFactors[i / 2], offsets[0], offsets[1], offsets[2], offsets[3], i & 1);
+		decodeOnto(bigBuffer, 76800, 65535);
+		oldResize(bigBuffer, 320, 240);
+		memcpy(expected, bigBuffer, sizeof(expected));
+
+		//Pixels of the last frame must not stay at the borders
+		decodeOnto(bigBuffer, 76800, 0x1234);
+		resizeImage();
+		uint32_t wrong = 0;
+		for (uint32_t j = 0; j < 76800; j++)
+			if (bigBuffer[j] != expected[j])
+				wrong++;
+		checkEqual(wrong, 0);
+	}
+	host_pinHook = NULL;
+	setAlignment(1, 0, 0, 0, 0, false);
+	displayMode = displayMode_thermal;
+}
+
+/* The borders of the 160x120 thermal image are filled where the visual image is not decoded */
+void testRemap160x120() {
+	static bool decoded[19200];
+	test_initFirmware(leptonVersion_3_shutter);
+	host_spiDevice = test_spiDevice;
+	host_pinHook = test_camPinHook;
+	test_camJpeg = test_readFixture("camera_160x120.jpg");
+	displayMode = displayMode_visual;
+	hqRes = false;
+
+	for (byte i = 0; i < 6; i++) {
+		const byte* offsets = remapOffsets[i / 2];
+		setAlignment(remapFactors[i / 2], offsets[0], offsets[1], offsets[2], offsets[3], i & 1);
+		//Mirrored visual image of the old hardware for the last alignment
+		mlx90614Version = (i >= 4) ? mlx90614Version_old : mlx90614Version_new;
+
+		//Decoded pixels are the ones that do not keep either fill value
+		decodeOnto(smallBuffer, 19200, 0x1234);
+		memcpy(bigBuffer, smallBuffer, 38400);
+		decodeOnto(smallBuffer, 19200, 0x4321);
+		for (uint16_t j = 0; j < 19200; j++)
+			decoded[j] = (bigBuffer[j] != 0x1234) || (smallBuffer[j] != 0x4321);
+
+		//Thermal image without black pixels, the fill is black in visual mode
+		for (uint16_t j = 0; j < 19200; j++)
+			smallBuffer[j] = 1 + (j % 4000);
+		resizeImage();
+		uint16_t wrong = 0;
+		for (uint16_t j = 0; j < 19200; j++)
+			if ((smallBuffer[j] == 0) == decoded[j])
+				wrong++;
+		checkEqual(wrong, 0);
+	}
+	host_pinHook = NULL;
+	setAlignment(1, 0, 0, 0, 0, false);
+	mlx90614Version = mlx90614Version_new;
+	displayMode = displayMode_thermal;
+}
+
+int main() {
+	test_run("Upscaler 160x120", testUpscaler160x120);
+	test_run("Upscaler 80x60", testUpscaler80x60);
+	test_run("Local 160x120", testLocal160x120);
+	test_run("Local 80x60", testLocal80x60);
+	test_run("Equalize static", testEqualizeStatic);
+	test_run("Remap 320x240", testRemap320x240);
+	test_run("Remap 160x120", testRemap160x120);
+	return test_result();
+}
+
+#endif
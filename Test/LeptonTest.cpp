@@ -0,0 +1,179 @@
+/*
+*
+* LEPTONTEST - Frame capture from recorded VoSPI streams
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Methods */
+
+/* Compare the small buffer with the frame starting at a packet of the stream */
+void checkFrame(size_t firstPacket, bool reversed) {
+	uint16_t count = rawWidth * rawHeight;
+	uint16_t mismatches = 0;
+	for (uint16_t i = 0; i < count; i++) {
+		uint16_t pos = reversed ? (count - 1 - i) : i;
+		if (smallBuffer[pos] != test_vospiValue(firstPacket + (i / 80), i % 80))
+			mismatches++;
+	}
+	checkEqual(mismatches, 0);
+}
+
+/* Lepton2, discard packets before each frame */
+void testLepton2Discard() {
+	test_initFirmware(leptonVersion_2_shutter);
+	//Rotated on the new hardware, stored in the order of the packets
+	rotationEnabled = true;
+	test_loadVoSPI("lepton2.vospi");
+
+	lepton_getRawValues();
+	checkFrame(5, false);
+	checkEqual(lepton_packageErrors, 5);
+
+	lepton_getRawValues();
+	checkFrame(68, false);
+	checkEqual(lepton_packageErrors, 8);
+	checkEqual(lepton_resyncs, 0);
+	checkEqual(lepton_captureState, leptonCapture_idle);
+	check(host_pins[pin_lepton_cs] == HIGH);
+}
+
+/* Lepton2 without rotation, stored upside down */
+void testLepton2Orientation() {
+	test_initFirmware(leptonVersion_2_shutter);
+	test_loadVoSPI("lepton2.vospi");
+
+	lepton_getRawValues();
+	checkFrame(5, true);
+}
+
+/* Lepton2, a repeated line restarts the frame */
+void testLepton2RowError() {
+	test_initFirmware(leptonVersion_2_shutter);
+	rotationEnabled = true;
+	test_loadVoSPI("lepton2_rowerror.vospi");
+
+	lepton_getRawValues();
+	checkFrame(65, false);
+	//Two discards, the repeated line, the 29 lines after it and three discards
+	checkEqual(lepton_packageErrors, 2 + 1 + 29 + 3);
+	checkEqual(lepton_resyncs, 0);
+}
+
+/* Lepton2, an invalid value restarts the frame once */
+void testLepton2InvalidValue() {
+	test_initFirmware(leptonVersion_2_shutter);
+	rotationEnabled = true;
+	test_loadVoSPI("lepton2.vospi");
+	//Zero pixel in line 10 of the first frame
+	size_t pos = ((5 + 10) * 164) + 4 + (2 * 40);
+	test_vospi[pos] = 0;
+	test_vospi[pos + 1] = 0;
+
+	lepton_getRawValues();
+	checkFrame(68, false);
+	//The invalid line, the 48 lines after the dropped package and three discards
+	checkEqual(lepton_packageErrors, 5 + 1 + 48 + 3);
+	checkEqual(lepton_resyncs, 0);
+}
+
+/* Lepton2, too many errors resync the capture */
+void testLepton2Resync() {
+	test_initFirmware(leptonVersion_2_shutter);
+	rotationEnabled = true;
+	test_loadVoSPI("lepton2_resync.vospi");
+
+	uint32_t start = millis();
+	lepton_getRawValues();
+	checkFrame(300, false);
+	checkEqual(lepton_packageErrors, 300);
+	checkEqual(lepton_resyncs, 1);
+	//The Lepton has been deselected long enough
+	check((millis() - start) >= 186);
+}
+
+/* Lepton3, discard packets before each frame of four segments */
+void testLepton3Discard() {
+	test_initFirmware(leptonVersion_3_shutter);
+	rotationEnabled = true;
+	test_loadVoSPI("lepton3.vospi");
+
+	lepton_getRawValues();
+	checkFrame(3, false);
+	checkEqual(lepton_packageErrors, 3);
+
+	lepton_getRawValues();
+	checkFrame(245, false);
+	checkEqual(lepton_packageErrors, 5);
+	checkEqual(lepton_resyncs, 0);
+}
+
+/* Lepton3 without rotation, stored upside down */
+void testLepton3Orientation() {
+	test_initFirmware(leptonVersion_3_shutter);
+	test_loadVoSPI("lepton3.vospi");
+
+	lepton_getRawValues();
+	checkFrame(3, true);
+}
+
+/* Lepton3, segments out of order and invalid segments are skipped */
+void testLepton3SegmentError() {
+	test_initFirmware(leptonVersion_3_shutter);
+	rotationEnabled = true;
+	test_loadVoSPI("lepton3_segment.vospi");
+
+	lepton_getRawValues();
+	checkFrame(3 + 120 + 240, false);
+	//Three discards, then packet 20 and the 39 lines after it for each wrong or invalid segment
+	checkEqual(lepton_packageErrors, 3 + (6 * 40));
+	checkEqual(lepton_resyncs, 0);
+}
+
+/* The live mode pipeline creates an image from the captured frame */
+void testThermalImage() {
+	test_initFirmware(leptonVersion_3_shutter);
+	test_loadVoSPI("lepton3.vospi", 245 * 164);
+
+	for (byte i = 0; i < 3; i++) {
+		createThermalImg();
+		showImage();
+	}
+	//Limits inside the range of the scene
+	check((minValue >= 7700) && (minValue < maxValue) && (maxValue <= 8500));
+	//Colors of the whole screen
+	uint32_t black = 0;
+	for (uint32_t i = 0; i < 76800; i++)
+		if (bigBuffer[i] == 0)
+			black++;
+	checkEqual(black, 0);
+	checkEqual(lepton_captureState, leptonCapture_idle);
+}
+
+int main() {
+	test_run("Lepton2 discard", testLepton2Discard);
+	test_run("Lepton2 orientation", testLepton2Orientation);
+	test_run("Lepton2 row error", testLepton2RowError);
+	test_run("Lepton2 invalid value", testLepton2InvalidValue);
+	test_run("Lepton2 resync", testLepton2Resync);
+	test_run("Lepton3 discard", testLepton3Discard);
+	test_run("Lepton3 orientation", testLepton3Orientation);
+	test_run("Lepton3 segment error", testLepton3SegmentError);
+	test_run("Thermal image", testThermalImage);
+	return test_result();
+}
+
+#endif
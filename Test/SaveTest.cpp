@@ -0,0 +1,252 @@
+/*
+*
+* SAVETEST - Raw images and video containers on the SD card
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Variables */
+
+//Seed of the test frames
+uint32_t frameSeed;
+
+/* Methods */
+
+/* Pseudo random number for the test frames */
+uint16_t frameRandom() {
+	frameSeed = frameSeed * 1664525 + 1013904223;
+	return frameSeed >> 16;
+}
+
+/* Fill the small buffer with a smooth scene or with noise, returns a copy */
+std::vector<uint16_t> fillFrame(bool noise) {
+	uint16_t count = rawWidth * rawHeight;
+	for (uint16_t i = 0; i < count; i++) {
+		if (noise)
+			smallBuffer[i] = frameRandom() | 1;
+		else
+			smallBuffer[i] = 7900 + ((i % rawWidth) * 2) + (i / rawWidth) + (frameRandom() % 9);
+	}
+	minValue = 7900 + frameRandom() % 100;
+	maxValue = 8400 + frameRandom() % 100;
+	return std::vector<uint16_t>(smallBuffer, smallBuffer + count);
+}
+
+/* Compare the small buffer with a frame */
+void checkFrameEqual(const std::vector<uint16_t>& frame) {
+	uint16_t mismatches = 0;
+	for (uint16_t i = 0; i < frame.size(); i++)
+		if (smallBuffer[i] != frame[i])
+			mismatches++;
+	checkEqual(mismatches, 0);
+}
+
+/* Record frames into a new video container, without closing it */
+std::vector<std::vector<uint16_t>> recordFrames(byte count) {
+	std::vector<std::vector<uint16_t>> frames;
+	sd.mkdir("/VIDEO");
+	sd.chdir("/VIDEO");
+	videoBegin();
+	for (byte i = 0; i < count; i++) {
+		//Every third frame does not get smaller with the rice coder
+		frames.push_back(fillFrame((i % 3) == 2));
+		videoSaveFrame();
+	}
+	return frames;
+}
+
+/* Load all frames of the recorded container and compare them */
+void checkRecording(const std::vector<std::vector<uint16_t>>& frames) {
+	check(loadVideoOpen((char*) "VIDEO"));
+	checkEqual(videoContainerFrames, frames.size());
+	for (uint16_t i = 0; i < frames.size(); i++) {
+		loadVideoFrame(i);
+		checkFrameEqual(frames[i]);
+	}
+	loadVideoClose();
+	//No index left next to the container
+	sd.chdir("/VIDEO");
+	check(!sd.exists(video_indexName));
+}
+
+/* Video container of a Lepton, the seek index is written during the recording */
+void checkVideo(byte lepton) {
+	test_initFirmware(lepton);
+	frameSeed = lepton + 1;
+	std::vector<std::vector<uint16_t>> frames = recordFrames(200);
+	videoEnd();
+	checkRecording(frames);
+}
+
+/* Lepton3 video */
+void testVideoLepton3() {
+	checkVideo(leptonVersion_3_shutter);
+}
+
+/* Lepton2 video, the index spans several sectors */
+void testVideoLepton2() {
+	checkVideo(leptonVersion_2_shutter);
+}
+
+/* Interrupted recording, the index is rebuilt from the records */
+void testVideoInterrupted() {
+	test_initFirmware(leptonVersion_2_shutter);
+	frameSeed = 3;
+	std::vector<std::vector<uint16_t>> frames = recordFrames(150);
+	//Power loss after the last sector was written, while the next record was written
+	saveBlockFlush();
+	uint8_t partial[600] = { 0, 0, 1, 0, 0, 0, rawFormat_rice };
+	videoFile.write(partial, sizeof(partial));
+	videoFile.close();
+	videoIndexFile.close();
+	checkRecording(frames);
+}
+
+/* Raw image after a video, the staging buffer writes to the image file */
+void testImageAfterVideo() {
+	test_initFirmware(leptonVersion_3_shutter);
+	frameSeed = 4;
+	recordFrames(2);
+	videoEnd();
+	uint32_t videoSize = host_sdFiles["/VIDEO/VIDEO.TCV"].size();
+	//Left pointing to the container by an earlier write
+	saveBlockFile = &videoFile;
+
+	sd.chdir("/");
+	char name[20] = "20261017120000";
+	fillFrame(false);
+	saveRawData(name);
+	checkEqual(host_sdFiles["/VIDEO/VIDEO.TCV"].size(), videoSize);
+	std::vector<uint8_t>& image = host_sdFiles["/20261017120000.DAT"];
+	check((image.size() > 4) && (image[0] == 'T') && (image[1] == 'C') && (image[2] == 'R'));
+}
+
+/* Raw images are rice coded in one pass, noisy ones are written plain over the coded part */
+void testImageFormats() {
+	for (byte lepton = leptonVersion_2_shutter; lepton <= leptonVersion_3_shutter; lepton++) {
+		test_initFirmware(lepton);
+		frameSeed = 5;
+		sd.chdir("/");
+		for (byte noise = 0; noise < 2; noise++) {
+			char name[20] = "20261017120000";
+			name[13] = '0' + noise;
+			std::vector<uint16_t> frame = fillFrame(noise);
+			uint32_t writes = host_sdWrites;
+			saveRawData(name);
+			std::vector<uint8_t>& image = host_sdFiles[std::string("/") + name];
+			checkEqual(image[3], noise ? rawFormat_plain : rawFormat_rice);
+			//Settings and temp points before the values
+			uint32_t size = image.size() - 411;
+			if (noise)
+				checkEqual(size, 2 * frame.size());
+			else
+				check(size < frame.size());
+			//Rice coded images are written sector by sector without changes
+			if (!noise)
+				checkEqual(host_sdWrites - writes, (image.size() + 511) / 512);
+
+			memset(smallBuffer, 0, frame.size() * 2);
+			loadRawData(name, NULL);
+			sdFile.close();
+			checkFrameEqual(frame);
+		}
+	}
+}
+
+/* Rice code the small buffer into a file, decode it again and compare */
+void checkRice(const std::vector<uint16_t>& frame) {
+	bool lepton3 = (leptonVersion == leptonVersion_3_shutter);
+	memcpy(smallBuffer, frame.data(), frame.size() * 2);
+
+	sd.chdir("/");
+	sdFile.open("RICE.DAT", O_RDWR | O_CREAT | O_TRUNC);
+	saveBlockFile = &sdFile;
+	saveBlockPos = 0;
+	uint32_t size = riceEncode(saveBlockByte, NULL, 0xFFFFFFFF);
+	saveBlockFlush();
+	//The counted size matches the written one
+	checkEqual(sdFile.fileSize(), size);
+	sdFile.close();
+
+	memset(smallBuffer, 0, frame.size() * 2);
+	sdFile.open("RICE.DAT", O_READ);
+	riceDecode(&sdFile, lepton3);
+	sdFile.close();
+	checkFrameEqual(frame);
+}
+
+/* Frame of the Lepton fixture */
+std::vector<uint16_t> fixtureFrame(byte lepton) {
+	test_initFirmware(lepton);
+	test_loadVoSPI((lepton == leptonVersion_3_shutter) ? "lepton3.vospi" : "lepton2.vospi");
+	size_t first = (lepton == leptonVersion_3_shutter) ? 3 : 5;
+	std::vector<uint16_t> frame(rawWidth * rawHeight);
+	for (uint16_t i = 0; i < frame.size(); i++)
+		frame[i] = test_vospiValue(first + (i / 80), i % 80);
+	return frame;
+}
+
+/* Rice coder on the frames of a Lepton, with escape codes around the adaption boundary */
+void checkRiceFrames(byte lepton) {
+	std::vector<uint16_t> frame = fixtureFrame(lepton);
+	checkRice(frame);
+
+	//The residual mean is halved after rice_reset - 1 values, spikes right before and after it
+	std::vector<uint16_t> spikes = frame;
+	uint16_t positions[] = { rice_reset - 3, rice_reset - 2, rice_reset - 1, rice_reset,
+		(2 * rice_reset) - 2, (2 * rice_reset) - 1, (uint16_t)(frame.size() - 1) };
+	for (byte i = 0; i < sizeof(positions) / sizeof(positions[0]); i++)
+		spikes[positions[i]] = (i & 1) ? 1 : 65535;
+	checkRice(spikes);
+
+	//Flat area first, so that the parameter is zero and every step escapes
+	std::vector<uint16_t> steps = frame;
+	for (uint16_t i = 0; i < 2 * rice_reset; i++)
+		steps[i] = 8000;
+	for (uint16_t i = 2 * rice_reset; i < 2 * rice_reset + 8; i++)
+		steps[i] = 8000 + ((i & 1) ? 30000 : 24);
+	checkRice(steps);
+
+	//Largest residuals at the first value and in the first column
+	std::vector<uint16_t> extremes = frame;
+	extremes[0] = 65535;
+	extremes[rawWidth] = 0;
+	extremes[2 * rawWidth] = 65535;
+	checkRice(extremes);
+}
+
+/* Rice coder on Lepton3 frames */
+void testRiceLepton3() {
+	checkRiceFrames(leptonVersion_3_shutter);
+}
+
+/* Rice coder on Lepton2 frames */
+void testRiceLepton2() {
+	checkRiceFrames(leptonVersion_2_shutter);
+}
+
+int main() {
+	test_run("Rice Lepton3", testRiceLepton3);
+	test_run("Rice Lepton2", testRiceLepton2);
+	test_run("Video Lepton3", testVideoLepton3);
+	test_run("Video Lepton2", testVideoLepton2);
+	test_run("Video interrupted", testVideoInterrupted);
+	test_run("Image after video", testImageAfterVideo);
+	test_run("Image formats", testImageFormats);
+	return test_result();
+}
+
+#endif
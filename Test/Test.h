@@ -0,0 +1,236 @@
+/*
+*
+* TEST - Checks and device models of the host tests
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+/* Includes */
+
+//Stand-in for the Teensy core, then the whole firmware as one translation unit
+#include "Arduino.h"
+#include "DIY-Thermocam.ino"
+#include "Hardware/Touchscreen/FT6206_Touchscreen.cpp"
+#include "Hardware/Touchscreen/XPT2046_Touchscreen.cpp"
+
+/* Defines */
+
+//Check a condition, continue with the test if it fails
+#define check(cond) test_check((cond), #cond, __FILE__, __LINE__)
+//Check two integer values for equality
+#define checkEqual(actual, expected) test_checkEqual((long long)(actual), (long long)(expected), #actual, __FILE__, __LINE__)
+
+/* Variables */
+
+//Number of checks and failed checks
+uint32_t test_checks = 0;
+uint32_t test_failures = 0;
+
+//VoSPI stream the Lepton model sends, position and number of packets after the end
+std::vector<uint8_t> test_vospi;
+size_t test_vospiPos = 0;
+uint32_t test_vospiOverrun = 0;
+//Start the stream again at this position at the end, otherwise send discard packets
+long test_vospiLoop = -1;
+
+//JPEG frame in the FIFO of the ArduChip
+std::vector<uint8_t> test_camJpeg;
+//Bytes since the chip select, address of the transfer and burst position
+uint32_t test_camByte;
+uint8_t test_camAddress;
+size_t test_camBurst;
+
+/* Methods */
+
+/* Count a check and report a failure */
+bool test_check(bool ok, const char* expr, const char* file, int line) {
+	test_checks++;
+	if (!ok) {
+		test_failures++;
+		printf("  FAILED %s:%d: %s\n", file, line, expr);
+	}
+	return ok;
+}
+
+/* Check an integer value */
+bool test_checkEqual(long long actual, long long expected, const char* expr, const char* file, int line) {
+	test_checks++;
+	if (actual != expected) {
+		test_failures++;
+		printf("  FAILED %s:%d: %s is %lld, expected %lld\n", file, line, expr, actual, expected);
+		return false;
+	}
+	return true;
+}
+
+/* Run one test */
+void test_run(const char* name, void (*test)()) {
+	uint32_t failures = test_failures;
+	test();
+	printf("%s %s\n", (test_failures == failures) ? "ok  " : "FAIL", name);
+}
+
+/* Print the summary, returns the exit code */
+int test_result() {
+	printf("%u checks, %u failed\n", test_checks, test_failures);
+	return (test_failures == 0) ? 0 : 1;
+}
+
+/* Read a file of the fixture directory */
+std::vector<uint8_t> test_readFixture(const char* name) {
+	std::string path = std::string(HOST_FIXTURES) + name;
+	std::vector<uint8_t> data;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		printf("Missing fixture %s, run make fixtures\n", path.c_str());
+		exit(2);
+	}
+	uint8_t buf[4096];
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+		data.insert(data.end(), buf, buf + len);
+	fclose(file);
+	return data;
+}
+
+/* Lepton model on the SPI bus, sends the VoSPI stream while selected */
+void test_leptonDevice(uint8_t* data, size_t len) {
+	if (host_pins[pin_lepton_cs] != LOW) {
+		memset(data, 0, len);
+		return;
+	}
+	for (size_t i = 0; i < len; i++) {
+		//End of the stream, loop or send discard packets
+		if (test_vospiPos >= test_vospi.size()) {
+			if (test_vospiLoop >= 0)
+				test_vospiPos = test_vospiLoop;
+			else {
+				data[i] = ((i % 164) == 0) ? 0x0F : 0;
+				//A capture that never ends
+				if (((i % 164) == 0) && (++test_vospiOverrun > 10000)) {
+					printf("VoSPI stream exhausted\n");
+					exit(2);
+				}
+				continue;
+			}
+		}
+		data[i] = test_vospi[test_vospiPos++];
+	}
+}
+
+/* Let the Lepton model send a fixture */
+void test_loadVoSPI(const char* name, long loop = -1) {
+	test_vospi = test_readFixture(name);
+	test_vospiPos = 0;
+	test_vospiOverrun = 0;
+	test_vospiLoop = loop;
+	host_spiDevice = test_leptonDevice;
+}
+
+/* Raw values of a packet in the stream */
+uint16_t test_vospiValue(size_t packet, byte column) {
+	size_t pos = (packet * 164) + 4 + (2 * column);
+	return (test_vospi[pos] << 8) | test_vospi[pos + 1];
+}
+
+/* A new transfer starts when the ArduChip is selected */
+void test_camPinHook(uint8_t pin, uint8_t value) {
+	if ((pin == pin_cam_cs) && (value == LOW))
+		test_camByte = 0;
+}
+
+/* ArduChip model, captures are done at once and the FIFO holds the fixture */
+void test_camDevice(uint8_t* data, size_t len) {
+	for (size_t i = 0; i < len; i++, test_camByte++) {
+		uint8_t out = 0;
+		//First byte is the register address
+		if (test_camByte == 0)
+			test_camAddress = data[i];
+		//Burst read of the FIFO
+		else if (test_camAddress == BURST_FIFO_READ)
+			out = (test_camBurst < test_camJpeg.size()) ? test_camJpeg[test_camBurst++] : 0;
+		//Start of a capture, the FIFO is read from the beginning
+		else if (test_camAddress == (ARDUCHIP_FIFO | 0x80)) {
+			if (data[i] & FIFO_START_MASK)
+				test_camBurst = 0;
+		}
+		//Register reads
+		else if (test_camAddress == ARDUCHIP_TRIG)
+			out = CAP_DONE_MASK;
+		else if (test_camAddress == FIFO_SIZE1)
+			out = test_camJpeg.size() & 0xFF;
+		else if (test_camAddress == FIFO_SIZE2)
+			out = (test_camJpeg.size() >> 8) & 0xFF;
+		else if (test_camAddress == FIFO_SIZE3)
+			out = (test_camJpeg.size() >> 16) & 0x7F;
+		data[i] = out;
+	}
+}
+
+/* Lepton and ArduChip share the SPI bus */
+void test_spiDevice(uint8_t* data, size_t len) {
+	if (host_pins[pin_cam_cs] == LOW)
+		test_camDevice(data, len);
+	else
+		test_leptonDevice(data, len);
+}
+
+/* Bring the firmware into the state after the boot, without the hardware detection */
+void test_initFirmware(byte lepton) {
+	//Erased EEPROM and empty card
+	memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+	host_sdClear();
+	Serial.rx.clear();
+	Serial.tx.clear();
+	Serial1.rx.clear();
+	Serial1.tx.clear();
+	host_pins[pin_lepton_cs] = HIGH;
+	host_pins[pin_cam_cs] = HIGH;
+
+	//Hardware versions of the DIY-Thermocam V2
+	detectTeensyVersion();
+	mlx90614Version = mlx90614Version_new;
+	//Capacitive touch screen, no touch without a device on the bus
+	touch_capacitive = true;
+	leptonVersion = lepton;
+	leptonShutter = leptonShutter_auto;
+	diagnostic = diag_ok;
+
+	//Default settings
+	readEEPROM();
+	selectColorScheme();
+	rotationEnabled = false;
+	autoMode = true;
+	limitsLocked = false;
+	calStatus = cal_standard;
+	calComp = 0;
+	calTimer = millis();
+	mlx90614_amb = 25;
+	mlx90614_object = 25;
+
+	//Buffers and DMA channels
+	if (smallBuffer == NULL)
+		smallBuffer = (uint16_t*)malloc(38400);
+	if (bigBuffer == NULL)
+		bigBuffer = (uint16_t*)malloc(153600);
+	if (camera_jdwork == NULL)
+		camera_jdwork = malloc(3100);
+	display_initDMA();
+	lepton_initDMA();
+
+	//Nothing left from the last test
+	lepton_captureState = leptonCapture_idle;
+	lepton_frameReady = false;
+	lepton_packageErrors = 0;
+	lepton_resyncs = 0;
+	memset(profiler_count, 0, sizeof(profiler_count));
+	memset(profiler_pos, 0, sizeof(profiler_pos));
+}
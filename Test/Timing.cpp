@@ -0,0 +1,136 @@
+/*
+*
+* TIMING - Per-stage timing of the live mode on the host
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+//Only for the host build, the Arduino build compiles every source of the sketch
+#if defined(HOST_BUILD)
+
+#include "Test.h"
+
+/* Defines */
+
+//Frames measured per configuration, the whole profiler window
+#define timing_frames profiler_window
+
+/* Variables */
+
+//Names of the profiler stages
+const char* timing_stages[profiler_stages] = { "checkSerial", "screenOffCheck", "getRawValues",
+	"compensateCalib", "filter", "convertColors", "displayInfos", "showImage", "frame" };
+
+/* Methods */
+
+/* Run the live mode loop and print the stages */
+void timing_run(const char* name, byte lepton, byte mode, bool hq) {
+	test_initFirmware(lepton);
+	if (lepton == leptonVersion_2_shutter)
+		test_loadVoSPI("lepton2.vospi", 68 * 164);
+	else
+		test_loadVoSPI("lepton3.vospi", 245 * 164);
+	host_spiDevice = test_spiDevice;
+	host_pinHook = test_camPinHook;
+	displayMode = mode;
+	hqRes = hq;
+
+	//Visual frame of the camera resolution for this mode
+	if (mode != displayMode_thermal) {
+		test_camJpeg = test_readFixture(hq ? "camera_320x240.jpg" : "camera_160x120.jpg");
+		camera_capture();
+	}
+
+	//Same steps as the main loop of the live mode
+	for (uint16_t i = 0; i < timing_frames; i++) {
+		profiler_frameBegin();
+		profiler_start();
+		checkSerial();
+		profiler_stop(profiler_checkSerial);
+		profiler_start();
+		screenOffCheck();
+		profiler_stop(profiler_screenOffCheck);
+		if (displayMode == displayMode_thermal) {
+			camera_releaseStream();
+			createThermalImg();
+		}
+		else
+			createVisCombImg();
+		profiler_start();
+		displayInfos();
+		profiler_stop(profiler_displayInfos);
+		profiler_start();
+		showImage();
+		profiler_stop(profiler_showImage);
+		profiler_frameEnd();
+	}
+	host_pinHook = NULL;
+
+	printf("\n%s, %u frames\n", name, profiler_count[profiler_frame]);
+	printf("  %-16s %8s %8s %8s %8s\n", "stage", "min", "avg", "max", "p99");
+	for (byte stage = 0; stage < profiler_stages; stage++) {
+		uint32_t stats[4];
+		profiler_getStats(stage, stats);
+		printf("  %-16s %8u %8u %8u %8u\n", timing_stages[stage], stats[0], stats[1], stats[2], stats[3]);
+	}
+}
+
+/* Average time of one upscaler order */
+uint32_t timing_upscale(byte order, bool trans) {
+	const uint16_t runs = 256;
+	uint32_t start = micros();
+	for (uint16_t i = 0; i < runs; i++) {
+		if (order == upscale_colors)
+			upscaleColors(trans);
+		//Without transparency, the colors of the big buffer are done afterwards
+		else {
+			upscaleValues(trans);
+			if (!trans)
+				convertColors();
+		}
+	}
+	return (micros() - start) / runs;
+}
+
+/* Compare both orders of the upscaler for one Lepton */
+void timing_upscaler(const char* name, byte lepton) {
+	test_initFirmware(lepton);
+	std::vector<uint8_t> data = test_readFixture((lepton == leptonVersion_3_shutter) ?
+		"filter_input_160x120.raw" : "filter_input_80x60.raw");
+	memcpy(smallBuffer, data.data(), data.size());
+	hqRes = true;
+	calcFrameStats();
+	limitValues();
+	initUpscaleTables();
+
+	printf("  %-8s %10u %10u %10u %10u\n", name, timing_upscale(upscale_values, false), timing_upscale(upscale_colors, false),
+		timing_upscale(upscale_values, true), timing_upscale(upscale_colors, true));
+}
+
+int main() {
+	//Frame waits and SPI transfers take no time on the host, compare configurations only
+	printf("Host timings in us, without the waits for the Lepton, camera and display\n");
+	timing_run("Thermal, Lepton3, HQ resolution", leptonVersion_3_shutter, displayMode_thermal, true);
+	timing_run("Thermal, Lepton3, low resolution", leptonVersion_3_shutter, displayMode_thermal, false);
+	timing_run("Thermal, Lepton2, HQ resolution", leptonVersion_2_shutter, displayMode_thermal, true);
+	timing_run("Combined, Lepton3, HQ resolution", leptonVersion_3_shutter, displayMode_combined, true);
+	timing_run("Combined, Lepton3, low resolution", leptonVersion_3_shutter, displayMode_combined, false);
+	timing_run("Visual, Lepton3, HQ resolution", leptonVersion_3_shutter, displayMode_visual, true);
+
+	//Both orders of the 320x240 upscaler, average of one frame
+	printf("\nUpscaler to 320x240, thermal and combined mode\n");
+	printf("  %-8s %10s %10s %10s %10s\n", "sensor", "values", "colors", "values+a", "colors+a");
+	timing_upscaler("Lepton3", leptonVersion_3_shutter);
+	timing_upscaler("Lepton2", leptonVersion_2_shutter);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,345 @@
+/*
+*
+* AGC - Histogram based automatic gain control
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+/* Defines */
+
+//Bins of the global and the tile histograms, tile bins are 2^agc_tileShift global bins wide
+#define agc_bins      256
+#define agc_tileBins  32
+#define agc_tileShift 3
+//Tiles per row and column for the local equalization
+#define agc_tiles     4
+//Share of the values clipped at the cold and hot end in per mille
+#define agc_clipLow   10
+#define agc_clipHigh  10
+//Plateau and tile clip limit as multiple of the average bin count
+#define agc_plateau   4
+#define agc_tileClip  3
+//New maps are mixed into the old ones with a weight of 1 / 2^agc_smooth
+#define agc_smooth    2
+
+/* Variables */
+
+//Histograms of the current frame over a common value range
+uint16_t agcHist[agc_bins];
+uint16_t agcTileHist[agc_tiles * agc_tiles][agc_tileBins];
+//First raw value and bin width as bit shift of the range
+uint16_t agcMin;
+byte agcShift;
+//The range is set and the histograms have been filled with it
+bool agcRangeValid = false;
+bool agcHistValid = false;
+bool agcTileHistValid = false;
+//Output level with 16 bits at the bin edges
+uint16_t agcMap[agc_bins + 1];
+uint16_t agcTileMap[agc_tiles * agc_tiles][agc_tileBins + 1];
+//The maps belong to the current range and are smoothed from now on
+bool agcMapValid = false;
+bool agcTileMapValid = false;
+//Raised when the global map changes
+uint16_t agcMapVersion = 0;
+//The tile maps belong to the live frame, the colorization applies them
+bool agcLocalApply = false;
+//Tile of each raw column and row, first tile and weight of the next one for the interpolation
+byte agcTileCol[160];
+byte agcFirstCol[160];
+uint16_t agcWeightCol[160];
+byte agcTileRow[120];
+byte agcFirstRow[120];
+uint16_t agcWeightRow[120];
+//Raw width the tables were calculated for, zero if not yet
+byte agcTableWidth = 0;
+
+/* Methods */
+
+/* Check if an AGC mode is used, only for automatic limits */
+inline bool agcActive(byte mode) {
+	return (agcMode == mode) && (autoMode) && (!limitsLocked);
+}
+
+/* Check if any histogram based AGC mode is used */
+inline bool agcEnabled() {
+	return (agcMode != agcMode_linear) && (autoMode) && (!limitsLocked);
+}
+
+/* Get the position of a raw value inside the histogram range */
+inline uint16_t agcOffset(uint16_t value) {
+	if (value <= agcMin)
+		return 0;
+	uint32_t offset = value - agcMin;
+	uint32_t last = ((uint32_t)agc_bins << agcShift) - 1;
+	return (offset > last) ? last : offset;
+}
+
+/* Find the first and last bin of the histogram without the clipped shares at both ends */
+void agcFindLimits(uint16_t* low, uint16_t* high) {
+	uint32_t lowCount = ((uint32_t)frameStats.count * agc_clipLow) / 1000;
+	uint32_t highCount = ((uint32_t)frameStats.count * agc_clipHigh) / 1000;
+
+	//Skip the bins inside the share at the cold end
+	uint32_t sum = 0;
+	uint16_t first = 0;
+	while ((first < (agc_bins - 1)) && ((sum + agcHist[first]) <= lowCount))
+		sum += agcHist[first++];
+
+	//And at the hot end
+	sum = 0;
+	uint16_t last = agc_bins - 1;
+	while ((last > first) && ((sum + agcHist[last]) <= highCount))
+		sum += agcHist[last--];
+
+	*low = first;
+	*high = last;
+}
+
+/* Check the histogram of this frame against its range, set a new range if required */
+void agcCheckRange(uint16_t minVal, uint16_t maxVal) {
+	if (agcRangeValid) {
+		uint16_t lowBin, highBin;
+		agcFindLimits(&lowBin, &highBin);
+
+		//Outliers end up in the outer bins, only the clipped limits have to be inside
+		bool lowInside = (lowBin > 0) || (agcMin == 0);
+		bool highInside = (highBin < (agc_bins - 1));
+		//And the bins must not be too coarse for them
+		bool fine = (agcShift == 0) || ((4 * (highBin - lowBin + 1)) >= agc_bins);
+		if (lowInside && highInside && fine) {
+			agcHistValid = true;
+			return;
+		}
+
+		//Take the clipped limits for the new range where they are known
+		if (lowInside)
+			minVal = agcMin + ((uint32_t)lowBin << agcShift);
+		if (highInside)
+			maxVal = agcMin + ((uint32_t)(highBin + 1) << agcShift) - 1;
+	}
+
+	//New range with a quarter of margin
+	uint32_t span = (maxVal > minVal) ? (maxVal - minVal) : 0;
+	agcShift = 0;
+	while (((uint32_t)agc_bins << agcShift) < (span + (span / 4) + 1))
+		agcShift++;
+	uint32_t size = (uint32_t)agc_bins << agcShift;
+	int32_t start = minVal - (int32_t)((size - span) / 2);
+	agcMin = (start < 0) ? 0 : start;
+	agcRangeValid = true;
+
+	//Histograms and maps of the old range do not fit
+	agcHistValid = false;
+	agcTileHistValid = false;
+	agcMapValid = false;
+	agcTileMapValid = false;
+}
+
+/* Create the level map of a histogram clipped at a limit, optionally spreading the excess, returns if it changed */
+bool agcBuildMap(uint16_t* hist, uint16_t bins, uint16_t limit, uint16_t* map, bool spread, bool smooth) {
+	//Sum of the clipped histogram and the excess
+	uint32_t total = 0;
+	uint32_t excess = 0;
+	for (uint16_t i = 0; i < bins; i++) {
+		if (hist[i] > limit) {
+			total += limit;
+			excess += hist[i] - limit;
+		}
+		else
+			total += hist[i];
+	}
+	if (spread)
+		total += excess;
+
+	//Levels at the bin edges from the cumulative sum
+	uint32_t sum = 0;
+	bool changed = false;
+	for (uint16_t i = 0; i <= bins; i++) {
+		uint32_t level;
+		//Empty histogram, map linear
+		if (total == 0)
+			level = (i * 65535UL) / bins;
+		else
+			level = ((sum + (spread ? (excess * i) / bins : 0)) * 65535UL) / total;
+
+		//Mix with the map of the last frame against flicker
+		uint16_t old = map[i];
+		if (smooth)
+			map[i] += ((int32_t)level - map[i]) / (1 << agc_smooth);
+		else
+			map[i] = level;
+		if (map[i] != old)
+			changed = true;
+
+		if (i < bins)
+			sum += min(hist[i], limit);
+	}
+	return changed;
+}
+
+/* Clip the limits at the percentiles of the histogram */
+void agcPercentile() {
+	if (!agcHistValid)
+		return;
+
+	uint16_t low, high;
+	agcFindLimits(&low, &high);
+
+	//Stay inside the frame limits
+	uint32_t lowValue = agcMin + ((uint32_t)low << agcShift);
+	uint32_t highValue = agcMin + ((uint32_t)(high + 1) << agcShift) - 1;
+	if ((lowValue > maxValue) || (highValue < minValue))
+		return;
+	if (lowValue > minValue)
+		minValue = lowValue;
+	if (highValue < maxValue)
+		maxValue = highValue;
+}
+
+/* Equalize the global histogram with a plateau */
+void agcEqualize() {
+	if (!agcHistValid)
+		return;
+
+	uint16_t plateau = ((uint32_t)frameStats.count * agc_plateau) / agc_bins;
+	if (plateau == 0)
+		plateau = 1;
+	bool changed = agcBuildMap(agcHist, agc_bins, plateau, agcMap, false, agcMapValid);
+
+	//The color table is only created again for a new range or changed levels
+	if ((changed) || (!agcMapValid))
+		agcMapVersion++;
+	agcMapValid = true;
+}
+
+/* Get the output level of a raw value from the global map */
+inline uint16_t agcLevel(uint16_t value) {
+	uint16_t offset = agcOffset(value);
+	uint16_t bin = offset >> agcShift;
+	uint16_t frac = offset - (bin << agcShift);
+	return agcMap[bin] + (((uint32_t)(agcMap[bin + 1] - agcMap[bin]) * frac) >> agcShift);
+}
+
+/* Get the first raw value inside the limits that reaches an output level of the global map */
+uint16_t agcLevelValue(uint32_t level) {
+	uint16_t low = minValue;
+	uint16_t high = maxValue;
+	while (low < high) {
+		uint16_t mid = low + ((high - low) / 2);
+		if (agcLevel(mid) < level)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* Calculate the tiles and interpolation weights along one axis */
+void agcInitAxis(byte* tile, byte* first, uint16_t* weight, byte size) {
+	byte tileSize = size / agc_tiles;
+	for (byte i = 0; i < size; i++) {
+		tile[i] = i / tileSize;
+		//Position relative to the center of the first tile
+		int16_t pos = i - (tileSize / 2);
+		if (pos < 0) {
+			first[i] = 0;
+			weight[i] = 0;
+		}
+		else if (pos >= ((agc_tiles - 1) * tileSize)) {
+			first[i] = agc_tiles - 2;
+			weight[i] = 256;
+		}
+		else {
+			first[i] = pos / tileSize;
+			weight[i] = ((pos % tileSize) * 256) / tileSize;
+		}
+	}
+}
+
+/* Calculate the tile tables for the raw resolution */
+void agcInitTables() {
+	agcInitAxis(agcTileCol, agcFirstCol, agcWeightCol, rawWidth);
+	agcInitAxis(agcTileRow, agcFirstRow, agcWeightRow, rawHeight);
+	agcTableWidth = rawWidth;
+}
+
+/* Get the output level of a tile map */
+inline uint32_t agcTileLevel(uint16_t* map, uint16_t bin, uint16_t frac, byte shift) {
+	return map[bin] + (((uint32_t)(map[bin + 1] - map[bin]) * frac) >> shift);
+}
+
+/* Create the tile maps from the histograms of the last frame and collect them for the live frame */
+void agcUpdateLocal(bool live) {
+	//Loaded, converted and sent frames are colorized without the maps
+	agcLocalApply = false;
+	if ((!live) || (!agcActive(agcMode_local)) || (!agcRangeValid))
+		return;
+
+	//Create the tile tables at first use or for another sensor
+	byte width = rawWidth;
+	byte height = rawHeight;
+	if (agcTableWidth != width)
+		agcInitTables();
+
+	//New tile maps from the histograms of the last frame
+	if (agcTileHistValid) {
+		uint16_t limit = ((width / agc_tiles) * (height / agc_tiles) * agc_tileClip) / agc_tileBins;
+		if (limit == 0)
+			limit = 1;
+		for (byte i = 0; i < (agc_tiles * agc_tiles); i++)
+			agcBuildMap(agcTileHist[i], agc_tileBins, limit, agcTileMap[i], true, agcTileMapValid);
+		agcTileMapValid = true;
+	}
+	agcLocalApply = agcTileMapValid;
+
+	//Histograms of the raw values for the next frame
+	memset(agcTileHist, 0, sizeof(agcTileHist));
+	byte shift = agcShift + agc_tileShift;
+	for (byte y = 0; y < height; y++) {
+		uint16_t* line = &smallBuffer[y * width];
+		uint16_t (*tileHist)[agc_tileBins] = &agcTileHist[agcTileRow[y] * agc_tiles];
+		for (byte x = 0; x < width; x++)
+			tileHist[agcTileCol[x]][agcOffset(line[x]) >> shift]++;
+	}
+	agcTileHistValid = true;
+}
+
+/* Equalize one line of raw values with the tile maps */
+void agcLocalLine(uint16_t* line, byte y, uint16_t* out) {
+	uint16_t range = 0;
+	if (maxValue > minValue)
+		range = maxValue - minValue;
+	byte shift = agcShift + agc_tileShift;
+	uint16_t fracMask = (1 << shift) - 1;
+	uint16_t (*upper)[agc_tileBins + 1] = &agcTileMap[agcFirstRow[y] * agc_tiles];
+	uint16_t (*lower)[agc_tileBins + 1] = upper + agc_tiles;
+	uint16_t weightY = agcWeightRow[y];
+
+	byte width = rawWidth;
+	for (byte x = 0; x < width; x++) {
+		uint16_t offset = agcOffset(line[x]);
+		uint16_t bin = offset >> shift;
+		uint16_t frac = offset & fracMask;
+
+		//Bilinear interpolation between the maps of the four closest tiles
+		byte left = agcFirstCol[x];
+		uint16_t weightX = agcWeightCol[x];
+		uint32_t top = ((agcTileLevel(upper[left], bin, frac, shift) * (256 - weightX)) +
+			(agcTileLevel(upper[left + 1], bin, frac, shift) * weightX)) >> 8;
+		uint32_t bottom = ((agcTileLevel(lower[left], bin, frac, shift) * (256 - weightX)) +
+			(agcTileLevel(lower[left + 1], bin, frac, shift) * weightX)) >> 8;
+		uint32_t level = ((top * (256 - weightY)) + (bottom * weightY)) >> 8;
+
+		//Spread the level over the limits for the color table
+		out[x] = minValue + ((level * range) >> 16);
+	}
+}
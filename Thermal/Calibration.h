@@ -13,6 +13,28 @@
 *
 */
 
+/* Variables */
+
+//Incremental weighted least squares fit of temperature over raw value
+struct CalFit {
+	//Sum of the sample weights
+	float weight;
+	float meanX;
+	float meanY;
+	//Centered co-moments
+	float sxx;
+	float sxy;
+	float syy;
+	uint16_t count;
+};
+//Fit of the live calibration tracking
+CalFit calTrackFit;
+//Time of the last spot sample used by the tracking
+long calTrackTime = 0;
+//Calibration snapshot of the current frame, centi-degrees in Q16 fixed point
+int32_t calSnapSlope;
+int64_t calSnapOffset;
+
 /* Methods*/
 
 /* Converts a given Temperature in Celcius to Fahrenheit */
@@ -52,48 +74,159 @@ uint16_t tempToRaw(float temp) {
 	return rawValue;
 }
 
-/* Calculates the average of the 196 (14x14) pixels in the middle */
-uint16_t calcAverage() {
-	int sum = 0;
-	for (byte vert = 52; vert < 66; vert++) {
-		for (byte horiz = 72; horiz < 86; horiz++) {
-			uint16_t val = smallBuffer[(vert * 160) + horiz];
-			//If one of the values contains hotter or colder values than the lepton can handle
-			if ((val == 16383) || (val == 0))
-				//Do not use that calibration set!
-				return 0;
-			sum += val;
-		}
+/* Take a fixed point snapshot of the calibration for the current frame */
+void calSnapshot() {
+	//Calculate offset out of ambient temp
+	if ((calStatus != cal_manual) && (autoMode) && (!limitsLocked))
+		calOffset = mlx90614_amb - (calSlope * 8192) + calComp;
+
+	//Centi-degrees, the Fahrenheit conversion is folded into the coefficients
+	float slope = calSlope * 100;
+	float offset = calOffset * 100;
+	if (tempFormat == tempFormat_fahrenheit) {
+		slope *= 1.8f;
+		offset = (offset * 1.8f) + 3200;
+	}
+
+	//Q16 with rounding to the nearest centi-degree
+	calSnapSlope = (int32_t)roundf(slope * 65536);
+	calSnapOffset = (int64_t)roundf(offset * 65536) + 32768;
+}
+
+/* Get the temperature of a raw value in centi-degrees from the snapshot */
+int32_t calSnapCenti(uint16_t rawValue) {
+	return (int32_t)((((int64_t)rawValue * calSnapSlope) + calSnapOffset) >> 16);
+}
+
+/* Get the raw value of a temperature in centi-degrees from the snapshot */
+uint16_t calSnapRaw(int32_t centi) {
+	//Invalid calibration
+	if (calSnapSlope <= 0)
+		return 0;
+	int64_t rawValue = ((((int64_t)centi) << 16) - calSnapOffset + 32768) / calSnapSlope;
+	return constrain(rawValue, 0, 65535);
+}
+
+/* Add a weighted sample to the fit, older samples are scaled by the forgetting factor */
+void calFitAdd(CalFit* fit, float x, float y, float weight, float forget) {
+	fit->weight *= forget;
+	fit->sxx *= forget;
+	fit->sxy *= forget;
+	fit->syy *= forget;
+	fit->weight += weight;
+
+	//Update means and co-moments in one step, stable in single precision
+	float dx = x - fit->meanX;
+	float dy = y - fit->meanY;
+	fit->meanX += (weight / fit->weight) * dx;
+	fit->meanY += (weight / fit->weight) * dy;
+	fit->sxx += weight * dx * (x - fit->meanX);
+	fit->sxy += weight * dx * (y - fit->meanY);
+	fit->syy += weight * dy * (y - fit->meanY);
+	fit->count++;
+}
+
+/* Get the Huber weight of a new sample against the current fit */
+float calFitWeight(CalFit* fit, float x, float y) {
+	//Not enough samples to judge outliers
+	if ((fit->count < cal_robustMin) || (fit->sxx <= 0))
+		return 1;
+
+	//Residual and its standard deviation of the current fit
+	float slope = fit->sxy / fit->sxx;
+	float residual = fabsf(y - (fit->meanY + (slope * (x - fit->meanX))));
+	float sigma = sqrtf(max((fit->syy - (slope * fit->sxy)) / fit->weight, 0.0f));
+
+	//Full weight inside the limit, decreasing outside
+	float limit = cal_huberK * max(sigma, cal_minSigma);
+	if (residual <= limit)
+		return 1;
+	return limit / residual;
+}
+
+/* Calculate slope, offset and correlation, returns false if the fit is singular */
+bool calFitSolve(CalFit* fit, float* slope, float* offset, float* correlation) {
+	if ((fit->count < 2) || (fit->sxx <= 0)) {
+		*slope = 0;
+		*offset = 0;
+		*correlation = 0;
+		return false;
 	}
-	uint16_t avg = (uint16_t)(sum / 196.0);
-	return avg;
+	*slope = fit->sxy / fit->sxx;
+	*offset = fit->meanY - (*slope * fit->meanX);
+	*correlation = (fit->syy > 0) ? fit->sxy / sqrtf(fit->sxx * fit->syy) : 0;
+	return true;
+}
+
+/* Refine the manual calibration with spot sensor and center pixels during live mode */
+void calTrack() {
+	//Start again when enabled
+	if (!calTracking) {
+		if (calTrackFit.count != 0)
+			memset(&calTrackFit, 0, sizeof(calTrackFit));
+		return;
+	}
+
+	//Only for a manual calibration and a new spot sample
+	if ((calStatus != cal_manual) || (mlx90614_objTime == calTrackTime) || (frameStats.centerAverage == 0))
+		return;
+	calTrackTime = mlx90614_objTime;
+	//The cached object temp is too old for the current frame
+	if (mlx90614_stale(mlx90614_objTime))
+		return;
+
+	//Old samples fade out, so the fit follows sensor drift
+	float x = frameStats.centerAverage;
+	calFitAdd(&calTrackFit, x, mlx90614_object, calFitWeight(&calTrackFit, x, mlx90614_object), cal_trackForget);
+	if (calTrackFit.count < cal_trackMin)
+		return;
+
+	//Enough contrast in the scene, refine slope and offset
+	float slope, offset, correlation;
+	if (((calTrackFit.sxx / calTrackFit.weight) >= cal_trackSpread) &&
+		calFitSolve(&calTrackFit, &slope, &offset, &correlation) && (correlation >= cal_converged)) {
+		//Limit the slope to a plausible range around the standard slope
+		calSlope = constrain(slope, cal_stdSlope * (1 - cal_trackSlope), cal_stdSlope * (1 + cal_trackSlope));
+		calOffset = calTrackFit.meanY - (calSlope * calTrackFit.meanX);
+	}
+	//Otherwise only follow the offset
+	else
+		calOffset = calTrackFit.meanY - (calSlope * calTrackFit.meanX);
 }
 
 /* Compensate the calibration with object temp */
 void compensateCalib() {
-	//Refresh MLX90614 ambient temp
-	mlx90614_getAmb();
-	///Refresh object temperature
-	mlx90614_getTemp();
+	//Read the spot sensor in the background, the filtered values are always ready
+	mlx90614_update();
+	//Take the cached object temperature
+	mlx90614_temp = mlx90614_object;
 	//Convert to Fahrenheit if needed
 	if (tempFormat == tempFormat_fahrenheit)
 		mlx90614_temp = celciusToFahrenheit(mlx90614_temp);
 
 	//Apply compensation if auto mode enabled, no limited locked and standard calib
 	if ((autoMode) && (!limitsLocked) && (calStatus != cal_warmup)) {
+		//No valid object or ambient temp for some time, fall back to the uncompensated calibration
+		if (mlx90614_stale(mlx90614_objTime) || mlx90614_stale(mlx90614_ambTime))
+			calComp = 0;
 		//Calculate min & max
-		int16_t min = round(calFunction(minValue));
-		int16_t max = round(calFunction(maxValue));
-		//If spot temp is lower than current minimum by one degree, lower minimum
-		if (mlx90614_temp < (min - 1))
-			calComp = mlx90614_temp - min;
-		//If spot temp is higher than current maximum by one degree, raise maximum
-		else if (mlx90614_temp > (max + 1))
-			calComp = mlx90614_temp - max;
+		else {
+			int16_t min = round(calFunction(minValue));
+			int16_t max = round(calFunction(maxValue));
+			//If spot temp is lower than current minimum by one degree, lower minimum
+			if (mlx90614_temp < (min - 1))
+				calComp += mlx90614_temp - min;
+			//If spot temp is higher than current maximum by one degree, raise maximum
+			else if (mlx90614_temp > (max + 1))
+				calComp += mlx90614_temp - max;
+		}
 	}
 	//Calculate offset out of ambient temp
 	if ((calStatus != cal_manual) && (autoMode) && (!limitsLocked))
 		calOffset = mlx90614_amb - (calSlope * 8192) + calComp;
+
+	//Follow the drift of a manual calibration
+	calTrack();
 }
 
 /* Checks if the calibration warmup is done */
@@ -104,51 +237,12 @@ void checkWarmup() {
 		calStatus = cal_standard;
 }
 
-/* Help function for least suqare fit */
-inline static double sqr(double x) {
-	return x*x;
-}
-
-/* Least square fit */
-int linreg(int n, const uint16_t x[], const float y[], float* m, float* b, float* r)
-{
-	double   sumx = 0.0;
-	double   sumx2 = 0.0;
-	double   sumxy = 0.0;
-	double   sumy = 0.0;
-	double   sumy2 = 0.0;
-	for (int i = 0; i < n; i++)
-	{
-		sumx += x[i];
-		sumx2 += sqr(x[i]);
-		sumxy += x[i] * y[i];
-		sumy += y[i];
-		sumy2 += sqr(y[i]);
-	}
-	double denom = (n * sumx2 - sqr(sumx));
-	if (denom == 0) {
-		//singular matrix. can't solve the problem.
-		*m = 0;
-		*b = 0;
-		*r = 0;
-		return 1;
-	}
-	*m = (n * sumxy - sumx * sumy) / denom;
-	*b = (sumy * sumx2 - sumx * sumxy) / denom;
-	if (r != NULL) {
-		*r = (sumxy - sumx * sumy / n) /
-			sqrt((sumx2 - sqr(sumx) / n) *
-			(sumy2 - sqr(sumy) / n));
-	}
-	return 0;
-}
-
 /* Run the calibration process */
 void calibrationProcess(bool serial, bool firstStart) {
 	//Variables
-	float calMLX90614[100];
-	uint16_t calLepton[100];
+	CalFit fit;
 	float calCorrelation;
+	float lastSlope;
 	char result[30];
 	uint16_t average;
 	uint16_t average_old = 0;
@@ -162,15 +256,17 @@ void calibrationProcess(bool serial, bool firstStart) {
 		if (!serial)
 			calibrationScreen(firstStart);
 
-		//Reset counter to zero
+		//Reset counter and fit to zero
 		int counter = 0;
+		memset(&fit, 0, sizeof(fit));
+		lastSlope = 0;
 
 		//Perform FFC if shutter is attached
 		if (leptonShutter != leptonShutter_none)
 			lepton_ffc();
 
-		//Get 100 different calibration samples
-		while (counter < 100) {
+		//Get up to 100 different calibration samples
+		while (counter < cal_maxSamples) {
 			//Store time elapsed
 			long timeElapsed = millis();
 
@@ -181,7 +277,8 @@ void calibrationProcess(bool serial, bool firstStart) {
 				//Get temperatures
 				lepton_getRawValues();
 				//Calculate the average
-				average = calcAverage();
+				calcFrameStats();
+				average = frameStats.centerAverage;
 			} while ((average == average_old) || (average == 0));
 
 			//Store old average
@@ -189,9 +286,8 @@ void calibrationProcess(bool serial, bool firstStart) {
 
 			//If the temperature changes too much, do not take that measurement
 			if (abs(mlx90614_getTemp() - mlx90614_old) < 10) {
-				//Store values
-				calLepton[counter] = average;
-				calMLX90614[counter] = mlx90614_temp;
+				//Update the fit, outliers get a lower weight
+				calFitAdd(&fit, average, mlx90614_temp, calFitWeight(&fit, average, mlx90614_temp), 1);
 
 				//Find minimum and maximum value
 				if (average > maxValue)
@@ -212,6 +308,14 @@ void calibrationProcess(bool serial, bool firstStart) {
 
 				//Raise counter
 				counter++;
+
+				//Stop early when the fit has converged, serial mode keeps the sample count
+				if (((counter % 10) == 0) && (counter >= cal_minSamples) && !serial) {
+					calFitSolve(&fit, &calSlope, &calOffset, &calCorrelation);
+					if ((calCorrelation >= cal_converged) && (fabsf(calSlope - lastSlope) < (0.01f * calSlope)))
+						break;
+					lastSlope = calSlope;
+				}
 			}
 
 			//Store old spot temperature
@@ -229,8 +333,8 @@ void calibrationProcess(bool serial, bool firstStart) {
 			}
 		}
 
-		//Calculate the calibration formula with least square fit
-		linreg(100, calLepton, calMLX90614, &calSlope, &calOffset, &calCorrelation);
+		//Calculate the calibration formula from the fit
+		calFitSolve(&fit, &calSlope, &calOffset, &calCorrelation);
 
 		//Set calibration to manual
 		calStatus = cal_manual;
@@ -238,6 +342,9 @@ void calibrationProcess(bool serial, bool firstStart) {
 		//Set compensation to zero
 		calComp = 0;
 
+		//Start the live tracking from the new calibration
+		memset(&calTrackFit, 0, sizeof(calTrackFit));
+
 		//When in serial mode, store and send ACK
 		if (serial)
 		{
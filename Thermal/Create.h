@@ -13,82 +13,168 @@
 *
 */
 
+/* Defines */
+
+//Flags of the remap tables, the lower bits are the source index
+#define remap_fill  0x8000
+#define remap_white 0x4000
+#define remap_index 0x3FFF
+
+//Order of the upscaler, interpolate raw values or colors
+#define upscale_values 0
+#define upscale_colors 1
+//Order per mode, colorizing first was faster for both modes in the timing report of the host tests
+#define upscale_thermalOrder  upscale_colors
+#define upscale_combinedOrder upscale_colors
+
+//Green, red and blue of a RGB565 color spread with room for the interpolation
+#define upscale_spreadMask  0x07E0F81F
+//Half of the 5-bit weight for every channel, to round after the interpolation
+#define upscale_spreadRound 0x02008010
+
+/* Variables */
+
+//Raw value to RGB565 lookup table for the current limits
+uint16_t colorLUT[1024];
+//Raw values per table entry as bit shift
+byte colorLUTShift;
+//Settings the lookup table has been created for
+bool colorLUTValid = false;
+uint16_t colorLUTMin;
+uint16_t colorLUTMax;
+const byte* colorLUTMap;
+int16_t colorLUTElements;
+byte colorLUTHotColdMode;
+byte colorLUTHotColdColor;
+uint16_t colorLUTHotColdLevel;
+bool colorLUTEqualize;
+uint16_t colorLUTAgcVersion;
+
+//Source index and 8-bit weight of the raw resolution to 320x240 upscaler
+byte upscaleX[320];
+byte upscaleWeightX[320];
+byte upscaleY[240];
+byte upscaleWeightY[240];
+//Raw width the tables were calculated for, zero if not yet
+byte upscaleWidth = 0;
+//The big buffer already holds the colors of the upscaler
+bool upscaleColored = false;
+
+//Source column and row with flags to align the combined image
+uint16_t remapX[320];
+uint16_t remapY[240];
+//First column and row that is not read from further left or up
+uint16_t remapMidX;
+uint16_t remapMidY;
+//The tables do not change the image
+bool remapIdentity;
+//Settings the tables have been calculated for, zero width if not yet
+uint16_t remapWidth = 0;
+float remapFactor;
+byte remapLeft;
+byte remapRight;
+byte remapUp;
+byte remapDown;
+bool remapRotation;
+
 /* Methods*/
 
-/* Filter a 160x120 smallBuffer with 3x3 gaussian kernel */
-void gaussianFilter() {
-	byte gaussianKernel[3][3] = {
-		{ 1, 2, 1 },
-		{ 2, 4, 2 },
-		{ 1, 2, 1 }
-	};
-	long sum;
-
-	for (int y = 1; y < 119; y++) {
-		for (int x = 1; x < 159; x++) {
-			sum = 0;
-			for (int k = -1; k <= 1; k++) {
-				for (int j = -1; j <= 1; j++) {
-					sum += gaussianKernel[j + 1][k + 1] * smallBuffer[(y - j) * 160 + (x - k)];
-				}
-			}
-			smallBuffer[(y * 160) + x] = (unsigned short)(sum / 16.0);
-		}
-	}
-}
+/* Get the RGB565 color of a raw value from the lookup table */
+inline uint16_t colorLUTLookup(uint16_t value) {
+	//Limit values
+	uint16_t range = 0;
+	if (colorLUTMax > colorLUTMin)
+		range = colorLUTMax - colorLUTMin;
+	uint16_t offset;
+	if (value <= colorLUTMin)
+		offset = 0;
+	else if ((value - colorLUTMin) >= range)
+		offset = range;
+	else
+		offset = value - colorLUTMin;
 
-/* Filter a 160x120 smallBuffer with a 3x3 box kernel */
-void boxFilter() {
-	byte boxKernel[3][3] = {
-		{ 1, 1, 1 },
-		{ 1, 1, 1 },
-		{ 1, 1, 1 }
-	};
-	long sum;
-
-	for (int y = 1; y < 119; y++) {
-		for (int x = 1; x < 159; x++) {
-			sum = 0;
-			for (int k = -1; k <= 1; k++) {
-				for (int j = -1; j <= 1; j++) {
-					sum += boxKernel[j + 1][k + 1] * smallBuffer[(y - j) * 160 + (x - k)];
-				}
-			}
-			smallBuffer[(y * 160) + x] = (unsigned short)(sum / 9.0);
-		}
-	}
+	return colorLUT[offset >> colorLUTShift];
 }
 
-//Resize the pixels of thermal smallBuffer
-void resizePixels(unsigned short* pixels, int w1, int h1, int w2, int h2) {
-	//Calculate the ratio
-	int x_ratio = (int)((w1 << 16) / w2) + 1;
-	int y_ratio = (int)((h1 << 16) / h2) + 1;
-	int x2, y2;
-	for (int i = 0; i < h2; i++) {
-		for (int j = 0; j < w2; j++) {
-			x2 = ((j * x_ratio) >> 16);
-			y2 = ((i * y_ratio) >> 16);
-			pixels[(i * w1) + j] = pixels[(y2 * w1) + x2];
-		}
-	}
-	//Set the other pixels to zero
-	for (int j = 0; j < h2; j++) {
-		for (int i = w2; i < w1; i++) {
-			pixels[i + (j * w1)] = 65535;
+/* Calculate the remap tables for the current alignment settings */
+void initRemapTables(uint16_t width, uint16_t height) {
+	//The visual image is aligned in 320x240, the thermal one in 160x120
+	bool big = (width == 320);
+	uint16_t newWidth = round(adjCombFactor * width);
+	uint16_t newHeight = round(adjCombFactor * height);
+	uint32_t ratioX = ((uint32_t)width << 16) / newWidth + 1;
+	uint32_t ratioY = ((uint32_t)height << 16) / newHeight + 1;
+	uint16_t rightMove = round((width - newWidth) / 2.0);
+	uint16_t downMove = round((height - newHeight) / 2.0);
+	//Borders outside the decoded visual image, the rotated image is decoded from the end of the buffer
+	uint16_t edgeLeft = 5 * (rotationEnabled ? adjCombLeft : adjCombRight);
+	uint16_t edgeRight = (width - 1) - (5 * (rotationEnabled ? adjCombRight : adjCombLeft));
+	uint16_t edgeTop = 5 * (rotationEnabled ? adjCombUp : adjCombDown);
+	uint16_t edgeBottom = (height - 1) - (5 * (rotationEnabled ? adjCombDown : adjCombUp));
+
+	remapIdentity = true;
+	remapMidX = width;
+	for (uint16_t x = 0; x < width; x++) {
+		uint16_t entry = remap_white;
+		//Inside the resized image
+		if ((x >= rightMove) && (x < rightMove + newWidth)) {
+			uint16_t src = ((x - rightMove) * ratioX) >> 16;
+			//The visual image has no data at the borders
+			if (!big || ((src >= edgeLeft) && (src <= edgeRight)))
+				entry = src;
+			//Pixels left of this one are read from further left
+			if ((src >= x) && (remapMidX == width))
+				remapMidX = x;
 		}
+		//The thermal image is filled at the borders
+		if (!big && ((x < edgeLeft) || (x > edgeRight)))
+			entry |= remap_fill;
+		remapX[x] = entry;
+		if (entry != x)
+			remapIdentity = false;
 	}
-	for (int j = h2; j < h1; j++) {
-		for (int i = 0; i < w1; i++) {
-			pixels[i + (j * w1)] = 65535;
+
+	remapMidY = height;
+	for (uint16_t y = 0; y < height; y++) {
+		uint16_t entry = remap_white;
+		if ((y >= downMove) && (y < downMove + newHeight)) {
+			uint16_t src = ((y - downMove) * ratioY) >> 16;
+			if (!big || ((src >= edgeTop) && (src <= edgeBottom)))
+				entry = src;
+			if ((src >= y) && (remapMidY == height))
+				remapMidY = y;
 		}
+		if (!big && ((y < edgeTop) || (y > edgeBottom)))
+			entry |= remap_fill;
+		remapY[y] = entry;
+		if (entry != y)
+			remapIdentity = false;
 	}
+
+	//Remember the settings
+	remapWidth = width;
+	remapFactor = adjCombFactor;
+	remapLeft = adjCombLeft;
+	remapRight = adjCombRight;
+	remapUp = adjCombUp;
+	remapDown = adjCombDown;
+	remapRotation = rotationEnabled;
 }
 
-/* Resize the thermal smallBuffer */
+/* Get one pixel of the aligned image */
+inline uint16_t remapPixel(uint16_t* line, uint16_t entryX, uint16_t entryY, bool blend) {
+	uint16_t flags = entryX | entryY;
+	uint16_t pixel = (flags & remap_white) ? 65535 : line[entryX & remap_index];
+	//Visual - set to black, combined - mix the thermal image with grey
+	if (flags & remap_fill)
+		pixel = blend ? camera_blend(pixel, 0x7BEF) : 0;
+	return pixel;
+}
+
+/* Resize, move and fill the visual or thermal image in one pass */
 void resizeImage() {
-	uint16_t  xmax, ymax;
-	unsigned short* pixelBuffer;
+	uint16_t xmax, ymax;
+	uint16_t* pixelBuffer;
 
 	//For 160x120
 	if ((teensyVersion == teensyVersion_old) || (!hqRes))
@@ -105,170 +191,201 @@ void resizeImage() {
 		pixelBuffer = bigBuffer;
 	}
 
-	uint16_t newWidth = round(adjCombFactor * xmax);
-	uint16_t newHeight = round(adjCombFactor * ymax);
-
-	//Resize pixels
-	resizePixels(pixelBuffer, xmax, ymax, newWidth, newHeight);
-
-	//Move the smallBuffer right
-	uint16_t rightMove = round((xmax - newWidth) / 2.0);
-	for (int i = 0; i < rightMove; i++) {
-		//First for all pixels
-		for (int col = (xmax - 1); col > 0; col--)
-			for (int row = 0; row < ymax; row++)
-				pixelBuffer[col + (row * xmax)] = pixelBuffer[col - 1 + (row * xmax)];
-		//And then fill the last one with white
-		for (int row = 0; row < ymax; row++)
-			pixelBuffer[row * xmax] = 65535;
-	}
-	//Move the smallBuffer down
-	uint16_t downMove = round((ymax - newHeight) / 2.0);
-	for (int i = 0; i < downMove; i++) {
-		//First for all pixels
-		for (int col = 0; col < xmax; col++)
-			for (int row = (ymax - 1); row > 0; row--)
-				pixelBuffer[col + (row * xmax)] = pixelBuffer[col + ((row - 1) * xmax)];
-		//And then fill the last one with white
-		for (int col = 0; col < xmax; col++)
-			pixelBuffer[col] = 65535;
+	//Recalculate the tables when the alignment has been changed
+	if ((remapWidth != xmax) || (remapFactor != adjCombFactor) || (remapLeft != adjCombLeft) ||
+		(remapRight != adjCombRight) || (remapUp != adjCombUp) || (remapDown != adjCombDown) ||
+		(remapRotation != rotationEnabled))
+		initRemapTables(xmax, ymax);
+
+	//Nothing to move
+	if (remapIdentity)
+		return;
+
+	bool blend = (displayMode == displayMode_combined);
+	if (blend)
+		camera_updateAlpha();
+
+	//Work from the fixed center outwards, so every source pixel is read before it is overwritten
+	for (uint16_t i = 0; i < ymax; i++) {
+		uint16_t y = (i < remapMidY) ? (remapMidY - 1 - i) : i;
+		uint16_t entryY = remapY[y];
+		uint16_t* line = &pixelBuffer[(entryY & remap_index) * xmax];
+		uint16_t* out = &pixelBuffer[y * xmax];
+
+		for (uint16_t x = remapMidX; x > 0; x--)
+			out[x - 1] = remapPixel(line, remapX[x - 1], entryY, blend);
+		for (uint16_t x = remapMidX; x < xmax; x++)
+			out[x] = remapPixel(line, remapX[x], entryY, blend);
 	}
 }
 
-/* Calculates the fill pixel for visual/combined */
-void calcFillPixel(uint16_t x, uint16_t y) {
-	uint16_t pixel;
-	byte red, green, blue;
-
-	//Combined - set to darker thermal
-	if (displayMode == displayMode_combined) {
-		//Get the thermal image color
-		pixel = smallBuffer[x + (y * 160)];
-		//And extract the RGB values out of it
-		byte redT = (pixel & 0xF800) >> 8;
-		byte greenT = (pixel & 0x7E0) >> 3;
-		byte blueT = (pixel & 0x1F) << 3;
-		//Mix both
-		red = (byte)redT * (1 - adjCombAlpha) + 127 * adjCombAlpha;
-		green = (byte)greenT * (1 - adjCombAlpha) + 127 * adjCombAlpha;
-		blue = (byte)blueT * (1 - adjCombAlpha) + 127 * adjCombAlpha;
-	}
-	//Visual - set to black
-	else {
-		red = 0;
-		green = 0;
-		blue = 0;
+/* Calculate the source positions and weights of the upscaler for the raw resolution */
+void initUpscaleTables() {
+	//Columns, (width - 1) / 320 ratio with 8 fractional bits
+	for (uint16_t j = 0; j < 320; j++) {
+		uint32_t pos = (j * (rawWidth - 1) * 256) / 320;
+		upscaleX[j] = pos >> 8;
+		upscaleWeightX[j] = pos & 0xFF;
 	}
-
-	//Set image to that calculated RGB565 value
-	pixel = (((red & 248) | green >> 5) << 8)
-		| ((green & 28) << 3 | blue >> 3);
-	//Save
-	smallBuffer[x + (y * 160)] = pixel;
+	//Rows, (height - 1) / 240 ratio with 8 fractional bits
+	for (uint16_t i = 0; i < 240; i++) {
+		uint32_t pos = (i * (rawHeight - 1) * 256) / 240;
+		upscaleY[i] = pos >> 8;
+		upscaleWeightY[i] = pos & 0xFF;
+	}
+	upscaleWidth = rawWidth;
 }
 
-/* Fill out the edges in combined or visual mode */
-void fillEdges() {
-	//Fill the edges
-	uint16_t  x, y;
+/* Upscale the raw values, the colors are done at 320x240, eventually add transparency */
+void upscaleValues(bool trans)
+{
+	//Raw width of the tables
+	byte width = upscaleWidth;
+
+	//For transparency, colorize with the lookup table and mix with fixed alpha
+	uint16_t thermal = 0;
+	if (trans) {
+		updateColorLUT();
+		camera_updateAlpha();
+	}
 
-	//Top & Bottom edges
-	for (x = 0; x < 160; x++) {
-		//Top edge
-		for (y = 0; y < (5 * adjCombDown); y++) {
-			calcFillPixel(x, y);
+	//Two locally equalized source lines, a line keeps its slot by the parity of its number
+	uint16_t local[2][160];
+	int16_t localNumber[2] = { -1, -1 };
+
+	uint32_t offset = 0;
+	for (byte i = 0; i < 240; i++) {
+		//Two source lines and their weight
+		byte y = upscaleY[i];
+		uint16_t* line0 = &smallBuffer[y * width];
+		uint16_t* line1 = line0 + width;
+		uint16_t weightY = upscaleWeightY[i];
+
+		//Equalize the two source lines if not done for the last row
+		if (agcLocalApply) {
+			for (byte k = 0; k < 2; k++) {
+				byte slot = (y + k) & 1;
+				if (localNumber[slot] != y + k) {
+					agcLocalLine(&smallBuffer[(y + k) * width], y + k, local[slot]);
+					localNumber[slot] = y + k;
+				}
+			}
+			line0 = local[y & 1];
+			line1 = local[(y + 1) & 1];
 		}
 
-		//Bottom edge
-		for (y = 119; y > (119 - (5 * adjCombUp)); y--) {
-			calcFillPixel(x, y);
-		}
-	}
+		for (uint16_t j = 0; j < 320; j++) {
+			byte x = upscaleX[j];
+			uint16_t weightX = upscaleWeightX[j];
 
-	//Left & right edges
-	for (y = 5 * adjCombDown; y < (120 - (5 * adjCombUp)); y++) {
-		//Left edge
-		for (x = 0; x < (5 * adjCombRight); x++) {
-			calcFillPixel(x, y);
-		}
+			//Bilinear interpolation, first along x and then along y
+			uint32_t top = (line0[x] * (256 - weightX)) + (line0[x + 1] * weightX);
+			uint32_t bottom = (line1[x] * (256 - weightX)) + (line1[x + 1] * weightX);
+			uint16_t outVal = ((top * (256 - weightY)) + (bottom * weightY) + 32768) >> 16;
+
+			//No alpha transparency, just write into the framebuffer
+			if (trans == false)
+				bigBuffer[offset] = outVal;
+
+			//Keep the first thermal color until its neighbour is there
+			else if ((j & 1) == 0)
+				thermal = colorLUTLookup(outVal);
+
+			//Blend both pixels with the visual image at once
+			else
+			{
+				uint32_t pixels = thermal | ((uint32_t)colorLUTLookup(outVal) << 16);
+				uint32_t visual = bigBuffer[offset - 1] | ((uint32_t)bigBuffer[offset] << 16);
+				pixels = camera_blend2(pixels, visual);
+				bigBuffer[offset - 1] = pixels;
+				bigBuffer[offset] = pixels >> 16;
+			}
 
-		//Right edge
-		for (x = 159; x > (159 - (5 * adjCombLeft)); x--) {
-			calcFillPixel(x, y);
+			//Raise counter
+			offset++;
 		}
 	}
 }
 
+/* Spread a RGB565 color, so that all channels are interpolated at once */
+inline uint32_t upscaleSpread(uint16_t color) {
+	return (color | ((uint32_t)color << 16)) & upscale_spreadMask;
+}
 
-/* Write the smallBuffer to the bigBuffer by resizing, eventually add transparency */
-void smallToBigBuffer(bool trans)
+/* Interpolate two spread colors with a 5-bit weight */
+inline uint32_t upscaleLerp(uint32_t first, uint32_t second, byte weight) {
+	return (((first * (32 - weight)) + (second * weight) + upscale_spreadRound) >> 5) & upscale_spreadMask;
+}
+
+/* Colorize one line of the smallBuffer as spread colors */
+void upscaleColorLine(uint32_t* line, byte y) {
+	byte width = upscaleWidth;
+	uint16_t* src = &smallBuffer[y * width];
+
+	//Local equalization of the live image
+	uint16_t local[160];
+	if (agcLocalApply) {
+		agcLocalLine(src, y, local);
+		src = local;
+	}
+
+	for (byte x = 0; x < width; x++)
+		line[x] = upscaleSpread(colorLUTLookup(src[x]));
+}
+
+/* Colorize at the raw resolution and upscale the colors, eventually add transparency */
+void upscaleColors(bool trans)
 {
-	unsigned short A, B, C, D, outVal;
-	int x, y, index;
-	float x_ratio = 159.0 / 320;
-	float y_ratio = 119.0 / 240;
-	float x_diff, y_diff;
-	//For transparency
-	byte redV, greenV, blueV, redT, greenT, blueT, red, green, blue;
-	uint16_t value;
-	float scale = (colorElements - 1.0) / (maxValue - minValue);
-
-	int offset = 0;
-	for (int i = 0; i < 240; i++) {
-		for (int j = 0; j < 320; j++) {
-
-			x = (int)(x_ratio * j);
-			y = (int)(y_ratio * i);
-			x_diff = (x_ratio * j) - x;
-			y_diff = (y_ratio * i) - y;
-			index = y * 160 + x;
-
-			A = smallBuffer[index];
-			B = smallBuffer[index + 1];
-			C = smallBuffer[index + 160];
-			D = smallBuffer[index + 160 + 1];
-
-			outVal = (unsigned short)(
-				A*(1 - x_diff)*(1 - y_diff) + B*(x_diff)*(1 - y_diff) +
-				C*(y_diff)*(1 - x_diff) + D*(x_diff*y_diff)
-				);
+	//Two colorized source lines, a line keeps its slot by the parity of its number
+	uint32_t lines[2][160];
+	int16_t lineNumber[2] = { -1, -1 };
+	uint16_t thermal = 0;
+
+	updateColorLUT();
+	if (trans)
+		camera_updateAlpha();
+
+	uint32_t offset = 0;
+	for (byte i = 0; i < 240; i++) {
+		//Colorize the two source lines if not done for the last row
+		byte y = upscaleY[i];
+		for (byte k = 0; k < 2; k++) {
+			byte slot = (y + k) & 1;
+			if (lineNumber[slot] != y + k) {
+				upscaleColorLine(lines[slot], y + k);
+				lineNumber[slot] = y + k;
+			}
+		}
+		uint32_t* line0 = lines[y & 1];
+		uint32_t* line1 = lines[(y + 1) & 1];
+		byte weightY = (upscaleWeightY[i] + 4) >> 3;
+
+		for (uint16_t j = 0; j < 320; j++) {
+			byte x = upscaleX[j];
+			byte weightX = (upscaleWeightX[j] + 4) >> 3;
+
+			//Bilinear interpolation of all channels, first along x and then along y
+			uint32_t top = upscaleLerp(line0[x], line0[x + 1], weightX);
+			uint32_t bottom = upscaleLerp(line1[x], line1[x + 1], weightX);
+			uint32_t spread = upscaleLerp(top, bottom, weightY);
+			uint16_t color = spread | (spread >> 16);
 
 			//No alpha transparency, just write into the framebuffer
-			if (trans == false)
-				bigBuffer[offset] = outVal;
+			if (!trans)
+				bigBuffer[offset] = color;
+
+			//Keep the first thermal color until its neighbour is there
+			else if ((j & 1) == 0)
+				thermal = color;
 
-			//We want to create a combined bigBuffer
+			//Blend both pixels with the visual image at once
 			else
 			{
-				//Limit values
-				if (outVal > maxValue)
-					outVal = maxValue;
-				if (outVal < minValue)
-					outVal = minValue;
-
-				//Calc color position
-				value = (outVal - minValue) * scale;
-
-				//Calc RGB color values for thermal smallBuffer
-				redT = colorMap[3 * value];
-				greenT = colorMap[3 * value + 1];
-				blueT = colorMap[3 * value + 2];
-
-				//Get the RGB565 color of the visual smallBuffer
-				value = bigBuffer[offset];
-
-				//And extract the RGB values out of it
-				redV = (value & 0xF800) >> 8;
-				greenV = (value & 0x7E0) >> 3;
-				blueV = (value & 0x1F) << 3;
-
-				//Mix both
-				red = redT * (1 - adjCombAlpha) + redV * adjCombAlpha;
-				green = greenT * (1 - adjCombAlpha) + greenV * adjCombAlpha;
-				blue = blueT * (1 - adjCombAlpha) + blueV * adjCombAlpha;
-
-				//Convert to RGB565
-				bigBuffer[offset] = (((red & 248) | green >> 5) << 8) | ((green & 28) << 3 | blue >> 3);
+				uint32_t pixels = thermal | ((uint32_t)color << 16);
+				uint32_t visual = bigBuffer[offset - 1] | ((uint32_t)bigBuffer[offset] << 16);
+				pixels = camera_blend2(pixels, visual);
+				bigBuffer[offset - 1] = pixels;
+				bigBuffer[offset] = pixels >> 16;
 			}
 
 			//Raise counter
@@ -277,6 +394,24 @@ void smallToBigBuffer(bool trans)
 	}
 }
 
+/* Write the smallBuffer to the bigBuffer by resizing, eventually add transparency */
+void smallToBigBuffer(bool trans)
+{
+	//The big buffer may still be sent to the screen
+	display_waitScreen();
+
+	//Create the weight tables at first use or for another sensor
+	if (upscaleWidth != rawWidth)
+		initUpscaleTables();
+
+	//Colors are done here or by converting the big buffer afterwards
+	upscaleColored = ((trans ? upscale_combinedOrder : upscale_thermalOrder) == upscale_colors);
+	if (upscaleColored)
+		upscaleColors(trans);
+	else
+		upscaleValues(trans);
+}
+
 /* Clears the temperature points array */
 void clearTempPoints() {
 	//Go through the array
@@ -321,7 +456,7 @@ void showTemperatures() {
 				ypos = 229;
 
 			//Display the absolute temperature
-			display_printNumF(calFunction(tempPoints[i][1]), 2, xpos, ypos);
+			display_printNumF(calSnapCenti(tempPoints[i][1]) / 100.0, 2, xpos, ypos);
 		}
 	}
 }
@@ -480,23 +615,122 @@ redraw:
 	delay(1000);
 }
 
-/* Go through the array of temperatures and find min and max temp */
-void limitValues() {
-	maxValue = 0;
-	minValue = 65535;
-	uint16_t temp;
-	for (int i = 0; i < 19200; i++) {
-		//Get value
-		temp = smallBuffer[i];
-		//Find maximum temp
-		if (temp > maxValue)
-			maxValue = temp;
-		//Find minimum temp
-		if (temp < minValue)
-			minValue = temp;
+/* Get the raw value index of a 160x120 pixel index */
+inline uint16_t toRawIndex(uint16_t index) {
+	if (leptonVersion == leptonVersion_3_shutter)
+		return index;
+	//Lepton2 values cover 2x2 pixels
+	return ((index / 320) * 80) + ((index % 160) / 2);
+}
+
+/* Get the 160x120 pixel index of a raw value index */
+inline uint16_t toPixelIndex(uint16_t index) {
+	if (leptonVersion == leptonVersion_3_shutter)
+		return index;
+	return ((index / 80) * 320) + ((index % 80) * 2);
+}
+
+/* Collect min, max, histogram, sums and temp points of the smallBuffer in one pass */
+void calcFrameStats() {
+	uint16_t minVal = 65535;
+	uint16_t maxVal = 0;
+	uint16_t minPos = 0;
+	uint16_t maxPos = 0;
+	uint32_t sum = 0;
+	uint64_t sumSquares = 0;
+
+	//Clear the histogram
+	memset(frameStats.histogram, 0, sizeof(frameStats.histogram));
+
+	//Histogram for the AGC over the range of the last frames
+	bool agcCollect = agcEnabled();
+	if (agcCollect)
+		memset(agcHist, 0, sizeof(agcHist));
+
+	//Go through the raw values
+	uint16_t count = rawWidth * rawHeight;
+	for (uint16_t i = 0; i < count; i++) {
+		uint16_t value = smallBuffer[i];
+
+		//We found a new min
+		if (value < minVal) {
+			minVal = value;
+			minPos = i;
+		}
+		//We found a new max
+		if (value > maxVal) {
+			maxVal = value;
+			maxPos = i;
+		}
+
+		//Sums for average and deviation
+		sum += value;
+		sumSquares += (uint32_t)value * value;
+
+		//Histogram with 64 bins over the 14-bit range
+		if (value > 16383)
+			value = 16383;
+		frameStats.histogram[value >> 8]++;
+
+		if (agcCollect)
+			agcHist[agcOffset(value) >> agcShift]++;
+	}
+
+	//Store the results, positions are 160x120 pixel indices
+	frameStats.minValue = minVal;
+	frameStats.minPos = toPixelIndex(minPos);
+	frameStats.maxValue = maxVal;
+	frameStats.maxPos = toPixelIndex(maxPos);
+	frameStats.sum = sum;
+	frameStats.sumSquares = sumSquares;
+	frameStats.count = count;
+
+	//The histogram is usable if the frame fits into its range
+	if (agcCollect)
+		agcCheckRange(minVal, maxVal);
+
+	//Average of the 196 (14x14) pixels in the middle, 49 (7x7) values for Lepton2
+	byte scale = (leptonVersion == leptonVersion_3_shutter) ? 1 : 2;
+	byte width = rawWidth;
+	uint32_t centerSum = 0;
+	bool centerValid = true;
+	for (byte vert = 52 / scale; vert < 66 / scale; vert++) {
+		for (byte horiz = 72 / scale; horiz < 86 / scale; horiz++) {
+			uint16_t val = smallBuffer[(vert * width) + horiz];
+			//If one of the values contains hotter or colder values than the lepton can handle
+			if ((val == 16383) || (val == 0))
+				centerValid = false;
+			centerSum += val;
+		}
+	}
+	//Zero marks an invalid calibration set
+	if (centerValid)
+		frameStats.centerAverage = centerSum / (196 / (scale * scale));
+	else
+		frameStats.centerAverage = 0;
+
+	//Refresh the temperature points
+	for (byte i = 0; i < 96; i++) {
+		//Index goes from 1 to max, zero is inactive
+		uint16_t index = tempPoints[i][0];
+		if (index != 0)
+			tempPoints[i][1] = smallBuffer[toRawIndex(index - 1)];
 	}
 }
 
+/* Take min and max temp from the frame statistics, eventually adjusted by the AGC */
+void limitValues() {
+	minValue = frameStats.minValue;
+	maxValue = frameStats.maxValue;
+
+	//Clip the limits at the percentiles
+	if (agcActive(agcMode_percentile))
+		agcPercentile();
+	//Equalize the histogram for the color table
+	else if (agcActive(agcMode_equalize))
+		agcEqualize();
+}
+
 /* Get the colors for hot / cold mode selection */
 void getHotColdColors(byte* red, byte* green, byte* blue) {
 	switch (hotColdColor) {
@@ -533,24 +767,101 @@ void getHotColdColors(byte* red, byte* green, byte* blue) {
 	}
 }
 
+/* Create the raw value to RGB565 lookup table if the settings have changed */
+void updateColorLUT() {
+	//For hot and cold mode, calculate rawlevel
+	uint16_t hotColdRawLevel = 0;
+	if ((hotColdMode != hotColdMode_disabled) && (displayMode != displayMode_combined))
+		hotColdRawLevel = calSnapRaw(hotColdLevel * 100);
+
+	//Hot and cold colors are not shown during warmup, in combined mode and on locally equalized values
+	byte mode = hotColdMode;
+	if ((calStatus == cal_warmup) || (displayMode == displayMode_combined) || (agcLocalApply))
+		mode = hotColdMode_disabled;
+
+	//Colors follow the equalized histogram
+	bool equalize = agcActive(agcMode_equalize) && agcMapValid;
+
+	//Nothing changed, keep the current table
+	if ((colorLUTValid) && (colorLUTMin == minValue) && (colorLUTMax == maxValue) &&
+		(colorLUTMap == colorMap) && (colorLUTElements == colorElements) &&
+		(colorLUTHotColdMode == mode) && (colorLUTHotColdColor == hotColdColor) &&
+		(colorLUTHotColdLevel == hotColdRawLevel) && (colorLUTEqualize == equalize) &&
+		((!equalize) || (colorLUTAgcVersion == agcMapVersion)))
+		return;
+
+	//Store the settings
+	colorLUTValid = true;
+	colorLUTMin = minValue;
+	colorLUTMax = maxValue;
+	colorLUTMap = colorMap;
+	colorLUTElements = colorElements;
+	colorLUTHotColdMode = mode;
+	colorLUTHotColdColor = hotColdColor;
+	colorLUTHotColdLevel = hotColdRawLevel;
+	colorLUTEqualize = equalize;
+	colorLUTAgcVersion = agcMapVersion;
+
+	//Range of raw values, several of them share one entry for large ranges
+	uint16_t range = 0;
+	if (maxValue > minValue)
+		range = maxValue - minValue;
+	colorLUTShift = 0;
+	while ((range >> colorLUTShift) >= 1024)
+		colorLUTShift++;
+
+	//Color for the hot or cold area
+	uint8_t red = 0, green = 0, blue = 0;
+	getHotColdColors(&red, &green, &blue);
+	uint16_t hotColdRGB = (((red & 248) | green >> 5) << 8) | ((green & 28) << 3 | blue >> 3);
+
+	//Fill the table
+	for (uint16_t i = 0; i <= (range >> colorLUTShift); i++) {
+		uint16_t offset = i << colorLUTShift;
+		uint16_t value = minValue + offset;
+
+		//Hot
+		if ((mode == hotColdMode_hot) && (value >= hotColdRawLevel))
+			colorLUT[i] = hotColdRGB;
+		//Cold
+		else if ((mode == hotColdMode_cold) && (value <= hotColdRawLevel))
+			colorLUT[i] = hotColdRGB;
+		//Apply colorscheme
+		else {
+			uint16_t index = 0;
+			if (equalize)
+				index = ((uint32_t)agcLevel(value) * (colorElements - 1)) / 65535;
+			else if (range != 0)
+				index = ((uint32_t)offset * (colorElements - 1)) / range;
+			red = colorMap[3 * index];
+			green = colorMap[3 * index + 1];
+			blue = colorMap[3 * index + 2];
+			//Convert to RGB565
+			colorLUT[i] = (((red & 248) | green >> 5) << 8) | ((green & 28) << 3 | blue >> 3);
+		}
+	}
+}
+
 /* Convert the lepton values to RGB colors */
 void convertColors(bool small) {
-	uint8_t red, green, blue;
-	uint16_t value;
+	//Create the lookup table if required
+	updateColorLUT();
 
-	//Calculate the scale
-	float scale = (colorElements - 1.0) / (maxValue - minValue);
+	//Colors are written in place, the buffer may still be sent to the screen
+	display_waitScreen();
 
-	//For hot and cold mode, calculate rawlevel
-	float hotColdRawLevel = 0.0;
-	if ((hotColdMode != hotColdMode_disabled) && (displayMode != displayMode_combined))
-		hotColdRawLevel = tempToRaw(hotColdLevel);
+	//The upscaler has already colorized the big buffer
+	bool big = (teensyVersion == teensyVersion_new) && (!small) && (hqRes);
+	if (big && upscaleColored) {
+		upscaleColored = false;
+		return;
+	}
 
 	//Size of the array & buffer
 	int size;
 	unsigned short* frameBuffer;
 	//Teensy 3.6, not for preview
-	if ((teensyVersion == teensyVersion_new) && (!small) && (hqRes)) {
+	if (big) {
 		size = 76800;
 		frameBuffer = bigBuffer;
 	}
@@ -560,83 +871,56 @@ void convertColors(bool small) {
 		frameBuffer = smallBuffer;
 	}
 
-	//Repeat for 160x120 data
-	for (int i = 0; i < size; i++) {
-
-		value = frameBuffer[i];
-
-		//Limit values
-		if (value > maxValue)
-			value = maxValue;
-		if (value < minValue)
-			value = minValue;
+	//Lepton2 raw values are doubled to 160x120 while converting
+	if ((frameBuffer == smallBuffer) && (leptonVersion != leptonVersion_3_shutter)) {
+		//Start at the end, so no raw value is overwritten before it is read
+		uint16_t local[80];
+		for (int16_t y = 59; y >= 0; y--) {
+			uint16_t* src = &smallBuffer[y * 80];
+			//Local equalization of the live image
+			if (agcLocalApply) {
+				agcLocalLine(src, y, local);
+				src = local;
+			}
+			for (int16_t x = 79; x >= 0; x--) {
+				uint16_t color = colorLUTLookup(src[x]);
+				uint16_t* dest = &smallBuffer[(y * 320) + (x * 2)];
+				dest[0] = color;
+				dest[1] = color;
+				dest[160] = color;
+				dest[161] = color;
+			}
+		}
+		return;
+	}
 
-		//Hot
-		if ((hotColdMode == hotColdMode_hot) && (value >= hotColdRawLevel) && (calStatus != cal_warmup) && (displayMode != displayMode_combined))
-			getHotColdColors(&red, &green, &blue);
-		//Cold
-		else if ((hotColdMode == hotColdMode_cold) && (value <= hotColdRawLevel) && (calStatus != cal_warmup) && (displayMode != displayMode_combined))
-			getHotColdColors(&red, &green, &blue);
-		//Apply colorscheme
-		else {
-			value = (value - minValue) * scale;
-			red = colorMap[3 * value];
-			green = colorMap[3 * value + 1];
-			blue = colorMap[3 * value + 2];
+	//Local equalization of the live image at the raw resolution, the big buffer has it from the upscaler
+	if ((frameBuffer == smallBuffer) && (agcLocalApply)) {
+		uint16_t local[160];
+		for (byte y = 0; y < 120; y++) {
+			uint16_t* line = &smallBuffer[y * 160];
+			agcLocalLine(line, y, local);
+			for (byte x = 0; x < 160; x++)
+				line[x] = colorLUTLookup(local[x]);
 		}
+		return;
+	}
 
-		//Convert to RGB565
-		frameBuffer[i] = (((red & 248) | green >> 5) << 8) | ((green & 28) << 3 | blue >> 3);
+	//Repeat for 160x120 data
+	for (int i = 0; i < size; i++) {
+		//Get the RGB565 color
+		frameBuffer[i] = colorLUTLookup(frameBuffer[i]);
 	}
 }
 
 /* Refresh the position and value of the min / max value */
 void refreshMinMax()
 {
-	//Reset values
-	minTempVal = 65535;
-	maxTempVal = 0;
-
-	//Go through the smallBuffer
-	for (int i = 0; i < 19200; i++)
-	{
-		//We found a new min
-		if (smallBuffer[i] < minTempVal)
-		{
-			//Save position and value
-			minTempPos = i;
-			minTempVal = smallBuffer[i];
-		}
-
-		//We found a new max
-		if (smallBuffer[i] > maxTempVal)
-		{
-			maxTempPos = i;
-			maxTempVal = smallBuffer[i];
-		}
-	}
-}
-
-/* Refresh the temperature points*/
-void refreshTempPoints() {
-	//Go through the array
-	for (byte i = 0; i < 96; i++) {
-		//Get index
-		uint16_t index = tempPoints[i][0];
-
-		//Check if point is active
-		if (index != 0) {
-			//Index goes from 1 to max
-			index -= 1;
-
-			//Calculate x and y position
-			uint16_t xpos = index % 160;
-			uint16_t ypos = index / 160;
-
-			//Update value
-			tempPoints[i][1] = smallBuffer[xpos + (ypos * 160)];
-		}
-	}
+	//Take them from the frame statistics
+	minTempPos = frameStats.minPos;
+	minTempVal = frameStats.minValue;
+	maxTempPos = frameStats.maxPos;
+	maxTempVal = frameStats.maxValue;
 }
 
 /* Calculate the x and y position out of the pixel index */
@@ -655,13 +939,23 @@ void calculatePointPos(int16_t* xpos, int16_t* ypos, uint16_t pixelIndex) {
 /* Creates a thermal smallBuffer and stores it in the array */
 void createThermalImg(bool small) {
 	//Receive the temperatures over SPI
+	profiler_start();
 	lepton_getRawValues();
+	profiler_stop(profiler_getRawValues);
+
+	//Teensy 3.6 - Stream the next frame into the unused big buffer meanwhile
+	if ((!small) && (!hqRes))
+		lepton_prefetch(bigBuffer);
 
 	//Compensate calibration with object temp
+	profiler_start();
 	compensateCalib();
+	//Calibration of this frame for the colors and the temperature labels
+	calSnapshot();
+	profiler_stop(profiler_compensateCalib);
 
-	//Refresh the temp points if required
-	refreshTempPoints();
+	//Get min, max and temp points in one pass
+	calcFrameStats();
 
 	//Find min / max position
 	if (minMaxPoints != minMaxPoints_disabled)
@@ -673,36 +967,50 @@ void createThermalImg(bool small) {
 
 	//If smallBuffer save, save the raw data
 	if (imgSave == imgSave_create)
-		saveRawData(true, saveFilename);
+		saveRawData(saveFilename);
 
-	//Apply low-pass filter
-	if (filterType == filterType_box)
-		boxFilter();
-	else if (filterType == filterType_gaussian)
-		gaussianFilter();
+	//Apply the selected filter
+	profiler_start();
+	filterImage(true);
+	profiler_stop(profiler_filter);
 
 	//Teensy 3.6 - Resize to big buffer when HQRes and not preview
-	if ((teensyVersion == teensyVersion_new) && (!small) && (hqRes))
+	profiler_start();
+	if ((teensyVersion == teensyVersion_new) && (!small) && (hqRes)) {
 		smallToBigBuffer();
+		//Raw values are not needed anymore, stream the next frame in meanwhile
+		lepton_prefetch(smallBuffer);
+	}
 
 	//Convert lepton data to RGB565 colors
 	if(!videoSave)
 		convertColors(small);
+	profiler_stop(profiler_convertColors);
 }
 
 /* Create the visual or combined smallBuffer display */
 void createVisCombImg() {
-	//Capture new frame from camera
-	camera_capture();
+	//Both buffers are overwritten, let the screen DMA finish
+	display_waitScreen();
+
+	//Capture new frame from camera, unless it was triggered after the last frame
+	if (!camera_pending)
+		camera_capture();
 
 	//Receive the temperatures over SPI
+	profiler_start();
 	lepton_getRawValues();
+	profiler_stop(profiler_getRawValues);
 
 	//Compensate calibration with object temp
+	profiler_start();
 	compensateCalib();
+	//Calibration of this frame for the colors and the temperature labels
+	calSnapshot();
+	profiler_stop(profiler_compensateCalib);
 
-	//Refresh the temp points if required
-	refreshTempPoints();
+	//Get min, max and temp points in one pass
+	calcFrameStats();
 
 	//Find min / max position
 	if (minMaxPoints != minMaxPoints_disabled)
@@ -715,38 +1023,34 @@ void createVisCombImg() {
 	//For 320x240 resolution, decompress visual image before thermal
 	if ((teensyVersion == teensyVersion_new) && (hqRes))
 	{
-		//Fill array white
-		for (uint32_t i = 0; i < 76800; i++)
-			bigBuffer[i] = 65535;
 		//Get image from cam
 		camera_get(camera_stream);
-		//Resize the image
+		//Resize the image, the borders without visual data become white
 		resizeImage();
 	}
 
 	//For combined only
 	if (displayMode == displayMode_combined) {
-		//Apply low-pass filter
-		if (filterType == filterType_box)
-			boxFilter();
-		else if (filterType == filterType_gaussian)
-			gaussianFilter();
+		//Apply the selected filter
+		profiler_start();
+		filterImage(true);
+		profiler_stop(profiler_filter);
 
 		//Teensy 3.6 with HQRes - Resize to big buffer and create transparency
+		profiler_start();
 		if ((teensyVersion == teensyVersion_new) && (hqRes))
 			smallToBigBuffer(true);
 		//Teensy 3.1 / 3.2 - Convert raw values to RGB565 
 		else
 			convertColors();
+		profiler_stop(profiler_convertColors);
 	}
 
 	//For low resolution, decompress visual image after thermal image
 	if ((teensyVersion == teensyVersion_old) || (!hqRes))
 	{
-		//Resize the thermal image
+		//Resize the thermal image and fill the edges
 		resizeImage();
-		//Fill the edges of the thermal image
-		fillEdges();
 		//Get the visual image and decompress it combined
 		camera_get(camera_stream);
 	}
@@ -0,0 +1,296 @@
+/*
+*
+* FILTER - Spatial filters for the raw values of the thermal frameBuffer
+*
+* DIY-Thermocam Firmware
+*
+* GNU General Public License v3.0
+*
+* Copyright by Max Ritter
+*
+* http://www.diy-thermocam.net
+* https://github.com/maxritter/DIY-Thermocam
+*
+*/
+
+/* Variables */
+
+//Range weights of the bilateral filter, indexed by the difference / 4
+const byte bilateralWeights[16] = {
+	64, 63, 59, 53, 46, 39, 31, 24, 18, 13, 9, 6, 4, 2, 1, 0
+};
+
+/* Methods */
+
+/* Get one line of the small buffer, lines outside are replicated from the edge */
+uint16_t* filterGetLine(int16_t y) {
+	if (y < 0)
+		y = 0;
+	else if (y >= rawHeight)
+		y = rawHeight - 1;
+	return &smallBuffer[y * rawWidth];
+}
+
+/* Copy one line of the small buffer to a line buffer */
+void filterCopyLine(uint16_t* line, int16_t y) {
+	memcpy(line, filterGetLine(y), rawWidth * 2);
+}
+
+/* Horizontal 1-2-1 pass of one line with replicated edges */
+void gaussianLine(uint32_t* line, int16_t y) {
+	uint16_t* src = filterGetLine(y);
+	byte last = rawWidth - 1;
+	line[0] = (3 * src[0]) + src[1];
+	for (byte x = 1; x < last; x++)
+		line[x] = src[x - 1] + (2 * src[x]) + src[x + 1];
+	line[last] = src[last - 1] + (3 * src[last]);
+}
+
+/* Horizontal 1-4-6-4-1 pass of one line with replicated edges */
+void gaussian5Line(uint32_t* line, int16_t y) {
+	uint16_t* src = filterGetLine(y);
+	byte last = rawWidth - 1;
+	for (byte x = 0; x <= last; x++) {
+		//Replicate the edge columns
+		uint16_t left2 = src[x < 2 ? 0 : x - 2];
+		uint16_t left1 = src[x < 1 ? 0 : x - 1];
+		uint16_t right1 = src[x + 1 > last ? last : x + 1];
+		uint16_t right2 = src[x + 2 > last ? last : x + 2];
+		line[x] = left2 + (4 * left1) + (6 * src[x]) + (4 * right1) + right2;
+	}
+}
+
+/* Horizontal 1-1-1 pass of one line with replicated edges */
+void boxLine(uint32_t* line, int16_t y) {
+	uint16_t* src = filterGetLine(y);
+	byte last = rawWidth - 1;
+	line[0] = (2 * src[0]) + src[1];
+	for (byte x = 1; x < last; x++)
+		line[x] = src[x - 1] + src[x] + src[x + 1];
+	line[last] = src[last - 1] + (2 * src[last]);
+}
+
+/* Filter the raw values of the smallBuffer with 3x3 gaussian kernel */
+void gaussianFilter() {
+	//Resolution of the raw values
+	byte width = rawWidth;
+	byte height = rawHeight;
+
+	//Rolling buffer with the horizontal pass of three lines
+	uint32_t lines[3][160];
+
+	//First line and the replicated line above
+	gaussianLine(lines[0], 0);
+	memcpy(lines[2], lines[0], sizeof(lines[0]));
+
+	for (int16_t y = 0; y < height; y++) {
+		//Horizontal pass of the next line, not overwritten yet
+		gaussianLine(lines[(y + 1) % 3], y + 1);
+
+		//Vertical pass, the kernel sum is 16
+		uint32_t* above = lines[(y + 2) % 3];
+		uint32_t* center = lines[y % 3];
+		uint32_t* below = lines[(y + 1) % 3];
+		uint16_t* dest = &smallBuffer[y * width];
+		for (byte x = 0; x < width; x++)
+			dest[x] = (above[x] + (2 * center[x]) + below[x] + 8) >> 4;
+	}
+}
+
+/* Filter the raw values of the smallBuffer with 5x5 gaussian kernel */
+void gaussian5Filter() {
+	//Resolution of the raw values
+	byte width = rawWidth;
+	byte height = rawHeight;
+
+	//Rolling buffer with the horizontal pass of five lines
+	uint32_t lines[5][160];
+
+	//First three lines and the two replicated lines above
+	gaussian5Line(lines[0], 0);
+	gaussian5Line(lines[1], 1);
+	gaussian5Line(lines[2], 2);
+	memcpy(lines[3], lines[0], sizeof(lines[0]));
+	memcpy(lines[4], lines[0], sizeof(lines[0]));
+
+	for (int16_t y = 0; y < height; y++) {
+		//Horizontal pass of the second next line, not overwritten yet
+		if (y > 0)
+			gaussian5Line(lines[(y + 2) % 5], y + 2);
+
+		//Vertical pass, the kernel sum is 256
+		uint32_t* above2 = lines[(y + 3) % 5];
+		uint32_t* above1 = lines[(y + 4) % 5];
+		uint32_t* center = lines[y % 5];
+		uint32_t* below1 = lines[(y + 1) % 5];
+		uint32_t* below2 = lines[(y + 2) % 5];
+		uint16_t* dest = &smallBuffer[y * width];
+		for (byte x = 0; x < width; x++)
+			dest[x] = (above2[x] + (4 * above1[x]) + (6 * center[x]) +
+				(4 * below1[x]) + below2[x] + 128) >> 8;
+	}
+}
+
+/* Filter the raw values of the smallBuffer with a 3x3 box kernel */
+void boxFilter() {
+	//Resolution of the raw values
+	byte width = rawWidth;
+	byte height = rawHeight;
+
+	//Rolling buffer with the horizontal pass of three lines
+	uint32_t lines[3][160];
+
+	//First line and the replicated line above
+	boxLine(lines[0], 0);
+	memcpy(lines[2], lines[0], sizeof(lines[0]));
+
+	for (int16_t y = 0; y < height; y++) {
+		//Horizontal pass of the next line, not overwritten yet
+		boxLine(lines[(y + 1) % 3], y + 1);
+
+		//Vertical pass, division by a constant compiles to multiply and shift
+		uint32_t* above = lines[(y + 2) % 3];
+		uint32_t* center = lines[y % 3];
+		uint32_t* below = lines[(y + 1) % 3];
+		uint16_t* dest = &smallBuffer[y * width];
+		for (byte x = 0; x < width; x++)
+			dest[x] = (above[x] + center[x] + below[x] + 4) / 9;
+	}
+}
+
+/* Sort two values */
+inline void filterSort(uint16_t* a, uint16_t* b) {
+	if (*a > *b) {
+		uint16_t temp = *a;
+		*a = *b;
+		*b = temp;
+	}
+}
+
+/* Median of three values */
+inline uint16_t filterMedian3(uint16_t a, uint16_t b, uint16_t c) {
+	filterSort(&a, &b);
+	filterSort(&b, &c);
+	filterSort(&a, &b);
+	return b;
+}
+
+/* Filter the raw values of the smallBuffer with a 3x3 median */
+void medianFilter() {
+	//Resolution of the raw values
+	byte width = rawWidth;
+	byte height = rawHeight;
+
+	//Rolling buffer with the original values of three lines
+	uint16_t lines[3][160];
+	//Sorted columns of the current window
+	uint16_t low[160], mid[160], high[160];
+
+	//First line and the replicated line above
+	filterCopyLine(lines[0], 0);
+	memcpy(lines[2], lines[0], sizeof(lines[0]));
+
+	for (int16_t y = 0; y < height; y++) {
+		//Copy the next line before it gets overwritten
+		filterCopyLine(lines[(y + 1) % 3], y + 1);
+
+		//Sort every column of the three lines
+		uint16_t* above = lines[(y + 2) % 3];
+		uint16_t* center = lines[y % 3];
+		uint16_t* below = lines[(y + 1) % 3];
+		for (byte x = 0; x < width; x++) {
+			uint16_t a = above[x];
+			uint16_t b = center[x];
+			uint16_t c = below[x];
+			filterSort(&a, &b);
+			filterSort(&b, &c);
+			filterSort(&a, &b);
+			low[x] = a;
+			mid[x] = b;
+			high[x] = c;
+		}
+
+		//Median is the median of the maximum low, median mid and minimum high
+		uint16_t* dest = &smallBuffer[y * width];
+		for (byte x = 0; x < width; x++) {
+			byte left = (x == 0) ? 0 : x - 1;
+			byte right = (x == width - 1) ? x : x + 1;
+			uint16_t maxLow = max(max(low[left], low[x]), low[right]);
+			uint16_t medMid = filterMedian3(mid[left], mid[x], mid[right]);
+			uint16_t minHigh = min(min(high[left], high[x]), high[right]);
+			dest[x] = filterMedian3(maxLow, medMid, minHigh);
+		}
+	}
+}
+
+/* Filter the raw values of the smallBuffer with a 3x3 bilateral filter */
+void bilateralFilter() {
+	//Resolution of the raw values
+	byte width = rawWidth;
+	byte height = rawHeight;
+
+	//Rolling buffer with the original values of three lines
+	uint16_t lines[3][160];
+	//Spatial weights of the 3x3 neighbourhood
+	const byte spatial[3] = { 1, 2, 1 };
+
+	//First line and the replicated line above
+	filterCopyLine(lines[0], 0);
+	memcpy(lines[2], lines[0], sizeof(lines[0]));
+
+	for (int16_t y = 0; y < height; y++) {
+		//Copy the next line before it gets overwritten
+		filterCopyLine(lines[(y + 1) % 3], y + 1);
+
+		uint16_t* rows[3] = { lines[(y + 2) % 3], lines[y % 3], lines[(y + 1) % 3] };
+		uint16_t* dest = &smallBuffer[y * width];
+		for (byte x = 0; x < width; x++) {
+			uint16_t value = rows[1][x];
+			uint32_t sum = 0;
+			uint32_t weights = 0;
+
+			//Weight every neighbour by distance and value difference
+			for (byte j = 0; j < 3; j++) {
+				for (byte k = 0; k < 3; k++) {
+					int16_t column = x + k - 1;
+					if (column < 0)
+						column = 0;
+					else if (column >= width)
+						column = width - 1;
+					uint16_t neighbour = rows[j][column];
+					uint16_t diff = (neighbour > value) ? (neighbour - value) : (value - neighbour);
+					uint16_t weight = spatial[j] * spatial[k] * bilateralWeights[min(diff >> 2, 15)];
+					sum += weight * neighbour;
+					weights += weight;
+				}
+			}
+
+			//Center always has a weight, so no division by zero
+			dest[x] = (sum + (weights / 2)) / weights;
+		}
+	}
+}
+
+/* Apply the selected filter to the small buffer, prepare the local equalization for the live image */
+void filterImage(bool live) {
+	switch (filterType) {
+	case filterType_box:
+		boxFilter();
+		break;
+	case filterType_gaussian:
+		gaussianFilter();
+		break;
+	case filterType_gaussian5:
+		gaussian5Filter();
+		break;
+	case filterType_median:
+		medianFilter();
+		break;
+	case filterType_bilateral:
+		bilateralFilter();
+		break;
+	}
+
+	//Local equalization works on the filtered values
+	agcUpdateLocal(live);
+}
@@ -56,6 +56,12 @@ int imgCount = 0;
 //Decide if we load videos or images
 bool loadMode;
 
+//Read buffer for the rice decoder
+uint8_t loadBlock[512] __attribute__((aligned(4)));
+uint16_t loadBlockPos;
+uint16_t loadBlockLen;
+SdFile* loadBlockFile;
+
 /* Methods */
 
 /* Clear all previous data */
@@ -89,16 +95,16 @@ void displayRawData() {
 	//Select Color Scheme
 	selectColorScheme();
 
-	//Apply low-pass filter
-	if (filterType == filterType_box)
-		boxFilter();
-	else if (filterType == filterType_gaussian)
-		gaussianFilter();
+	//Get min, max and temp points in one pass
+	calcFrameStats();
 
 	//Find min / max position
 	if (minMaxPoints != minMaxPoints_disabled)
 		refreshMinMax();
 
+	//Apply the selected filter
+	filterImage();
+
 	//Teensy 3.6 - Resize to big buffer
 	if (teensyVersion == teensyVersion_new)
 		smallToBigBuffer();
@@ -271,58 +277,91 @@ void readTempPoints()
 	}
 }
 
-/* Loads raw data from the internal storage*/
-void loadRawData(char* filename, char* dirname) {
-	byte msb, lsb;
-	uint16_t result;
-	uint32_t fileSize;
-
-	//Switch Clock to Alternative
-	startAltClockline();
-
-	//Go into the video folder if video
-	if (dirname != NULL)
-		sd.chdir(dirname);
+/* Read plain big endian raw values from the file into the small buffer */
+void loadRawPlain(SdFile* file, bool lepton3) {
+	//Lepton2 values stay at their native 80x60
+	uint16_t count = lepton3 ? 19200 : 4800;
+	file->read(smallBuffer, count * 2);
+	for (uint16_t i = 0; i < count; i++)
+		smallBuffer[i] = (smallBuffer[i] >> 8) | (smallBuffer[i] << 8);
+}
 
-	// Open the file for reading
-	sdFile.open(filename, O_READ);
+/* Get the next byte of the file through the read buffer */
+inline uint8_t loadBlockByte() {
+	//Refill the buffer with the next sector
+	if (loadBlockPos == loadBlockLen) {
+		int count = loadBlockFile->read(loadBlock, 512);
+		loadBlockLen = (count > 0) ? count : 0;
+		loadBlockPos = 0;
+		//End of file, return zero bits
+		if (loadBlockLen == 0)
+			return 0;
+	}
+	return loadBlock[loadBlockPos++];
+}
 
-	//Get file size
-	fileSize = sdFile.fileSize();
+/* Read bits of the rice coded data, most significant first */
+inline uint32_t riceReadBits(byte count) {
+	while (riceAccBits < count) {
+		riceAcc = (riceAcc << 8) | loadBlockByte();
+		riceAccBits += 8;
+	}
+	riceAccBits -= count;
+	return (riceAcc >> riceAccBits) & ((1 << count) - 1);
+}
 
-	//For the Lepton2 sensor, read 4800 raw values
-	if ((fileSize == lepton2_small) || (fileSize == lepton2_big)) {
-		for (int line = 0; line < 60; line++) {
-			for (int column = 0; column < 80; column++) {
-				msb = sdFile.read();
-				lsb = sdFile.read();
-				result = (((msb) << 8) + lsb);
-				smallBuffer[(line * 2 * 160) + (column * 2)] = result;
-				smallBuffer[(line * 2 * 160) + (column * 2) + 1] = result;
-				smallBuffer[(line * 2 * 160) + 160 + (column * 2)] = result;
-				smallBuffer[(line * 2 * 160) + 160 + (column * 2) + 1] = result;
+/* Decode rice coded raw values from the file into the small buffer */
+void riceDecode(SdFile* file, bool lepton3) {
+	uint16_t width = lepton3 ? 160 : 80;
+	uint16_t height = lepton3 ? 120 : 60;
+
+	loadBlockFile = file;
+	loadBlockPos = 0;
+	loadBlockLen = 0;
+	riceReset();
+	for (uint16_t y = 0; y < height; y++) {
+		for (uint16_t x = 0; x < width; x++) {
+			uint16_t predict = ricePredict(x, y, lepton3);
+			byte k = riceParam();
+			uint16_t value;
+			uint32_t residual;
+
+			//Unary quotient until the stop bit or the escape code
+			byte quotient = 0;
+			while ((quotient < rice_escape) && riceReadBits(1))
+				quotient++;
+
+			//Escape code, the value itself follows
+			if (quotient == rice_escape) {
+				value = riceReadBits(16);
+				int32_t error = value - predict;
+				residual = (error < 0) ? ((-error * 2) - 1) : (error * 2);
 			}
+			//Residual from the quotient and the k lower bits
+			else {
+				residual = (quotient << k) | riceReadBits(k);
+				if (residual & 1)
+					value = predict - ((residual + 1) >> 1);
+				else
+					value = predict + (residual >> 1);
+			}
+			riceUpdate(residual);
+			smallBuffer[riceIndex(x, y, lepton3)] = value;
 		}
-		leptonVersion = leptonVersion_2_shutter;
 	}
+}
 
-	//For the Lepton3 sensor, read 19200 raw values
-	else if ((fileSize == lepton3_small) || (fileSize == lepton3_big)) {
-		for (int i = 0; i < 19200; i++) {
-			msb = sdFile.read();
-			lsb = sdFile.read();
-			smallBuffer[i] = (((msb) << 8) + lsb);
-		}
-		leptonVersion = leptonVersion_3_shutter;
-	}
-	//Invalid data
-	else {
-		showFullMessage((char*) "Invalid file size!");
-		delay(1000);
-		sdFile.close();
-		endAltClockline();
-		return;
-	}
+/* Read the raw values in the given format from the file */
+void loadRawValues(SdFile* file, byte format, bool lepton3) {
+	if (format == rawFormat_rice)
+		riceDecode(file, lepton3);
+	else
+		loadRawPlain(file, lepton3);
+}
+
+/* Read the settings that follow the raw values of an image */
+void loadRawSettings(bool hasTempPoints) {
+	byte msb, lsb;
 
 	//Read Min
 	msb = sdFile.read();
@@ -358,13 +397,79 @@ void loadRawData(char* filename, char* dirname) {
 	for (int i = 0; i < 4; i++)
 		farray[i] = sdFile.read();
 	calSlope = bytesToFloat(farray);
+	//Calibration of the image for the colors and the temperature labels
+	calSnapshot();
 
 	//Clear temperature points array
 	clearTempPoints();
 
 	//Read temperatures if they are included
-	if ((fileSize == lepton3_big) || (fileSize == lepton2_big))
+	if (hasTempPoints)
 		readTempPoints();
+}
+
+/* Check if the open file starts with the header of the newer raw format */
+bool checkRawHeader() {
+	uint8_t header[3];
+	sdFile.seekSet(0);
+	bool valid = (sdFile.read(header, 3) == 3) &&
+		(header[0] == 'T') && (header[1] == 'C') && (header[2] == 'R');
+	sdFile.seekSet(0);
+	return valid;
+}
+
+/* Loads raw data from the internal storage*/
+void loadRawData(char* filename, char* dirname) {
+	uint32_t fileSize;
+
+	//Switch Clock to Alternative
+	startAltClockline();
+
+	//Go into the video folder if video
+	if (dirname != NULL)
+		sd.chdir(dirname);
+
+	// Open the file for reading
+	sdFile.open(filename, O_READ);
+
+	//Get file size
+	fileSize = sdFile.fileSize();
+
+	//Newer format with a header, the raw values are at the end
+	if (checkRawHeader()) {
+		uint8_t header[6];
+		sdFile.read(header, 6);
+		//Magic, format and the number of raw values
+		uint16_t values = (header[4] << 8) + header[5];
+		if (values == 19200)
+			leptonVersion = leptonVersion_3_shutter;
+		else
+			leptonVersion = leptonVersion_2_shutter;
+		loadRawSettings(true);
+		loadRawValues(&sdFile, header[3], values == 19200);
+	}
+
+	//For the Lepton2 sensor, read 4800 raw values
+	else if ((fileSize == lepton2_small) || (fileSize == lepton2_big)) {
+		loadRawPlain(&sdFile, false);
+		leptonVersion = leptonVersion_2_shutter;
+		loadRawSettings(fileSize == lepton2_big);
+	}
+
+	//For the Lepton3 sensor, read 19200 raw values
+	else if ((fileSize == lepton3_small) || (fileSize == lepton3_big)) {
+		loadRawPlain(&sdFile, true);
+		leptonVersion = leptonVersion_3_shutter;
+		loadRawSettings(fileSize == lepton3_big);
+	}
+	//Invalid data
+	else {
+		showFullMessage((char*) "Invalid file size!");
+		delay(1000);
+		sdFile.close();
+		endAltClockline();
+		return;
+	}
 
 	//Close data file
 	sdFile.close();
@@ -372,6 +477,157 @@ void loadRawData(char* filename, char* dirname) {
 	endAltClockline();
 }
 
+/* Read a big endian word from the video container */
+uint16_t loadVideoWord() {
+	uint8_t bytes[2];
+	videoFile.read(bytes, 2);
+	return (bytes[0] << 8) | bytes[1];
+}
+
+/* Read a big endian long from the video container */
+uint32_t loadVideoLong() {
+	uint32_t high = loadVideoWord();
+	return (high << 16) | loadVideoWord();
+}
+
+/* Find the end of the last complete record in a video container */
+uint32_t loadVideoDataEnd() {
+	uint8_t head[video_recordHead];
+	uint32_t pos = video_headerSize;
+	uint32_t fileSize = videoFile.fileSize();
+
+	//Follow the record lengths until the data is incomplete
+	while ((pos + video_recordHead) <= fileSize) {
+		videoFile.seekSet(pos);
+		videoFile.read(head, video_recordHead);
+		uint16_t length = (head[4] << 8) | head[5];
+		uint32_t next = pos + video_recordHead + length;
+		//The length is set after the raw values, zero for a record that was not finished
+		if ((length == 0) || (next > fileSize))
+			break;
+		pos = next;
+	}
+	return pos;
+}
+
+/* Open the video container of the folder, returns false for a video of single frames */
+bool loadVideoOpen(char* dirname) {
+	uint8_t farray[4];
+	videoContainer = false;
+
+	//Switch Clock to Alternative
+	startAltClockline();
+
+	//Go into the video folder
+	sd.chdir("/");
+	sd.chdir(dirname);
+
+	//Older videos have one .DAT file per frame
+	if (!videoFile.open(video_fileName, O_RDWR)) {
+		endAltClockline();
+		return false;
+	}
+
+	//Check the magic and the version
+	videoFile.read(farray, 4);
+	if ((videoFile.fileSize() < video_headerSize) ||
+		(farray[0] != 'T') || (farray[1] != 'C') || (farray[2] != 'V') || (farray[3] != video_version)) {
+		videoFile.close();
+		endAltClockline();
+		return false;
+	}
+
+	//Read the number of raw values per frame
+	videoContainerValues = loadVideoWord();
+	if (videoContainerValues == 19200)
+		leptonVersion = leptonVersion_3_shutter;
+	else
+		leptonVersion = leptonVersion_2_shutter;
+
+	//Read the settings of the recording
+	colorScheme = videoFile.read();
+	tempFormat = videoFile.read();
+	spotEnabled = videoFile.read();
+	minMaxPoints = videoFile.read();
+	videoFile.read(farray, 4);
+	calSlope = bytesToFloat(farray);
+	//Skip the interval
+	loadVideoWord();
+
+	//Read the indices of the temperature points
+	clearTempPoints();
+	for (byte i = 0; i < 96; i++)
+		tempPoints[i][0] = loadVideoWord();
+
+	//Read the trailer
+	videoFile.seekSet(videoFile.fileSize() - video_trailerSize);
+	videoFile.read(farray, 4);
+	videoContainerFrames = loadVideoLong();
+	videoIndexPos = loadVideoLong();
+
+	//No trailer, the recording was interrupted. Rebuild the index
+	if ((farray[0] != 'T') || (farray[1] != 'C') || (farray[2] != 'V') || (farray[3] != 'I')) {
+		videoIndexPos = loadVideoDataEnd();
+		videoFile.truncate(videoIndexPos);
+		videoContainerFrames = videoWriteIndex(&videoFile, videoIndexPos);
+		videoFile.sync();
+		//The index written during the recording is incomplete
+		if (sd.exists(video_indexName))
+			sd.remove(video_indexName);
+	}
+
+	videoContainer = true;
+	//Switch clock back
+	endAltClockline();
+	return true;
+}
+
+/* Load one frame of the opened video container */
+void loadVideoFrame(uint16_t frame) {
+	uint8_t farray[4];
+
+	//Switch Clock to Alternative
+	startAltClockline();
+
+	//Look up the record in the seek index
+	videoFile.seekSet(videoIndexPos + (frame * 4));
+	uint32_t offset = loadVideoLong();
+
+	//Skip the timestamp and the length
+	videoFile.seekSet(offset + video_recordHead);
+
+	//Read the format of the raw values
+	byte format = videoFile.read();
+	//Read min and max
+	minValue = loadVideoWord();
+	maxValue = loadVideoWord();
+	//Read object temperature and calibration offset
+	videoFile.read(farray, 4);
+	mlx90614_temp = bytesToFloat(farray);
+	videoFile.read(farray, 4);
+	calOffset = bytesToFloat(farray);
+	//Calibration of the frame for the colors and the temperature labels
+	calSnapshot();
+	//Read colorbar enabled
+	colorbarEnabled = videoFile.read();
+
+	//Read the raw values
+	loadRawValues(&videoFile, format, videoContainerValues == 19200);
+
+	//Switch clock back
+	endAltClockline();
+}
+
+/* Close the video container */
+void loadVideoClose() {
+	if (!videoContainer)
+		return;
+	startAltClockline();
+	videoFile.close();
+	endAltClockline();
+	videoContainer = false;
+}
+
 /* A method to choose the right yearStorage */
 bool yearChoose(char* filename) {
 	//Can imgCount up to 50 years
@@ -657,7 +913,8 @@ bool checkFileValidity() {
 	{
 		uint32_t fileSize = sdFile.fileSize();
 		return (sdFile.isFile() && ((fileSize == lepton2_small) || (fileSize == lepton2_big) ||
-			(fileSize == lepton3_small) || (fileSize == lepton3_big) || (fileSize == bitmap)));
+			(fileSize == lepton3_small) || (fileSize == lepton3_big) || (fileSize == bitmap) ||
+			checkRawHeader()));
 	}
 	//Load videos
 	return sdFile.isDir();
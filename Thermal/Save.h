@@ -42,6 +42,33 @@ const char bmp_header_large[66] = { 0x42, 0x4D, 0x36, 0x60, 0x09, 0x00, 0x00,
 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x00, 0xE0, 0x07, 0x00, 0x00,
 0x1F, 0x00, 0x00, 0x00 };
 
+//Staging buffer for the raw data, written to the SD card in full sectors
+uint8_t saveBlock[512] __attribute__((aligned(4)));
+//Number of bytes in the staging buffer
+uint16_t saveBlockPos = 0;
+//File the staging buffer is written to
+SdFile* saveBlockFile = &sdFile;
+
+//Running sum and count of the residuals for the rice parameter
+uint32_t riceSum;
+uint16_t riceCount;
+//Bit accumulator of the rice coder
+uint32_t riceAcc;
+byte riceAccBits;
+//Output of the coded bytes, the staging buffer for files
+void (*riceSink)(uint8_t value);
+
+//Start of the recording and time of the last directory update
+uint32_t videoStartTime;
+uint32_t videoSyncTime;
+//Seek index written during the recording, appended to the container at the end
+SdFile videoIndexFile;
+uint8_t videoIndexBlock[512];
+uint16_t videoIndexBlockPos;
+//Offset of the next record and number of recorded frames
+uint32_t videoRecordPos;
+uint16_t videoFrames;
+
 /* Methods */
 
 /* Creates a filename from the current time & date */
@@ -200,8 +227,13 @@ void imgSaveStart() {
 		else
 			display_print((char*) "SAVING", CENTER, 130);
 
-		//Save visual image in full-res
-		camera_get(camera_save);
+		//Save visual image in full-res, the thermal image is saved without it on failure
+		if (!camera_get(camera_save)) {
+			if (spotEnabled)
+				display_print((char*) "NO VISUAL", CENTER, 190);
+			else
+				display_print((char*) "NO VISUAL", CENTER, 150);
+		}
 	}
 
 	//Show save message
@@ -268,7 +300,7 @@ void processVideoFrames(int framesCaptured, char* dirname) {
 	//Display info
 	display_setFont(smallFont);
 	display_setColor(VGA_BLACK);
-	display_print((char*)"Converts all .DAT to .BMP frames", CENTER, 80);
+	display_print((char*)"Converts the raw video to .BMP frames", CENTER, 80);
 	display_print((char*)"Press button to abort the process", CENTER, 120);
 
 	//Display content
@@ -280,6 +312,9 @@ void processVideoFrames(int framesCaptured, char* dirname) {
 	//Switch to processing mode
 	videoSave = videoSave_processing;
 
+	//Open the video container if there is one
+	loadVideoOpen(dirname);
+
 	//Go through all the frames in the folder
 	for (framesConverted = 0; framesConverted < framesCaptured; framesConverted++) {
 		//Button pressed, exit
@@ -289,20 +324,23 @@ void processVideoFrames(int framesCaptured, char* dirname) {
 		//Get filename
 		frameFilename(filename, framesConverted);
 		strcpy(&filename[5], ".DAT");
-		
-		//Load Raw data
-		loadRawData(filename, dirname);
 
-		//Apply low-pass filter
-		if (filterType == filterType_box)
-			boxFilter();
-		else if (filterType == filterType_gaussian)
-			gaussianFilter();
+		//Load Raw data from the container or the single frame
+		if (videoContainer)
+			loadVideoFrame(framesConverted);
+		else
+			loadRawData(filename, dirname);
+
+		//Get min, max and temp points in one pass
+		calcFrameStats();
 
 		//Find min / max position
 		if (minMaxPoints != minMaxPoints_disabled)
 			refreshMinMax();
 
+		//Apply the selected filter
+		filterImage();
+
 		//Convert lepton data to RGB565 colors
 		convertColors(true);
 
@@ -326,102 +364,478 @@ void processVideoFrames(int framesCaptured, char* dirname) {
 		display_print(buffer, CENTER, 160);
 	}
 
+	//Close the video container
+	loadVideoClose();
+
 	//All images converted!
 	showFullMessage((char*) "Video converted!");
 	delay(1000);
 }
 
-/* Saves raw data for an image or an video frame */
-void saveRawData(bool isImage, char* name, uint16_t framesCaptured) {
-	uint16_t result;
+/* Add one byte to the staging buffer, write it out when a sector is full */
+inline void saveBlockByte(uint8_t value) {
+	saveBlock[saveBlockPos++] = value;
+	if (saveBlockPos == 512) {
+		saveBlockFile->write(saveBlock, 512);
+		saveBlockPos = 0;
+	}
+}
 
-	//Start SD
-	startAltClockline();
+/* Add a word in big endian order to the staging buffer */
+inline void saveBlockWord(uint16_t value) {
+	saveBlockByte(value >> 8);
+	saveBlockByte(value & 0xFF);
+}
 
-	//Create filename for image
-	if (isImage) {
-		strcpy(&name[14], ".DAT");
-		sdFile.open(name, O_RDWR | O_CREAT | O_AT_END);
+/* Add a float in the byte order of floatToBytes() to the staging buffer */
+void saveBlockFloat(float value) {
+	uint8_t farray[4];
+	floatToBytes(farray, value);
+	for (byte i = 0; i < 4; i++)
+		saveBlockByte(farray[i]);
+}
+
+/* Write the remaining bytes of the staging buffer */
+void saveBlockFlush() {
+	if (saveBlockPos != 0)
+		saveBlockFile->write(saveBlock, saveBlockPos);
+	saveBlockPos = 0;
+}
+
+/* Get the file position of the next byte added to the staging buffer */
+inline uint32_t saveBlockTell() {
+	return saveBlockFile->curPosition() + saveBlockPos;
+}
+
+/* Go back to an earlier position, the bytes behind it are written again */
+void saveBlockSeek(uint32_t offset) {
+	uint32_t written = saveBlockFile->curPosition();
+	//Still in the staging buffer
+	if (offset >= written) {
+		saveBlockPos = offset - written;
+		return;
 	}
+	saveBlockFile->seekSet(offset);
+	saveBlockPos = 0;
+}
 
-	//Create filename for video frame
-	else {
-		char filename[] = "00000.DAT";
-		frameFilename(filename, framesCaptured);
-		sd.chdir(name);
-		sdFile.open(filename, O_RDWR | O_CREAT | O_AT_END);
+/* Change a byte that has already been added, in the staging buffer or in the file */
+void saveBlockPatch(uint32_t offset, uint8_t value) {
+	uint32_t written = saveBlockFile->curPosition();
+	if (offset >= written) {
+		saveBlock[offset - written] = value;
+		return;
 	}
+	saveBlockFile->seekSet(offset);
+	saveBlockFile->write(&value, 1);
+	saveBlockFile->seekSet(written);
+}
 
-	//For the Lepton2 sensor, write 4800 raw values
-	if (leptonVersion != leptonVersion_3_shutter) {
-		for (int line = 0; line < 60; line++) {
-			for (int column = 0; column < 80; column++) {
-				result = smallBuffer[(line * 2 * 160) + (column * 2)];
-				sdFile.write((result & 0xFF00) >> 8);
-				sdFile.write(result & 0x00FF);
+/* Reset the adaptive state of the rice coder */
+void riceReset() {
+	riceSum = 16;
+	riceCount = 1;
+	riceAcc = 0;
+	riceAccBits = 0;
+}
+
+/* Get the rice parameter from the mean of the previous residuals */
+inline byte riceParam() {
+	byte k = 0;
+	while ((uint32_t)(riceCount << k) < riceSum)
+		k++;
+	return k;
+}
+
+/* Add a residual to the running mean, halve it from time to time to adapt */
+inline void riceUpdate(uint32_t residual) {
+	riceSum += residual;
+	if (++riceCount == rice_reset) {
+		riceSum >>= 1;
+		riceCount >>= 1;
+	}
+}
+
+/* Get the position of a raw value in the small buffer */
+inline uint16_t riceIndex(uint16_t x, uint16_t y, bool lepton3) {
+	return (y * (lepton3 ? 160 : 80)) + x;
+}
+
+/* Predict a raw value from its left, upper and upper left neighbour */
+uint16_t ricePredict(uint16_t x, uint16_t y, bool lepton3) {
+	//First line, use the left neighbour
+	if (y == 0)
+		return (x == 0) ? 0 : smallBuffer[riceIndex(x - 1, 0, lepton3)];
+	//First column, use the upper neighbour
+	uint16_t above = smallBuffer[riceIndex(x, y - 1, lepton3)];
+	if (x == 0)
+		return above;
+
+	//Median edge detector
+	uint16_t left = smallBuffer[riceIndex(x - 1, y, lepton3)];
+	uint16_t corner = smallBuffer[riceIndex(x - 1, y - 1, lepton3)];
+	if (corner >= max(left, above))
+		return min(left, above);
+	if (corner <= min(left, above))
+		return max(left, above);
+	return left + above - corner;
+}
+
+/* Add bits to the coded output, most significant first */
+inline void riceBits(uint32_t value, byte count) {
+	riceAcc = (riceAcc << count) | value;
+	riceAccBits += count;
+	while (riceAccBits >= 8) {
+		riceAccBits -= 8;
+		riceSink(riceAcc >> riceAccBits);
+	}
+	riceAcc &= (1 << riceAccBits) - 1;
+}
+
+/* Rice code the raw values to the sink, predicted from the neighbours or from the reference frame if given.
+   Returns the size in bytes or zero when it would get bigger than the limit */
+uint32_t riceEncode(void (*sink)(uint8_t), uint16_t* reference, uint32_t limit) {
+	bool lepton3 = (leptonVersion == leptonVersion_3_shutter);
+	uint16_t width = lepton3 ? 160 : 80;
+	uint16_t height = lepton3 ? 120 : 60;
+	uint32_t bits = 0;
+
+	riceSink = sink;
+	riceReset();
+	for (uint16_t y = 0; y < height; y++) {
+		for (uint16_t x = 0; x < width; x++) {
+			//Stop before the written bytes can pass the limit
+			if (((bits + rice_maxBits + 7) / 8) > limit)
+				return 0;
+
+			uint16_t index = riceIndex(x, y, lepton3);
+			uint16_t value = smallBuffer[index];
+			int32_t error = value - ((reference != NULL) ? reference[index] : ricePredict(x, y, lepton3));
+			//Map the signed residual to positive values
+			uint32_t residual = (error < 0) ? ((-error * 2) - 1) : (error * 2);
+			byte k = riceParam();
+			uint32_t quotient = residual >> k;
+
+			//Unary quotient, stop bit and the k lower bits
+			if (quotient < rice_escape) {
+				bits += quotient + 1 + k;
+				riceBits((1 << (quotient + 1)) - 2, quotient + 1);
+				riceBits(residual & ((1 << k) - 1), k);
 			}
+			//Escape code followed by the value itself
+			else {
+				bits += rice_escape + 16;
+				riceBits((1 << rice_escape) - 1, rice_escape);
+				riceBits(value, 16);
+			}
+			riceUpdate(residual);
 		}
 	}
 
-	//For the Lepton3 sensor, write 19200 raw values
-	else {
-		for (int i = 0; i < 19200; i++) {
-			sdFile.write((smallBuffer[i] & 0xFF00) >> 8);
-			sdFile.write(smallBuffer[i] & 0x00FF);
-		}
+	//Pad the last byte with zeros
+	if (riceAccBits != 0)
+		riceBits(0, 8 - riceAccBits);
+	return (bits + 7) / 8;
+}
+
+/* Add the raw values of the small buffer to the staging buffer */
+void saveBlockRaw() {
+	//4800 values for the Lepton2, 19200 for the Lepton3 sensor
+	uint16_t count = rawWidth * rawHeight;
+	for (uint16_t i = 0; i < count; i++)
+		saveBlockWord(smallBuffer[i]);
+}
+
+/* Add the raw values to the staging buffer in the smaller format, returns their size in bytes */
+uint16_t saveRawValues(byte* format) {
+	uint16_t plainSize = (leptonVersion == leptonVersion_3_shutter) ? 38400 : 9600;
+	uint32_t start = saveBlockTell();
+	uint32_t riceSize = riceEncode(saveBlockByte, NULL, plainSize);
+	if (riceSize != 0) {
+		*format = rawFormat_rice;
+		return riceSize;
 	}
 
+	//Noisy frames can get bigger with the rice coder, write them plain over the coded part
+	saveBlockSeek(start);
+	saveBlockRaw();
+	*format = rawFormat_plain;
+	return plainSize;
+}
+
+/* Saves raw data for an image */
+void saveRawData(char* name) {
+	byte format;
+
+	//Start SD
+	startAltClockline();
+
+	//Create filename for image
+	strcpy(&name[14], ".DAT");
+	sdFile.open(name, O_RDWR | O_CREAT | O_AT_END);
+	saveBlockFile = &sdFile;
+
+	//Write the magic and the format of the raw values, rice until the values are written
+	uint32_t formatPos = saveBlockTell() + 3;
+	saveBlockByte('T');
+	saveBlockByte('C');
+	saveBlockByte('R');
+	saveBlockByte(rawFormat_rice);
+	//Write the number of raw values
+	if (leptonVersion == leptonVersion_3_shutter)
+		saveBlockWord(19200);
+	else
+		saveBlockWord(4800);
+
 	//Write min and max
-	sdFile.write((minValue & 0xFF00) >> 8);
-	sdFile.write(minValue & 0x00FF);
-	sdFile.write((maxValue & 0xFF00) >> 8);
-	sdFile.write(maxValue & 0x00FF);
+	saveBlockWord(minValue);
+	saveBlockWord(maxValue);
 
 	//Write the object temp 
-	uint8_t farray[4];
-	floatToBytes(farray, mlx90614_temp);
-	for (int i = 0; i < 4; i++)
-		sdFile.write(farray[i]);
+	saveBlockFloat(mlx90614_temp);
 
 	//Write the color scheme
-	sdFile.write(colorScheme);
+	saveBlockByte(colorScheme);
 	//Write the temperature format
-	sdFile.write(tempFormat);
+	saveBlockByte(tempFormat);
 	//Write the show spot attribute
-	sdFile.write(spotEnabled);
+	saveBlockByte(spotEnabled);
 	//Write the show colorbar attribute
 	if (calStatus == cal_warmup)
-		sdFile.write((byte)0);
+		saveBlockByte(0);
 	else
-		sdFile.write(colorbarEnabled);
+		saveBlockByte(colorbarEnabled);
 	//Write the show hottest / coldest attribute
-	sdFile.write(minMaxPoints);
+	saveBlockByte(minMaxPoints);
 
 	//Write calibration offset
-	floatToBytes(farray, (float)calOffset);
-	for (int i = 0; i < 4; i++)
-		sdFile.write(farray[i]);
+	saveBlockFloat(calOffset);
 	//Write calibration slope
-	floatToBytes(farray, (float)calSlope);
-	for (int i = 0; i < 4; i++)
-		sdFile.write(farray[i]);
+	saveBlockFloat(calSlope);
 
 	//Write temperature points
 	for (byte i = 0; i < 96; i++) {
 		//Write index
-		sdFile.write((tempPoints[i][0] & 0xFF00) >> 8);
-		sdFile.write(tempPoints[i][0] & 0x00FF);
+		saveBlockWord(tempPoints[i][0]);
 		//Write value
-		sdFile.write((tempPoints[i][1] & 0xFF00) >> 8);
-		sdFile.write(tempPoints[i][1] & 0x00FF);
+		saveBlockWord(tempPoints[i][1]);
 	}
 
+	//Write the raw values at the end, their number is known
+	saveRawValues(&format);
+	if (format != rawFormat_rice)
+		saveBlockPatch(formatPos, format);
+
+	//Write the last partial sector
+	saveBlockFlush();
+
 	//Close the file
 	sdFile.close();
 	//Switch Clock back to Standard
 	endAltClockline();
 }
 
+/* Create the video container in the current video folder and write the session header */
+void videoBegin() {
+	//Start SD
+	startAltClockline();
+
+	//Create the container, the folder was entered by createVideoFolder()
+	videoFile.open(video_fileName, O_RDWR | O_CREAT | O_TRUNC);
+	saveBlockFile = &videoFile;
+	saveBlockPos = 0;
+
+	//Write the magic and the version
+	saveBlockByte('T');
+	saveBlockByte('C');
+	saveBlockByte('V');
+	saveBlockByte(video_version);
+	//Write the number of raw values per frame
+	if (leptonVersion == leptonVersion_3_shutter)
+		saveBlockWord(19200);
+	else
+		saveBlockWord(4800);
+
+	//Write the settings that do not change during the recording
+	saveBlockByte(colorScheme);
+	saveBlockByte(tempFormat);
+	saveBlockByte(spotEnabled);
+	saveBlockByte(minMaxPoints);
+	saveBlockFloat(calSlope);
+	saveBlockWord(videoInterval);
+
+	//Write the indices of the temperature points
+	for (byte i = 0; i < 96; i++)
+		saveBlockWord(tempPoints[i][0]);
+
+	//Pad the header to a full sector
+	while (saveBlockPos != 0)
+		saveBlockByte(0);
+
+	//Make the header visible in the directory entry
+	videoFile.sync();
+
+	//The offsets of the records are collected in a separate file
+	videoIndexFile.open(video_indexName, O_RDWR | O_CREAT | O_TRUNC);
+	videoIndexBlockPos = 0;
+	videoRecordPos = video_headerSize;
+	videoFrames = 0;
+	endAltClockline();
+
+	//Reset the timestamps
+	videoStartTime = millis();
+	videoSyncTime = videoStartTime;
+}
+
+/* Add the offset of a record to the seek index */
+void videoIndexAdd(uint32_t offset) {
+	videoIndexBlock[videoIndexBlockPos++] = offset >> 24;
+	videoIndexBlock[videoIndexBlockPos++] = (offset >> 16) & 0xFF;
+	videoIndexBlock[videoIndexBlockPos++] = (offset >> 8) & 0xFF;
+	videoIndexBlock[videoIndexBlockPos++] = offset & 0xFF;
+	videoFrames++;
+
+	//Write a full sector of the index
+	if (videoIndexBlockPos == 512) {
+		videoIndexFile.write(videoIndexBlock, 512);
+		videoIndexBlockPos = 0;
+	}
+}
+
+/* Append the current frame to the video container */
+void videoSaveFrame() {
+	byte format;
+
+	//Start SD
+	startAltClockline();
+
+	//Add the record to the seek index
+	saveBlockFile = &videoFile;
+	videoIndexAdd(videoRecordPos);
+
+	//Write the time since the start of the recording
+	uint32_t timestamp = millis() - videoStartTime;
+	saveBlockWord(timestamp >> 16);
+	saveBlockWord(timestamp & 0xFFFF);
+	//Write the length of the frame data and the format, both set after the raw values
+	uint32_t lengthPos = saveBlockTell();
+	saveBlockWord(0);
+	saveBlockByte(rawFormat_rice);
+	//Write min and max
+	saveBlockWord(minValue);
+	saveBlockWord(maxValue);
+	//Write the object temp and the calibration offset
+	saveBlockFloat(mlx90614_temp);
+	saveBlockFloat(calOffset);
+	//Write the show colorbar attribute
+	if (calStatus == cal_warmup)
+		saveBlockByte(0);
+	else
+		saveBlockByte(colorbarEnabled);
+
+	//Write the raw values
+	uint16_t size = saveRawValues(&format);
+	saveBlockPatch(lengthPos, (14 + size) >> 8);
+	saveBlockPatch(lengthPos + 1, (14 + size) & 0xFF);
+	if (format != rawFormat_rice)
+		saveBlockPatch(lengthPos + 2, format);
+	videoRecordPos += video_recordHead + 14 + size;
+
+	//Update the directory entry from time to time, so a power loss keeps the video
+	if ((millis() - videoSyncTime) > video_syncTime) {
+		videoFile.sync();
+		videoSyncTime = millis();
+	}
+
+	//Switch Clock back to Standard
+	endAltClockline();
+}
+
+/* Append the trailer with the frame count and the position of the seek index */
+void videoWriteTrailer(SdFile* file, uint16_t frames, uint32_t indexPos) {
+	saveBlockFile = file;
+	saveBlockPos = 0;
+	saveBlockByte('T');
+	saveBlockByte('C');
+	saveBlockByte('V');
+	saveBlockByte('I');
+	saveBlockWord(0);
+	saveBlockWord(frames);
+	saveBlockWord(indexPos >> 16);
+	saveBlockWord(indexPos & 0xFFFF);
+	saveBlockFlush();
+
+	//Set the staging buffer back to the default file
+	saveBlockFile = &sdFile;
+}
+
+/* Rebuild the seek index of an interrupted recording from the records, returns the frame count */
+uint16_t videoWriteIndex(SdFile* file, uint32_t dataEnd) {
+	uint8_t head[video_recordHead];
+	uint32_t readPos = video_headerSize;
+	uint32_t writePos = dataEnd;
+	uint16_t frames = 0;
+
+	//Walk over the record headers and add their offsets to the index
+	saveBlockPos = 0;
+	while ((readPos + video_recordHead) <= dataEnd) {
+		saveBlock[saveBlockPos++] = readPos >> 24;
+		saveBlock[saveBlockPos++] = (readPos >> 16) & 0xFF;
+		saveBlock[saveBlockPos++] = (readPos >> 8) & 0xFF;
+		saveBlock[saveBlockPos++] = readPos & 0xFF;
+		frames++;
+
+		//Write a full sector of the index behind the records
+		if (saveBlockPos == 512) {
+			file->seekSet(writePos);
+			file->write(saveBlock, 512);
+			writePos += 512;
+			saveBlockPos = 0;
+		}
+
+		//Skip to the next record
+		file->seekSet(readPos);
+		file->read(head, video_recordHead);
+		readPos += video_recordHead + ((head[4] << 8) | head[5]);
+	}
+
+	//Add the trailer with the frame count and the index position
+	file->seekSet(writePos);
+	file->write(saveBlock, saveBlockPos);
+	videoWriteTrailer(file, frames, dataEnd);
+	return frames;
+}
+
+/* Write the remaining frames and the seek index, then close the video container */
+void videoEnd() {
+	//Start SD
+	startAltClockline();
+
+	//Write the last partial sector of frame data
+	saveBlockFile = &videoFile;
+	saveBlockFlush();
+
+	//Write the last partial sector of the index
+	if (videoIndexBlockPos != 0)
+		videoIndexFile.write(videoIndexBlock, videoIndexBlockPos);
+
+	//Copy the index behind the records for fast seeking during playback
+	videoIndexFile.seekSet(0);
+	int16_t len;
+	while ((len = videoIndexFile.read(saveBlock, 512)) > 0)
+		videoFile.write(saveBlock, len);
+	videoIndexFile.close();
+	sd.remove(video_indexName);
+
+	//Add the trailer after the index
+	videoWriteTrailer(&videoFile, videoFrames, videoRecordPos);
+
+	//Close the container
+	videoFile.close();
+	//Switch Clock back to Standard
+	endAltClockline();
+}
+
 /* End the image save procedure */
 void imgSaveEnd() {
 	//Save Bitmap image if activated or in visual / combined mode
@@ -16,6 +16,8 @@
 /* Includes */
 
 #include "Calibration.h"
+#include "AGC.h"
+#include "Filter.h"
 #include "Create.h"
 #include "Save.h"
 #include "Load.h"
@@ -160,7 +162,37 @@ void showColorBar() {
 	//Calculate color level for hot and cold
 	float colorLevel = 0;
 	if ((hotColdMode != hotColdMode_disabled) && (displayMode != displayMode_combined))
-		colorLevel = (tempToRaw(hotColdLevel) * 1.0 - minValue) / (maxValue * 1.0 - minValue);
+		colorLevel = (calSnapRaw(hotColdLevel * 100) * 1.0 - minValue) / (maxValue * 1.0 - minValue);
+
+	//Calculate min and max temp in celcius/fahrenheit
+	float min = calSnapCenti(minValue) / 100.0;
+	float max = calSnapCenti(maxValue) / 100.0;
+	//Calculate step
+	float step = (max - min) / 3.0;
+	//Temperatures shown from min to max
+	int labels[4];
+	for (byte i = 0; i < 3; i++)
+		labels[i] = (int)round(min + (i * step));
+	labels[3] = (int)round(max);
+	//Equalized colors, take the temperatures at the color levels of the labels
+	if (agcActive(agcMode_equalize) && agcMapValid) {
+		for (byte i = 1; i < 3; i++)
+			labels[i] = (int)round(calSnapCenti(agcLevelValue((65535 * i) / 3)) / 100.0);
+	}
+	//Locally equalized colors have no temperature in between
+	bool inner = !agcLocalApply;
+
+	//Only redraw when the colors or the shown temperatures change
+	uint32_t level;
+	memcpy(&level, &colorLevel, sizeof(level));
+	uint32_t key = display_overlayKey((uint32_t)colorMap, colorElements);
+	key = display_overlayKey(key, level);
+	key = display_overlayKey(key, (hotColdMode << 8) | hotColdColor);
+	key = display_overlayKey(key, (calStatus == cal_warmup) | ((displayMode == displayMode_combined) << 1) | (inner << 2));
+	for (byte i = 0; i < 4; i++)
+		key = display_overlayKey(key, labels[i]);
+	if (display_overlayCached(overlay_colorBar, key))
+		return;
 
 	//Display color bar
 	for (int i = 0; i < (colorElements - 1); i++) {
@@ -199,12 +231,6 @@ void showColorBar() {
 	//Set text color
 	changeTextColor();
 
-	//Calculate min and max temp in celcius/fahrenheit
-	float min = calFunction(minValue);
-	float max = calFunction(maxValue);
-	//Calculate step
-	float step = (max - min) / 3.0;
-
 	//For 320x240, set fac to one
 	if (teensyVersion == teensyVersion_new)
 		fac = 1;
@@ -213,19 +239,20 @@ void showColorBar() {
 		fac = 2;
 
 	//Draw min temp
-	sprintf(buffer, "%d", (int)round(min));
+	sprintf(buffer, "%d", labels[0]);
 	display_print(buffer, 270, (height * fac) - 5);
 
 	//Draw temperatures after min before max
-	for (int i = 2; i >= 1; i--) {
-		float temp = min + (i*step);
-		sprintf(buffer, "%d", (int)round(temp));
+	for (int i = 2; (i >= 1) && (inner); i--) {
+		sprintf(buffer, "%d", labels[i]);
 		display_print(buffer, 270, (height * fac) - 5 - (i * (colorElements / 6)));
 	}
 
 	//Draw max temp
-	sprintf(buffer, "%d", (int)round(max));
+	sprintf(buffer, "%d", labels[3]);
 	display_print(buffer, 270, (height * fac) - 5 - (3 * (colorElements / 6)));
+
+	display_overlayEnd();
 }
 
 /* Change the display options */
@@ -272,6 +299,12 @@ void changeDisplayOptions(byte* pos) {
 		if (filterType == filterType_box)
 			filterType = filterType_gaussian;
 		else if (filterType == filterType_gaussian)
+			filterType = filterType_gaussian5;
+		else if (filterType == filterType_gaussian5)
+			filterType = filterType_median;
+		else if (filterType == filterType_median)
+			filterType = filterType_bilateral;
+		else if (filterType == filterType_bilateral)
 			filterType = filterType_none;
 		else
 			filterType = filterType_box;
@@ -305,6 +338,19 @@ void changeDisplayOptions(byte* pos) {
 			minMaxPoints = minMaxPoints_disabled;
 		EEPROM.write(eeprom_minMaxPoints, minMaxPoints);
 		break;
+
+		//Automatic gain control
+	case 9:
+		if (agcMode == agcMode_linear)
+			agcMode = agcMode_percentile;
+		else if (agcMode == agcMode_percentile)
+			agcMode = agcMode_equalize;
+		else if (agcMode == agcMode_equalize)
+			agcMode = agcMode_local;
+		else
+			agcMode = agcMode_linear;
+		EEPROM.write(eeprom_agcMode, agcMode);
+		break;
 	}
 }
 
@@ -440,10 +486,17 @@ void changeColorScheme(byte* pos) {
 
 /* Show the thermal/visual/combined image on the screen */
 void showImage() {
+	//Let the background capture of the next frame release the SPI bus
+	bool prefetched = lepton_waitCapture();
+
 	//Draw thermal image on screen if created previously and not in menu nor in video save
 	if ((!imgSave) && (!showMenu) && (!videoSave))
 		displayBuffer();
 
+	//Use the captured frame for the next image
+	if (prefetched)
+		lepton_usePrefetch();
+
 	//If the image has been created, set to save
 	if (imgSave == imgSave_create)
 		imgSave = imgSave_save;
@@ -478,32 +531,51 @@ void liveMode() {
 
 	//Main Loop
 	while (true) {
+		//Start the time measurement of the frame
+		profiler_frameBegin();
+
 		//Check for serial connection
+		profiler_start();
 		checkSerial();
+		profiler_stop(profiler_checkSerial);
 
 		//Check for screen sleep
+		profiler_start();
 		screenOffCheck();
+		profiler_stop(profiler_screenOffCheck);
 
 		//If touch IRQ has been triggered, open menu
-		if (showMenu)
+		if (showMenu) {
 			mainMenu();
+			//Do not count the time in the menu
+			profiler_frameBegin();
+		}
 
 		//Start the image save procedure
-		if (imgSave == imgSave_set)
+		if (imgSave == imgSave_set) {
 			imgSaveStart();
+			profiler_frameBegin();
+		}
 
-		//Create thermal image
-		if (displayMode == displayMode_thermal)
+		//Create thermal image, the visual stream buffer is not needed
+		if (displayMode == displayMode_thermal) {
+			camera_releaseStream();
 			createThermalImg();
+		}
 		//Create visual or combined image
 		else
 			createVisCombImg();
 
 		//Display additional information
+		profiler_start();
 		displayInfos();
+		profiler_stop(profiler_displayInfos);
 
 		//Show the content on the screen
+		profiler_start();
 		showImage();
+		profiler_stop(profiler_showImage);
+		profiler_frameEnd();
 
 		//Save the converted / visual image
 		if (imgSave == imgSave_save)